@@ -0,0 +1,267 @@
+#pragma once
+#include "search.hpp"
+
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "closed_set.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * Anytime Repairing A* (Likhachev, Gordon and Thrun 2003). Runs weighted A* with the weight set by
+ * setWeight, publishes the solution with its suboptimality bound, lowers the weight by weightStep and
+ * repairs the search instead of starting over: open and closed are kept, nodes whose g improved after
+ * they were expanded in the current iteration wait in an inconsistent list and go back into open, which
+ * is re-keyed with the new weight. Ends with a proven optimal solution or when a limit stops it, in which
+ * case the last solution and its bound are reported.
+ */
+template<typename State, typename Cost = float>
+class ARAStar : public Search<State, Cost> {
+    struct Node;
+    struct NodeCompare;
+    using Hot = HotNode<Cost>;
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
+
+public:
+    ARAStar(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time, double weightStep = 0.5)
+        : Search<State, Cost>(problemInstance),
+        open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}),
+        closed(&nodes, [this](const State& state) {
+            return this->hash(state);
+        }),
+        weightStep(static_cast<Cost>(weightStep)) {
+        this->extra_expansion_time = extra_expansion_time;
+
+        this->searchStats["Algorithm"] = "ARA*";
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = 1;
+        this->searchStats["Weight Step"] = weightStep;
+    }
+
+    vector<State> findPath() override {
+        this->start();
+        this->prefaultMemory(nodes, closed, 1);
+        this->searchStats["Initial Weight"] = static_cast<double>(this->weight);
+
+        Cost startH = this->heuristic(this->problemInstance->initial_state);
+        NodeId startNode = nodes.emplace(Hot{this->fValue(0, startH), 0}, this->problemInstance->initial_state, startH, NO_NODE);
+        closed.insert(startNode, nodes.cold(startNode).state);
+        if (startH == 0)
+            offerSolution(startNode);
+        else
+            open.push(startNode);
+
+        while (true) {
+            iterations++;
+            // improvePath may return without expanding anything, so the limits are checked here too
+            if (this->limitReachedNow() || !improvePath()) break; // a limit was reached
+            if (incumbentNode == NO_NODE) break; // open ran out, there is no path
+            double bound = proveBound();
+            publish(bound);
+            if (bound <= 1) break; // optimal
+            this->weight = max<Cost>(1, this->weight - weightStep);
+            repair();
+        }
+
+        if (incumbentNode != NO_NODE) {
+            this->pathLength = nodes.hot(incumbentNode).g;
+        } else if (!open.empty()) {
+            this->bestBound = nodes.hot(open.top()).f; // divided by the weight in end()
+        }
+        return finish(incumbentNode);
+    }
+
+private:
+    static constexpr uint32_t NEVER_CLOSED = numeric_limits<uint32_t>::max();
+
+    // The cold part of a node, the f, g and heap index live in the arena's HotNode
+    struct Node {
+        const State state;
+        Cost h{};
+        NodeId parent = NO_NODE;
+        uint32_t closedIn = NEVER_CLOSED; // the iteration that last expanded it
+        bool inconsistent = false; // improved after its expansion in the current iteration
+
+        Node(const State& s, Cost h, NodeId parent) : state(s), h(h), parent(parent) {}
+    };
+
+    struct NodeCompare {
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return x.g < y.g;
+            return x.f < y.f;
+        }
+    };
+
+    Arena nodes;
+    MinHeap open;
+    ClosedSet<State, Arena> closed;
+    vector<NodeId> inconsistent;
+    Cost weightStep;
+
+    uint32_t iterations = 0;
+    size_t solutions = 0; // published so far
+    Cost publishedCost{};
+    NodeId incumbentNode = NO_NODE; // the cheapest goal found, goals never go into open
+    bool stopped = false;
+    stringstream solutionCosts, solutionBounds, solutionTimes; // one entry per published solution
+
+    void offerSolution(NodeId goal) {
+        if (incumbentNode == NO_NODE || nodes.hot(goal).g < nodes.hot(incumbentNode).g) {
+            incumbentNode = goal;
+        }
+    }
+
+    /**
+     * Expands nodes until nothing in open has a smaller weighted f than the incumbent's cost
+     * @return false when a limit stopped the search
+     */
+    bool improvePath() {
+        while (!open.empty()) {
+            NodeId current = open.top();
+            if (incumbentNode != NO_NODE && nodes.hot(incumbentNode).g <= nodes.hot(current).f) return true;
+            if (this->limitReached()) {
+                stopped = true;
+                return false;
+            }
+            open.pop();
+            nodes.cold(current).closedIn = iterations;
+            expand(current);
+        }
+        return true;
+    }
+
+    void expand(NodeId n) {
+        this->expandedNodes++;
+        const State& state = nodes.cold(n).state;
+        for (const auto& successorState : this->getSuccessors(state)) {
+            if (successorState == state) continue; // skip the parent state
+            this->generatedNodes++;
+            Cost g = nodes.hot(n).g + this->getCost(state, successorState);
+
+            size_t successorHash = closed.hash(successorState);
+            NodeId duplicate = closed.find(successorState, successorHash);
+            if (duplicate != NO_NODE) {
+                this->generatedNodes--; // undo the generation of the duplicate
+                Hot& duplicateNode = nodes.hot(duplicate);
+                Node& duplicateCold = nodes.cold(duplicate);
+                if (duplicateNode.g <= g) continue;
+                this->duplicatedNodes++;
+                duplicateNode.g = g;
+                duplicateNode.f = this->fValue(g, duplicateCold.h);
+                duplicateCold.parent = n;
+                if (duplicateCold.h == 0) {
+                    offerSolution(duplicate);
+                } else if (open.contains(duplicate)) {
+                    open.update(duplicate);
+                } else if (duplicateCold.closedIn == iterations) {
+                    // expanded this iteration already, it waits for the next one
+                    if (!duplicateCold.inconsistent) {
+                        duplicateCold.inconsistent = true;
+                        inconsistent.push_back(duplicate);
+                    }
+                } else {
+                    open.push(duplicate);
+                }
+                continue;
+            }
+
+            Cost h = this->heuristic(successorState);
+            NodeId successor = nodes.emplace(Hot{this->fValue(g, h), g}, successorState, h, n);
+            closed.insert(successor, successorHash);
+            this->wasteTime(this->extra_expansion_time);
+            if (h == 0)
+                offerSolution(successor);
+            else
+                open.push(successor);
+        }
+    }
+
+    // min(weight, cost / the smallest unweighted f in open and inconsistent), which bounds the incumbent
+    double proveBound() const {
+        Cost lowest = numeric_limits<Cost>::max();
+        for (size_t i = 0; i < open.size(); i++) {
+            const NodeId id = open.at(i);
+            lowest = min(lowest, nodes.hot(id).g + nodes.cold(id).h);
+        }
+        for (NodeId id : inconsistent) {
+            lowest = min(lowest, nodes.hot(id).g + nodes.cold(id).h);
+        }
+        Cost cost = nodes.hot(incumbentNode).g;
+        if (lowest >= cost) return 1; // nothing left can be cheaper
+        return min<double>(this->weight, cost / lowest);
+    }
+
+    // Reports the incumbent when its cost or its bound improved since the last report
+    void publish(double bound) {
+        chrono::duration<double> elapsed = chrono::high_resolution_clock::now() - this->clockStart;
+        Cost cost = nodes.hot(incumbentNode).g;
+        if (solutions > 0 && cost == publishedCost && bound == this->suboptimality) return;
+        solutions++;
+        publishedCost = cost;
+        this->suboptimality = bound;
+        clog << "ARA* solution " << cost << " within " << bound << " of optimal after " << elapsed.count() << "s" << endl;
+        const char* separator = solutions == 1 ? "" : ",";
+        solutionCosts << separator << cost;
+        solutionBounds << separator << bound;
+        solutionTimes << separator << elapsed.count();
+    }
+
+    // Moves the inconsistent nodes back into open and re-keys open with the new weight
+    void repair() {
+        vector<NodeId> ids;
+        ids.reserve(open.size() + inconsistent.size());
+        for (size_t i = 0; i < open.size(); i++) {
+            ids.push_back(open.at(i));
+        }
+        for (NodeId id : inconsistent) {
+            nodes.cold(id).inconsistent = false;
+            ids.push_back(id);
+        }
+        inconsistent.clear();
+        open.clear();
+        for (NodeId id : ids) {
+            nodes.hot(id).f = this->fValue(nodes.hot(id).g, nodes.cold(id).h);
+            open.push(id);
+        }
+    }
+
+    vector<State> reconstructPath(NodeId goal) const {
+        vector<State> path;
+        NodeId current = goal;
+        while (current != NO_NODE) {
+            path.push_back(nodes.cold(current).state);
+            current = nodes.cold(current).parent;
+        }
+        reverse(path.begin(), path.end());
+        return path;
+    }
+
+    vector<State> finish(NodeId n) {
+        this->recordNodeMemory(sizeof(Hot) + sizeof(Node), nodes.size());
+        this->recordTableMemory("Closed", closed);
+        this->searchStats["Open Memory"] = open.memoryBytes();
+        this->searchStats["Iterations"] = static_cast<size_t>(iterations);
+        this->searchStats["Solutions"] = solutions;
+        this->searchStats["Final Weight"] = static_cast<double>(this->weight);
+        this->searchStats["Solution Costs"] = solutionCosts.str();
+        this->searchStats["Solution Bounds"] = solutionBounds.str();
+        this->searchStats["Solution Times"] = solutionTimes.str();
+        if (stopped) this->searchStats["Stopped By"] = toString(this->status); // the last solution is still reported
+        this->end();
+        if (n == NO_NODE) {
+            return {};
+        }
+        return reconstructPath(n);
+    }
+};
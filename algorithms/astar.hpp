@@ -1,10 +1,9 @@
 #pragma once
 #include "search.hpp"
 
-#include <boost/unordered/unordered_flat_map.hpp>
-using boost::unordered_flat_map;
-
-#include <boost/heap/d_ary_heap.hpp>
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "closed_set.hpp"
 
 #include <algorithm>
 #include <vector>
@@ -21,15 +20,16 @@ class AStar : public Search<State, Cost> {
 
     struct Node;
     struct NodeCompare;
-    using MinHeap = boost::heap::d_ary_heap<Node*, boost::heap::arity<2>, boost::heap::mutable_<true>, boost::heap::compare<NodeCompare>>;
+    using Hot = HotNode<Cost>;
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
 
 public:
-    AStar(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time) : Search<State, Cost>(problemInstance){
-        open = MinHeap();
-        closed = unordered_flat_map<State, Node*, HashFn>(0,     
-        [this](const State& state) {
+    AStar(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time) : Search<State, Cost>(problemInstance),
+        open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}),
+        closed(&nodes, [this](const State& state) {
             return this->hash(state);
-        });
+        }) {
         this->extra_expansion_time = extra_expansion_time;
 
         this->searchStats["Algorithm"] = "A*";
@@ -40,109 +40,112 @@ public:
 
     vector<State> findPath() override {
         this->start();
-        nodes.reserve(10'000'000); // reserve 10 million nodes
-        // Side note, push back is amortized O(1), so we can compare the speed loss of reserve vs push_back at some point
+        this->prefaultMemory(nodes, closed, 1);
 
-        nodes.emplace_back(this->problemInstance->initial_state,
-            0, this->heuristic(this->problemInstance->initial_state), nullptr);
-        Node* startNode = &nodes.back();
+        Cost startH = this->heuristic(this->problemInstance->initial_state);
+        NodeId startNode = nodes.emplace(Hot{this->fValue(0, startH), 0}, this->problemInstance->initial_state, startH, NO_NODE);
 
-        closed.emplace(startNode->state, startNode);
-        startNode->handle = open.push(startNode);
+        closed.insert(startNode, nodes.cold(startNode).state);
+        open.push(startNode);
 
         while (!open.empty()) {
-            Node* current = open.top();
+            NodeId current = open.top();
+            if (this->limitReached()) {
+                this->bestBound = nodes.hot(current).f;
+                break;
+            }
             open.pop();
-            if (current->h == 0){
-                this->pathLength = current->g;
+            if (nodes.cold(current).h == 0){
+                this->pathLength = nodes.hot(current).g;
                 return finish(current);
             }
             expand(current);
         }
-        return finish(nullptr);
+        return finish(NO_NODE);
     }
 
 private:
+    // The cold part of a node, the f, g and heap index live in the arena's HotNode
     struct Node {
-        MinHeap::handle_type handle;
         const State state;
-        Cost f{}, g{}, h{};
-        Node* parent;
+        Cost h{};
+        NodeId parent = NO_NODE;
 
-        Node() = default;
-        Node(State s) : state(s), parent(nullptr) {}
-        Node(State s, Cost g, Cost h, Node* parent) : state(s), g(g), h(h), parent(parent) {
-            f = g + h;
-        }
-
-        bool operator > (const Node& other) const { 
-            if (f == other.f) 
-                return g > other.g;
-            return f > other.f;
-        }
+        Node(const State& s, Cost h, NodeId parent) : state(s), h(h), parent(parent) {}
     };
 
     struct NodeCompare {
-        bool operator()(const Node* a, const Node* b) const {
-            return *a > *b;
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return x.g < y.g;
+            return x.f < y.f;
         }
     };
 
-    vector<Node> nodes;
+    Arena nodes;
     MinHeap open;
-    unordered_flat_map<State, Node*, HashFn> closed;
+    ClosedSet<State, Arena> closed;
 
-    void expand(Node* n) {
+    void expand(NodeId n) {
         this->expandedNodes++;
-        for (const auto& successorState : this->getSuccessors(n->state)) {
-            if (successorState == n->state) continue; // skip the parent state
+        const State& state = nodes.cold(n).state;
+        for (const auto& successorState : this->getSuccessors(state)) {
+            if (successorState == state) continue; // skip the parent state
             this->generatedNodes++;
-            // Generate the successor node and calculate its f, g, and h values
-            nodes.emplace_back(successorState,
-                n->g + this->getCost(n->state, successorState),
-                this->heuristic(successorState),
-                n);
-            Node* successor = &nodes.back();
-
-            // Check if successor is already in closed list
-            auto duplicate = closed.find(successorState);
-            if (duplicate != closed.end()) { 
-                Node* duplicateNode = duplicate->second;
-                if (duplicateNode->f > successor->f) { // only > because less effort to skip if they have the same f value
+            Cost g = nodes.hot(n).g + this->getCost(state, successorState);
+
+            // Check if successor is already in closed list before allocating a node for it
+            size_t successorHash = closed.hash(successorState);
+            NodeId duplicate = closed.find(successorState, successorHash);
+            if (duplicate != NO_NODE) {
+                Hot& duplicateNode = nodes.hot(duplicate);
+                // h is the same because it's the same state, so the duplicate's h saves a heuristic call
+                Cost f = this->fValue(g, nodes.cold(duplicate).h);
+                if (duplicateNode.f > f) { // only > because less effort to skip if they have the same f value
                     this->duplicatedNodes++;
-                    duplicateNode->g = successor->g;
-                    // h should be the same because it's the same state
-                    duplicateNode->f = successor->f;
-                    duplicateNode->parent = successor->parent;
-                    open.update(duplicateNode->handle);
+                    duplicateNode.g = g;
+                    duplicateNode.f = f;
+                    nodes.cold(duplicate).parent = n;
+                    if (open.contains(duplicate))
+                        open.update(duplicate);
+                    else
+                        open.push(duplicate); // reopen
                 }
                 this->generatedNodes--; // undo the generation of the duplicate
                 continue; // skip this successor because it's already in closed list and it was already updated
-            } else 
-                closed.emplace(successorState, successor);
+            }
+
+            // Generate the successor node and calculate its f, g, and h values
+            Cost h = this->heuristic(successorState);
+            NodeId successor = nodes.emplace(Hot{this->fValue(g, h), g}, successorState, h, n);
+            closed.insert(successor, successorHash);
             this->wasteTime(this->extra_expansion_time);
-            successor->handle = open.push(successor);
+            open.push(successor);
         }
     }
 
-    static vector<State> reconstructPath(
-        Node* goal
-    ) {
+    vector<State> reconstructPath(NodeId goal) const {
         vector<State> path;
-        Node* current = goal;
-        while (current != nullptr) {
-            path.push_back(current->state);
-            current = current->parent;
+        NodeId current = goal;
+        while (current != NO_NODE) {
+            path.push_back(nodes.cold(current).state);
+            current = nodes.cold(current).parent;
         }
         reverse(path.begin(), path.end());
         return path;
     }
 
-    vector<State> finish(Node* n) {
+    vector<State> finish(NodeId n) {
+        this->recordNodeMemory(sizeof(Hot) + sizeof(Node), nodes.size());
+        this->recordTableMemory("Closed", closed);
+        this->searchStats["Open Memory"] = open.memoryBytes();
         this->end();
-        if(n == nullptr) {
+        if(n == NO_NODE) {
             return {};
         }
         return reconstructPath(n);
     }
-}; 
\ No newline at end of file
+};
@@ -0,0 +1,321 @@
+#pragma once
+#include "search.hpp"
+
+#include "work_stealing_pool.hpp"
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "closed_set.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * Searches whose memory and time are bounded by a width, whatever the instance, at the price of optimality
+ * and completeness. No depth holds more than width expanded nodes, so a search expands at most width times
+ * the depth of the path it returns.
+ *
+ * Beam search goes breadth first: each layer keeps only the width best successors of the previous one by
+ * fValue, and the search stops at the first layer with a goal. The layer's nodes are split into chunks
+ * expanded in parallel on a work stealing pool.
+ *
+ * Bounded width best first search expands by fValue like KBFS, threadCount nodes per batch, but drops the
+ * nodes of a depth once width of them have been expanded. It stops once open holds nothing better than the
+ * best goal, so with a large enough width it is A* (weighted A* with a weight).
+ */
+template<typename State, typename Cost = float>
+class BeamSearch : public Search<State, Cost> {
+    struct Node;
+    struct NodeCompare;
+    using Hot = HotNode<Cost>;
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
+
+    static constexpr size_t CHUNKS_PER_THREAD = 4; // so stealing can even out chunks of uneven cost
+
+public:
+    BeamSearch(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time, size_t width, size_t threadCount, bool bestFirst)
+        : Search<State, Cost>(problemInstance),
+        open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}),
+        closed(&nodes, [this](const State& state) {
+            return this->hash(state);
+        }),
+        width(max<size_t>(width, 1)), threadCount(max<size_t>(threadCount, 1)), bestFirst(bestFirst) {
+        this->extra_expansion_time = extra_expansion_time;
+
+        this->searchStats["Algorithm"] = bestFirst ? "Bounded Best First" : "Beam";
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = this->threadCount;
+        this->searchStats["Width"] = this->width;
+    }
+
+    vector<State> findPath() override {
+        this->start();
+        this->pinThread(0);
+        this->prefaultMemory(nodes, closed, threadCount);
+        threadPool.emplace(threadCount - 1, WorkStealingPool::DEFAULT_TASK_CAPACITY,
+                           [this](size_t worker) { this->pinThread(worker + 1); });
+
+        Cost startH = this->heuristic(this->problemInstance->initial_state);
+        NodeId startNode = nodes.emplace(Hot{this->fValue(0, startH), 0}, this->problemInstance->initial_state, startH, NO_NODE, 0);
+        closed.insert(startNode, nodes.cold(startNode).state);
+        if (startH == 0)
+            offerSolution(startNode);
+        else if (bestFirst)
+            bestFirstSearch(startNode);
+        else
+            beamSearch(startNode);
+
+        if (incumbentNode != NO_NODE) { // a limit only stops the search early, the best goal so far is still a path
+            this->pathLength = nodes.hot(incumbentNode).g;
+            return finish(incumbentNode);
+        }
+        return finish(NO_NODE);
+    }
+
+private:
+    // The cold part of a node, the f, g and heap index live in the arena's HotNode
+    struct Node {
+        State state;
+        Cost h{};
+        NodeId parent = NO_NODE;
+        uint32_t depth = 0;
+
+        Node(const State& s, Cost h, NodeId parent, uint32_t depth) : state(s), h(h), parent(parent), depth(depth) {}
+        Node(State&& s, Cost h, NodeId parent, uint32_t depth) : state(std::move(s)), h(h), parent(parent), depth(depth) {}
+    };
+
+    // A successor computed by a pool thread, it only becomes a Node if it is not a duplicate
+    struct Successor {
+        State state;
+        Cost g{}, h{};
+        size_t hash = 0;
+        NodeId parent = NO_NODE;
+    };
+
+    // Reused between layers so the pool threads write into already allocated States
+    struct SuccessorBuffer {
+        vector<Successor> successors;
+        size_t count = 0;
+    };
+
+    struct NodeCompare {
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return x.g > y.g; // deeper first, it is closer to a goal
+            return x.f < y.f;
+        }
+    };
+
+    Arena nodes;
+    MinHeap open; // only used by the best first mode
+    ClosedSet<State, Arena> closed;
+    optional<WorkStealingPool> threadPool; // threadCount - 1 workers, the main thread runs tasks while it waits
+    vector<SuccessorBuffer> successorBuffers; // one per chunk or batch slot
+
+    size_t width;
+    size_t threadCount;
+    bool bestFirst;
+
+    Cost incumbent = numeric_limits<Cost>::max();
+    NodeId incumbentNode = NO_NODE;
+    size_t droppedNodes = 0; // left out because their layer or depth was full
+    size_t prunedNodes = 0; // no better than the best goal
+    size_t layers = 0;
+    size_t peakLayerSize = 0;
+
+    void offerSolution(NodeId goal) {
+        if (nodes.hot(goal).g < incumbent) {
+            incumbent = nodes.hot(goal).g;
+            incumbentNode = goal;
+        }
+    }
+
+    void beamSearch(NodeId startNode) {
+        vector<NodeId> layer{startNode};
+        vector<NodeId> candidates;
+        while (!layer.empty() && incumbentNode == NO_NODE) {
+            if (this->limitReached()) {
+                break;
+            }
+            layers++;
+            expandInParallel(layer);
+
+            candidates.clear();
+            for (const SuccessorBuffer& buffer : successorBuffers) {
+                for (size_t j = 0; j < buffer.count; j++) {
+                    NodeId n = insert(buffer.successors[j]);
+                    if (n != NO_NODE && nodes.cold(n).h != 0) candidates.push_back(n);
+                }
+            }
+            // a successor may have been improved after it was added, it only goes into the layer once
+            sort(candidates.begin(), candidates.end());
+            candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+            if (candidates.size() > width) {
+                NodeCompare better{&nodes};
+                nth_element(candidates.begin(), candidates.begin() + width, candidates.end(), better);
+                droppedNodes += candidates.size() - width;
+                candidates.resize(width);
+            }
+            peakLayerSize = max(peakLayerSize, candidates.size());
+            layer.swap(candidates);
+        }
+    }
+
+    void bestFirstSearch(NodeId startNode) {
+        vector<size_t> expandedAtDepth;
+        open.push(startNode);
+        vector<NodeId> batch;
+        // goals never go into open, so once the best f in open reaches the incumbent nothing can beat it
+        while (!open.empty() && nodes.hot(open.top()).f < incumbent) {
+            if (this->limitReached()) {
+                this->bestBound = min(nodes.hot(open.top()).f, incumbent);
+                break;
+            }
+            batch.clear();
+            while (batch.size() < threadCount && !open.empty() && nodes.hot(open.top()).f < incumbent) {
+                NodeId n = open.top();
+                open.pop();
+                uint32_t depth = nodes.cold(n).depth;
+                if (expandedAtDepth.size() <= depth) expandedAtDepth.resize(depth + 1, 0);
+                if (expandedAtDepth[depth] >= width) {
+                    droppedNodes++; // its depth is full
+                    continue;
+                }
+                expandedAtDepth[depth]++;
+                batch.push_back(n);
+            }
+            if (batch.empty()) continue;
+            expandInParallel(batch);
+
+            for (const SuccessorBuffer& buffer : successorBuffers) {
+                for (size_t j = 0; j < buffer.count; j++) {
+                    NodeId n = insert(buffer.successors[j]);
+                    if (n == NO_NODE || nodes.cold(n).h == 0) continue;
+                    if (open.contains(n))
+                        open.update(n);
+                    else
+                        open.push(n);
+                }
+            }
+        }
+        layers = expandedAtDepth.size();
+    }
+
+    // Expands nodes in chunks on the pool, the successors end up in the first chunks of successorBuffers
+    void expandInParallel(const vector<NodeId>& expanding) {
+        size_t chunks = min(expanding.size(), bestFirst ? threadCount : threadCount * CHUNKS_PER_THREAD);
+        if (successorBuffers.size() < chunks) successorBuffers.resize(chunks);
+        for (size_t i = chunks; i < successorBuffers.size(); i++) {
+            successorBuffers[i].count = 0;
+        }
+        TaskGroup group;
+        for (size_t i = 0; i < chunks; i++) {
+            threadPool->submit(group, [this, &expanding, chunks, i] (size_t) {
+                SuccessorBuffer& buffer = successorBuffers[i];
+                buffer.count = 0;
+                size_t begin = expanding.size() * i / chunks;
+                size_t end = expanding.size() * (i + 1) / chunks;
+                for (size_t k = begin; k < end; k++) {
+                    expand(expanding[k], buffer);
+                }
+            });
+        }
+        // the main thread expands chunks too while it waits
+        threadPool->wait(group);
+        this->expandedNodes += expanding.size();
+    }
+
+    // Appends the successors of n to buffer, runs on a pool thread
+    void expand(NodeId n, SuccessorBuffer& buffer) {
+        const State& state = nodes.cold(n).state;
+        Cost g = nodes.hot(n).g;
+        vector<State> successorStates = this->getSuccessors(state);
+        if (buffer.successors.size() < buffer.count + successorStates.size()) {
+            buffer.successors.resize(buffer.count + successorStates.size());
+        }
+        for (State& successorState : successorStates) {
+            if (successorState == state) continue;
+            Successor& successor = buffer.successors[buffer.count++];
+            successor.g = g + this->getCost(state, successorState);
+            successor.h = this->heuristic(successorState);
+            successor.hash = closed.hash(successorState); // hashing here takes it off the main thread
+            successor.parent = n;
+            successor.state = std::move(successorState);
+        }
+        this->wasteTime(this->extra_expansion_time);
+    }
+
+    /**
+     * Adds a successor computed by a pool thread, or improves its duplicate
+     * @return the node when it is new or improved, NO_NODE when it is a duplicate that is no better
+     */
+    NodeId insert(const Successor& successor) {
+        this->generatedNodes++;
+        Cost f = this->fValue(successor.g, successor.h);
+        if (f >= incumbent) {
+            prunedNodes++; // cannot lead to a cheaper solution
+            return NO_NODE;
+        }
+        uint32_t depth = nodes.cold(successor.parent).depth + 1;
+        NodeId duplicate = closed.find(successor.state, successor.hash);
+        if (duplicate != NO_NODE) {
+            this->generatedNodes--; // undo the generation of the duplicate
+            Hot& duplicateNode = nodes.hot(duplicate);
+            if (duplicateNode.g <= successor.g) return NO_NODE;
+            this->duplicatedNodes++;
+            duplicateNode.g = successor.g;
+            duplicateNode.f = f;
+            nodes.cold(duplicate).parent = successor.parent;
+            nodes.cold(duplicate).depth = depth;
+            if (successor.h == 0) offerSolution(duplicate);
+            return duplicate;
+        }
+        NodeId n = nodes.emplace(Hot{f, successor.g}, successor.state, successor.h, successor.parent, depth);
+        closed.insert(n, successor.hash);
+        if (successor.h == 0) offerSolution(n);
+        return n;
+    }
+
+    vector<State> reconstructPath(NodeId goal) const {
+        vector<State> path;
+        NodeId current = goal;
+        while (current != NO_NODE) {
+            path.push_back(nodes.cold(current).state);
+            current = nodes.cold(current).parent;
+        }
+        reverse(path.begin(), path.end());
+        return path;
+    }
+
+    vector<State> finish(NodeId n) {
+        // dropping nodes gives up the guarantees, a best first search that dropped none is still weighted A*
+        if (!bestFirst || droppedNodes > 0) {
+            this->suboptimality = 0;
+            this->bestBound = -1;
+        }
+        this->recordNodeMemory(sizeof(Hot) + sizeof(Node), nodes.size());
+        this->recordTableMemory("Closed", closed);
+        if (bestFirst) this->searchStats["Open Memory"] = open.memoryBytes();
+        this->searchStats["Dropped Nodes"] = droppedNodes;
+        this->searchStats["Pruned Nodes"] = prunedNodes;
+        this->searchStats["Depths"] = layers;
+        if (!bestFirst) this->searchStats["Peak Layer Size"] = peakLayerSize;
+        this->searchStats["Pool Steals"] = threadPool->steals();
+        this->recordWaitStats("Pool Idle", threadPool->workerIdleStats());
+        this->recordWaitStats("Batch Wait", threadPool->groupWaitStats());
+        this->end();
+        if(n == NO_NODE) {
+            return {};
+        }
+        return reconstructPath(n);
+    }
+};
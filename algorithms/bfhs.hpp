@@ -0,0 +1,230 @@
+#pragma once
+#include "search.hpp"
+
+#include "node_arena.hpp"
+#include "closed_set.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * Divide and conquer breadth first heuristic search (Zhou and Hansen 2006), for unit cost problems.
+ * Each iteration searches breadth first, layer by layer, pruning nodes with f above a bound that grows
+ * like IDA*'s threshold. Only the layer being expanded, the layer being generated and the keptLayers
+ * layers before them are stored: in undirected graphs edges only connect neighbouring layers, so the
+ * previous layer catches every duplicate; in directed graphs older duplicates are only regenerated with
+ * a larger g, never missed.
+ *
+ * There are no parent pointers. The nodes in the layer halfway to the bound become relays and every node
+ * deeper than it remembers its relay. Once a goal is found, the path is rebuilt by solving the two halves,
+ * start to relay and relay to goal, with the same search (heading for a known state with
+ * pairwiseHeuristic), recursively until the halves are single moves.
+ */
+template<typename State, typename Cost = float>
+class BFHS : public Search<State, Cost> {
+    struct Node;
+    using Hot = HotNode<Cost>;
+    using Arena = NodeArena<Hot, Node>;
+
+    static constexpr Cost INFINITE_COST = numeric_limits<Cost>::max();
+    static constexpr uint32_t NO_RELAY = numeric_limits<uint32_t>::max();
+
+public:
+    BFHS(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time, size_t keptLayers = 1)
+        : Search<State, Cost>(problemInstance), keptLayers(keptLayers) {
+        this->extra_expansion_time = extra_expansion_time;
+
+        this->searchStats["Algorithm"] = "DCBFHS";
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = 1;
+        this->searchStats["Kept Layers"] = keptLayers;
+    }
+
+    vector<State> findPath() override {
+        this->start();
+
+        const State& initial = this->problemInstance->initial_state;
+        Cost bound = this->heuristic(initial);
+        optional<Found> found;
+        while (!stopped) {
+            iterations++;
+            Cost next = INFINITE_COST;
+            found = layeredSearch(initial, nullptr, bound, next);
+            if (found || stopped || next == INFINITE_COST) break;
+            bound = next;
+        }
+
+        vector<State> path;
+        if (found) {
+            const Found& goal = *found;
+            if (goal.relay) {
+                path = solveSegment(initial, *goal.relay, goal.relayDepth);
+                append(path, solveSegment(*goal.relay, goal.state, goal.depth - goal.relayDepth));
+            } else {
+                path = solveSegment(initial, goal.state, goal.depth);
+            }
+            if (stopped)
+                this->bestBound = goal.depth; // optimal, but the path could not be rebuilt
+            else
+                this->pathLength = goal.depth;
+        } else {
+            this->bestBound = bound; // every f below the bound has been exhausted
+        }
+        return finish(stopped ? vector<State>{} : std::move(path));
+    }
+
+private:
+    struct Node {
+        const State state;
+        uint32_t relay = NO_RELAY; // index into relays of the relay layer node it descends from
+
+        Node(const State& s, uint32_t relay) : state(s), relay(relay) {}
+    };
+
+    // The nodes of one depth, with a table to find them by State
+    struct Layer {
+        Arena nodes;
+        ClosedSet<State, Arena> table;
+
+        explicit Layer(typename ClosedSet<State, Arena>::HashFn hashFn) : table(&nodes, std::move(hashFn)) {}
+
+        bool contains(const State& state, size_t stateHash) const { return table.find(state, stateHash) != NO_NODE; }
+    };
+
+    // A goal reached by layeredSearch and the relay it went through, if it got that deep
+    struct Found {
+        State state;
+        Cost depth{};
+        optional<State> relay;
+        Cost relayDepth{};
+    };
+
+    size_t keptLayers;
+    size_t iterations = 0;
+    size_t segments = 0; // searches run to rebuild the path
+    size_t peakStoredNodes = 0;
+    bool stopped = false;
+
+    unique_ptr<Layer> newLayer() {
+        return make_unique<Layer>([this](const State& state) { return this->hash(state); });
+    }
+
+    /**
+     * Searches breadth first from from, pruning nodes with f above bound, until it reaches target (or any
+     * state with h 0 when target is null)
+     * @param next set to the smallest f above the bound that was pruned
+     * @return the goal and its relay, nothing when there is no path within the bound or a limit was reached
+     */
+    optional<Found> layeredSearch(const State& from, const State* target, Cost bound, Cost& next) {
+        auto h = [&](const State& state) {
+            return target ? this->pairwiseHeuristic(state, *target) : this->heuristic(state);
+        };
+        auto isGoal = [&](const State& state, Cost stateH) {
+            return target ? state == *target : stateH == 0;
+        };
+
+        Cost relayDepth = max<Cost>(1, static_cast<Cost>(static_cast<long>(bound) / 2));
+        vector<State> relays;
+
+        deque<unique_ptr<Layer>> previous;
+        unique_ptr<Layer> current = newLayer();
+        current->table.insert(current->nodes.emplace(Hot{h(from), 0}, from, NO_RELAY), from);
+        if (isGoal(from, h(from))) return Found{from, 0, nullopt, 0};
+
+        for (Cost depth = 0; current->nodes.size() > 0; depth++) {
+            unique_ptr<Layer> successors = newLayer();
+            bool relayLayer = depth + 1 == relayDepth;
+            for (NodeId id = 0; id < current->nodes.size(); id++) {
+                if (this->limitReached()) {
+                    stopped = true;
+                    return nullopt;
+                }
+                this->expandedNodes++;
+                const Node& node = current->nodes.cold(id);
+                for (const auto& successorState : this->getSuccessors(node.state)) {
+                    this->generatedNodes++;
+                    size_t successorHash = current->table.hash(successorState);
+                    bool duplicate = successors->contains(successorState, successorHash) || current->contains(successorState, successorHash);
+                    for (size_t i = 0; !duplicate && i < previous.size(); i++) {
+                        duplicate = previous[i]->contains(successorState, successorHash);
+                    }
+                    if (duplicate) {
+                        this->duplicatedNodes++;
+                        this->generatedNodes--; // undo the generation of the duplicate
+                        continue;
+                    }
+
+                    Cost g = depth + 1;
+                    Cost successorH = h(successorState);
+                    if (g + successorH > bound) {
+                        next = min(next, g + successorH);
+                        continue;
+                    }
+                    uint32_t relay = node.relay;
+                    if (relayLayer) {
+                        relay = static_cast<uint32_t>(relays.size());
+                        relays.push_back(successorState);
+                    }
+                    this->wasteTime(this->extra_expansion_time);
+                    if (isGoal(successorState, successorH)) {
+                        if (relay == NO_RELAY) return Found{successorState, g, nullopt, 0};
+                        return Found{successorState, g, relays[relay], relayDepth};
+                    }
+                    NodeId successor = successors->nodes.emplace(Hot{g + successorH, g}, successorState, relay);
+                    successors->table.insert(successor, successorHash);
+                }
+            }
+
+            size_t stored = successors->nodes.size() + current->nodes.size() + relays.size();
+            for (const auto& layer : previous) {
+                stored += layer->nodes.size();
+            }
+            peakStoredNodes = max(peakStoredNodes, stored);
+
+            previous.push_back(std::move(current));
+            if (previous.size() > keptLayers) previous.pop_front();
+            current = std::move(successors);
+        }
+        return nullopt;
+    }
+
+    // The states of an optimal path of cost cost from from to to, found by splitting it at relays
+    vector<State> solveSegment(const State& from, const State& to, Cost cost) {
+        if (stopped) return {};
+        if (cost == 0) return {from};
+        if (cost == 1) return {from, to};
+        segments++;
+        Cost next = INFINITE_COST;
+        optional<Found> found = layeredSearch(from, &to, cost, next);
+        if (!found) return {}; // stopped by a limit
+        if (!found->relay) {
+            // the cost is optimal, so the target is only reached before the relay layer if cost was too high
+            return found->depth < cost ? solveSegment(from, to, found->depth) : vector<State>{};
+        }
+        vector<State> path = solveSegment(from, *found->relay, found->relayDepth);
+        append(path, solveSegment(*found->relay, to, found->depth - found->relayDepth));
+        return path;
+    }
+
+    // Appends a path that starts at the last state of path
+    static void append(vector<State>& path, const vector<State>& rest) {
+        if (rest.empty()) return;
+        path.insert(path.end(), rest.begin() + 1, rest.end());
+    }
+
+    vector<State> finish(vector<State> path) {
+        this->recordNodeMemory(Arena::NODE_BYTES, peakStoredNodes);
+        this->searchStats["Iterations"] = iterations;
+        this->searchStats["Path Segments"] = segments;
+        this->searchStats["Peak Stored Nodes"] = peakStoredNodes;
+        this->end();
+        return path;
+    }
+};
@@ -1,15 +1,17 @@
 #pragma once
 #include "search.hpp"
 
-#include <boost/unordered/unordered_flat_map.hpp>
-using boost::unordered_flat_map;
-
 #include "immutable_circular_queue.hpp"
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "closed_set.hpp"
+#include "block_pool.hpp"
 
 #include "recent_window_heap.hpp"
 const size_t PRE_HEAP_SIZE = 8;
 
 #include <algorithm>
+#include <limits>
 #include <vector>
 #include <iostream>
 
@@ -31,24 +33,36 @@ class CAFE : public Search<State, Cost> {
 
     struct Node;
     struct NodeCompare;
-    using d_ary_heap = boost::heap::d_ary_heap<Node*, boost::heap::arity<2>, boost::heap::mutable_<true>, boost::heap::compare<NodeCompare>>;
-    using handle_type = typename d_ary_heap::handle_type;
+    using Hot = HotNode<Cost>;
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
+
+    // A successor computed by expand, it only becomes a Node if it is not a duplicate
+    struct Successor {
+        State state;
+        Cost g{}, h{};
+        size_t hash = 0;
+    };
+    using SuccessorPool = BlockPool<Successor>;
 
-    d_ary_heap open{};
-    ImmutableCircularQueue<Node*> openQueue;
-    unordered_flat_map<State, Node*, HashFn> closed;
+    Arena nodes; // shared by the main thread and the speculators, allocation is thread safe
+    MinHeap open;
+    ImmutableCircularQueue<NodeId> openQueue;
+    ClosedSet<State, Arena> closed;
+    SuccessorPool successorBlocks; // recycled once the main thread has merged them
     size_t threadCount;
     atomic<size_t> threadsCompleted{0}; // Track total completed threads
 
 public:
-    CAFE(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time, size_t threadCount) : Search<State, Cost>(problemInstance) {
-        closed = unordered_flat_map<State, Node*, HashFn>(0,     
-            [this](const State& state) {
-                return this->hash(state);
-            });
+    CAFE(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time, size_t threadCount) : Search<State, Cost>(problemInstance),
+        open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}),
+        closed(&nodes, [this](const State& state) {
+            return this->hash(state);
+        }),
+        successorBlocks(problemInstance->maxActionCount()) {
         this->extra_expansion_time = extra_expansion_time;
         this->threadCount = threadCount;
-        this->openQueue = ImmutableCircularQueue<Node*>(threadCount);
+        this->openQueue = ImmutableCircularQueue<NodeId>(threadCount);
 
         this->searchStats["Algorithm"] = "CAFE";
         this->searchStats["Extra Expansion Time"] = extra_expansion_time;
@@ -59,241 +73,307 @@ public:
     
     vector<State> findPath() override {
         this->start();
-        nodes.reserve(20'000'000);
-        nodes.emplace_back(this->problemInstance->initial_state, 0, this->heuristic(this->problemInstance->initial_state), nullptr);
-        Node* startNode = &nodes.back();
-        startNode->status.store(Status::UNVISITED, std::memory_order_relaxed);
+        this->prefaultMemory(nodes, closed, threadCount);
+        Cost startH = this->heuristic(this->problemInstance->initial_state);
+        NodeId startNode = nodes.emplace(Hot{this->fValue(0, startH), 0}, this->problemInstance->initial_state, startH, NO_NODE);
 
         vector<jthread> threads;
         stop_source stopSource;
-        Node* goal = nullptr;
-
-        closed.emplace(startNode->state, startNode);
-        startNode->handle = open.push(startNode);
-        openQueue = openQueue.push(startNode);
-
-        vector<vector<Node>> threadNodePools;
-        threadNodePools.resize(this->threadCount-1);
-
+        NodeId goal = NO_NODE;
+
+        closed.insert(startNode, nodes.cold(startNode).state);
+        if (startH == 0) {
+            offerSolution(startNode);
+        } else {
+            open.push(startNode);
+            openQueue = openQueue.push(startNode);
+        }
 
         for (size_t i = 0; i < this->threadCount-1; i++) {
-            // create a new Node Pool for each thread
-            threadNodePools[i].reserve(20'000'000);
-            threads.emplace_back(&CAFE::thread_speculate, this, i, stopSource.get_token(), &threadNodePools[i]);
+            threads.emplace_back(&CAFE::thread_speculate, this, i, stopSource.get_token());
         }
         clog << "Threads Initialized" << endl;
+        this->pinThread(0);
 
         // While should end when Open is empty and none of the threads are working
         while (true) {
             if (open.empty()){
-                // clog << "Open is empty" << endl;
-                if (threadsCompleted.load(std::memory_order_relaxed) == this->threadCount-1) {
-                    clog << "All threads are done" << endl;
-                    break;
-                }
-                continue;
+                // Only this thread pushes to open, so an empty open means there is no cheaper path than the incumbent
+                clog << "Open is empty" << endl;
+                goal = incumbentNode;
+                break;
             }
-            Node* current = open.top();
-            open.pop();
-
-            if (current->h == 0){
-                goal = current;
+            NodeId current = open.top();
+            if (nodes.hot(current).f >= incumbent.load(std::memory_order_relaxed)) {
+                // goals never go into open, so nothing left can beat the incumbent
+                goal = incumbentNode;
                 break;
             }
+            if (this->limitReached()) {
+                this->bestBound = min(nodes.hot(current).f, incumbent.load(std::memory_order_relaxed));
+                goal = incumbentNode; // the best solution so far, NO_NODE if there is none
+                break;
+            }
+            open.pop();
+
+            Node& currentNode = nodes.cold(current);
 
-            vector<Node*>* computedSuccessors;
             Status expected = Status::UNVISITED;
-            if (current->status.compare_exchange_strong(expected, Status::WORKING, 
+            if (currentNode.status.compare_exchange_strong(expected, Status::WORKING, 
                                                             std::memory_order_acquire, 
                                                             std::memory_order_acq_rel)) {
-                expand(current, nodes);
+                expand(current);
                 this->manualExpandedNodes++;
-                current->status.store(Status::DONE, std::memory_order_release);
+                currentNode.status.store(Status::DONE, std::memory_order_release);
             } else {
-                // wait until its Done
-                while (current->status.load(std::memory_order_acquire) != Status::DONE) {
-                    this_thread::yield();
-                }
+                // a speculator is expanding it, wait until its Done
+                spinThenWait(currentNode.status, [](Status status) { return status == Status::DONE; }, mainWaitStats);
             }
-            computedSuccessors = &current->successors; // memory address of the successors vector
             
-            // add successors to open
+            // add successors to open, only the ones that are not duplicates become nodes
             this->expandedNodes++;
-            for (Node* successor : *computedSuccessors) {
+            Successor* successors = successorBlocks.block(currentNode.successorBlock);
+            for (size_t j = 0; j < currentNode.successorCount; j++) {
+                Successor& successor = successors[j];
                 this->generatedNodes++;
+                Cost f = this->fValue(successor.g, successor.h);
+                if (f >= incumbent.load(std::memory_order_relaxed)) {
+                    prunedNodes++; // cannot lead to a cheaper solution
+                    continue;
+                }
 
                 // duplicate detection
-                auto it = closed.find(successor->state);
-                if (it != closed.end()) {
-                    if (it->second->f > successor->f) {
+                NodeId duplicate = closed.find(successor.state, successor.hash);
+                if (duplicate != NO_NODE) {
+                    if (nodes.hot(duplicate).f > f) {
                         this->duplicatedNodes++;
-                        it->second->g = successor->g;
-                        it->second->f = successor->f;
-                        it->second->parent = successor->parent;
-                        it->second->successors = successor->successors;
-                        it->second->status.store(Status::UNVISITED, std::memory_order_release);
-                        open.update(it->second->handle);
+                        if (successor.h == 0) {
+                            // a goal is never in open nor handed to a speculator, a cheaper path just replaces the incumbent
+                            nodes.hot(duplicate).g = successor.g;
+                            nodes.hot(duplicate).f = f;
+                            nodes.cold(duplicate).parent = current;
+                            offerSolution(duplicate);
+                        } else {
+                            reopen(duplicate, successor.g, current);
+                        }
                     }
                     this->generatedNodes--;
                     continue;
-                } else 
-                    closed.emplace(successor->state, successor);
-                successor->handle = open.push(successor);
+                }
+                NodeId successorNode = nodes.emplace(Hot{f, successor.g}, std::move(successor.state), successor.h, current);
+                closed.insert(successorNode, successor.hash);
+                if (successor.h == 0) {
+                    offerSolution(successorNode);
+                    continue;
+                }
+                open.push(successorNode);
 
                 {
                     lock_guard<mutex> lock(mtx);
-                    openQueue = openQueue.push(successor);
+                    openQueue = openQueue.push(successorNode);
+                    openQueueVersion.fetch_add(1, std::memory_order_release);
                 }
+                openQueueVersion.notify_all();
             }
+            // the block goes back to the pool for the next expansion
+            if (currentNode.successorBlock != SuccessorPool::NO_BLOCK)
+                successorBlocks.release(currentNode.successorBlock);
+            currentNode.successorBlock = SuccessorPool::NO_BLOCK;
+            currentNode.successorCount = 0;
         }
 
         // request stop
         clog << "Requesting Stop" << endl;
         stopSource.request_stop();
+        {
+            // bumped under mtx, so a speculator either snapshots the old version and is woken, or sees the stop
+            lock_guard<mutex> lock(mtx);
+            openQueueVersion.fetch_add(1, std::memory_order_release);
+        }
+        openQueueVersion.notify_all(); // wake the waiting speculators
 
         // join threads
         for(size_t i = 0; i < threads.size(); i++) {
             threads[i].join();
         }
 
-        this->pathLength = goal->g;
+        if (goal != NO_NODE)
+            this->pathLength = nodes.hot(goal).g;
         return finish(goal);
     }
 
 private:
     size_t manualExpandedNodes = 0;
     size_t speculatedNodes = 0;
-    vector<Node> nodes;
-    mutex mtx{};
+    mutex mtx{}; // guards openQueue
+    atomic<uint32_t> openQueueVersion{0}; // bumped on every push to openQueue, speculators wait on it
+    WaitStats mainWaitStats; // main thread waiting for speculators to finish a node
+    WaitStats speculatorWaitStats; // speculators waiting for new nodes
+
+    // The cheapest solution generated so far, only the main thread writes it, speculators read it to skip
+    // nodes that cannot beat it. Goal nodes never go into open.
+    atomic<Cost> incumbent{numeric_limits<Cost>::max()};
+    NodeId incumbentNode = NO_NODE;
+    size_t prunedNodes = 0;
+    size_t prunedSpeculations = 0; // guarded by mtx
+
+    void offerSolution(NodeId goal) {
+        if (nodes.hot(goal).g < incumbent.load(std::memory_order_relaxed)) {
+            incumbent.store(nodes.hot(goal).g, std::memory_order_relaxed);
+            incumbentNode = goal;
+        }
+    }
 
-    enum Status {
+    enum Status : uint8_t {
         UNVISITED = 0,
         WORKING = 1,
         DONE = 2
     };
 
+    // The cold part of a node, the f, g and heap index live in the arena's HotNode
     struct Node {
-        handle_type handle;
         State state;
-        Cost g{}, h{}, f{};
-        Node* parent = nullptr;
+        Cost h{};
+        NodeId parent = NO_NODE;
+        uint32_t successorBlock = SuccessorPool::NO_BLOCK; // successors computed by expand, maxActionCount() slots
+        uint8_t successorCount = 0;
         std::atomic<Status> status{Status::UNVISITED};
-        vector<Node*> successors;
 
-        // Default constructor
-        Node() = default;
-
-        // Constructor for initialisation
-        explicit Node(const State& s) : state(s) {}
-
-        Node(const State& s, Cost g, Cost h, Node* parent = nullptr)
-            : state(s), g(g), h(h), f(g + h), parent(parent) {}
-
-        Node(Node* n)
-            : state(n->state), g(n->g), h(n->h), f(n->f), parent(n->parent) {
-            status.store(n->status.load(std::memory_order_relaxed), std::memory_order_relaxed);
-        }
-
-        Node(const Node& n) : state(n.state), g(n.g), h(n.h), f(n.f), parent(n.parent) {
-            status.store(n.status.load(std::memory_order_relaxed), std::memory_order_relaxed);
-        }
-        Node(Node&& n) : state(n.state), g(n.g), h(n.h), f(n.f), parent(n.parent) {
-            status.store(n.status.load(std::memory_order_relaxed), std::memory_order_relaxed);
-        }
-        
-        bool operator > (const Node& other) const { 
-            if (f == other.f) 
-                return g > other.g;
-            return f > other.f;
-        }
-        bool operator < (const Node& other) const { 
-            if (f == other.f) 
-                return g < other.g;
-            return f < other.f;
-        }
+        Node(const State& s, Cost h, NodeId parent = NO_NODE)
+            : state(s), h(h), parent(parent) {}
+        Node(State&& s, Cost h, NodeId parent)
+            : state(std::move(s)), h(h), parent(parent) {}
     };
 
     struct NodeCompare {
-        bool operator()(const Node* a, const Node* b) const {
-            return *a > *b;
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return x.g < y.g;
+            return x.f < y.f;
         }
     };
 
-    void thread_speculate(size_t id, stop_token st, vector<Node>* nodePool) {
-        // wait until there is something at the ID
-        while (openQueue.size() < id) {
-            this_thread::yield();
-            if(st.stop_requested()) {
-                break;
-            }
-        }
-
+    void thread_speculate(size_t id, stop_token st) {
+        this->pinThread(id + 1);
         // While no stop requested
         while (!st.stop_requested()) {
-
-            optional<Node*> option = openQueue.get(id);
-            if (!option.has_value()) {
-                this_thread::yield();
-                continue;
+            optional<NodeId> option;
+            uint32_t seenVersion = 0;
+            {
+                lock_guard<mutex> lock(mtx);
+                option = openQueue.get(id);
+                seenVersion = openQueueVersion.load(std::memory_order_relaxed);
             }
-
-            Node* n = option.value();
+            if (st.stop_requested()) break; // the last bump may be the one just snapshotted, nothing would wake the wait
 
             // Atomically check if the node's status is `UNVISITED` and set it to `WORKING`
             Status expected = Status::UNVISITED;
-            if (!n->status.compare_exchange_strong(expected, Status::WORKING, 
+            if (!option.has_value() || !nodes.cold(*option).status.compare_exchange_strong(expected, Status::WORKING,
                                                 std::memory_order_acquire, 
                                                 std::memory_order_relaxed)) {
-                // If the CAS fails, the status was not `UNVISITED`
+                // nothing at the ID or the node was already taken, wait for the main thread to push a node
+                spinThenWait(openQueueVersion, [seenVersion](uint32_t version) { return version != seenVersion; }, speculatorWaitStats);
                 continue;
             }
-            expand(n, *nodePool);
-            n->status.store(Status::DONE, std::memory_order_release);
+            NodeId n = option.value();
+            // the main thread drops nodes at or above the incumbent when it pops them, so leave them unexpanded
+            bool pruned = nodes.hot(n).f >= incumbent.load(std::memory_order_relaxed);
+            if (!pruned) expand(n);
+            nodes.cold(n).status.store(Status::DONE, std::memory_order_release);
+            nodes.cold(n).status.notify_all(); // the main thread may be waiting for it
             {
                 lock_guard<mutex> lock(mtx);
-                this->speculatedNodes++;
+                if (pruned)
+                    this->prunedSpeculations++;
+                else
+                    this->speculatedNodes++;
             }
         }
         threadsCompleted.fetch_add(1, std::memory_order_relaxed); // Notifying that this thread is done
     }
 
-    void expand(Node* n, vector<Node>& nodePool) {
-        assert(n->status.load(std::memory_order_acquire) != Status::DONE && "BAD!:: NODE ALREADY COMPLETE"); // Node should not be expanded twice
-        auto successors = this->getSuccessors(n->state);
-        n->successors.reserve(successors.size());
-        for (const auto& successorState : successors) {
-            if (successorState == n->state) continue; // skip the parent state
-
-            Cost g = n->g + this->getCost(n->state, successorState);
-            Cost h = this->heuristic(successorState);
-            Node* parent = n;
-            nodePool.emplace_back(successorState, g, h, parent);
-            Node* successor = &nodePool.back();
-            successor->status.store(Status::UNVISITED, std::memory_order_relaxed);
-
-            n->successors.push_back(successor); // Add the successor* to the parent's list of successors
+    // Generates the successors of n into a recycled block, called by whichever thread won the status CAS
+    void expand(NodeId n) {
+        Node& expanded = nodes.cold(n);
+        assert(expanded.status.load(std::memory_order_acquire) != Status::DONE && "BAD!:: NODE ALREADY COMPLETE"); // Node should not be expanded twice
+        auto successorStates = this->getSuccessors(expanded.state);
+        Cost parentG = nodes.hot(n).g;
+        uint32_t block = successorBlocks.acquire();
+        Successor* successors = successorBlocks.block(block);
+        uint8_t count = 0;
+        for (auto& successorState : successorStates) {
+            if (successorState == expanded.state) continue; // skip the parent state
+
+            Successor& successor = successors[count++];
+            successor.g = parentG + this->getCost(expanded.state, successorState);
+            successor.h = this->heuristic(successorState);
+            successor.hash = closed.hash(successorState); // hashing here takes it off the main thread
+            successor.state = std::move(successorState);
         }
+        expanded.successorBlock = block;
+        expanded.successorCount = count;
         this->wasteTime(this->extra_expansion_time);
     }
 
-    static vector<State> reconstructPath(
-        Node* goal
-    ) {
+    /**
+     * A cheaper path to a node was found. Claims the node so no speculator expands it with the old g,
+     * drops any successors already computed from the old g and puts the node back in open.
+     */
+    void reopen(NodeId id, Cost g, NodeId parent) {
+        Node& node = nodes.cold(id);
+        Status status;
+        while (true) {
+            status = node.status.load(std::memory_order_acquire);
+            if (status == Status::WORKING) { // a speculator is expanding it, wait for it to finish
+                spinThenWait(node.status, [](Status current) { return current != Status::WORKING; }, mainWaitStats);
+                continue;
+            }
+            if (node.status.compare_exchange_weak(status, Status::WORKING, std::memory_order_acquire)) break;
+        }
+        if (status == Status::DONE && node.successorBlock != SuccessorPool::NO_BLOCK) {
+            successorBlocks.release(node.successorBlock);
+            node.successorBlock = SuccessorPool::NO_BLOCK;
+            node.successorCount = 0;
+        }
+        Hot& hot = nodes.hot(id);
+        hot.g = g;
+        hot.f = this->fValue(g, node.h); // h is the same because it's the same state
+        node.parent = parent;
+        node.status.store(Status::UNVISITED, std::memory_order_release);
+        if (open.contains(id))
+            open.update(id);
+        else
+            open.push(id);
+    }
+
+    vector<State> reconstructPath(NodeId goal) const {
         vector<State> path;
-        Node* current = goal;
-        while (current != nullptr) {
-            path.push_back(current->state);
-            current = current->parent;
+        NodeId current = goal;
+        while (current != NO_NODE) {
+            path.push_back(nodes.cold(current).state);
+            current = nodes.cold(current).parent;
         }
         reverse(path.begin(), path.end());
         return path;
     }
 
-    vector<State> finish(Node* n) {
+    vector<State> finish(NodeId n) {
+        this->recordNodeMemory(sizeof(Hot) + sizeof(Node), nodes.size());
+        this->recordTableMemory("Closed", closed);
+        this->searchStats["Open Memory"] = open.memoryBytes();
+        this->searchStats["Successor Blocks"] = successorBlocks.blockCount();
+        this->searchStats["Successor Block Memory"] = successorBlocks.memoryBytes();
         this->searchStats["Manual Expanded Nodes"] = manualExpandedNodes;
         this->searchStats["Speculated Nodes"] = speculatedNodes;
+        this->searchStats["Pruned Nodes"] = prunedNodes;
+        this->searchStats["Pruned Speculations"] = prunedSpeculations;
+        this->recordWaitStats("Main Wait", mainWaitStats);
+        this->recordWaitStats("Speculator Wait", speculatorWaitStats);
         this->end();
-        if(n == nullptr) {
+        if(n == NO_NODE) {
             clog << "No path found" << endl;
             return {};
         }
@@ -0,0 +1,186 @@
+#pragma once
+#include "search.hpp"
+
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "closed_set.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * Enhanced Partial Expansion A* (Felner et al. 2012, Goldenberg et al. 2014). A node in open is keyed by a
+ * stored F, at first its f. Expanding it asks the problem's operator selection function (moveDeltaF) how
+ * much each move changes f and generates only the successors whose f equals the stored F. If moves with a
+ * larger f are left the node goes back into open with the next of those as its stored F, otherwise it is
+ * done. Successors that would never reach the top of open are never allocated, hashed or pushed.
+ *
+ * Path costs and heuristics must be integers (stored in Cost) so f values compare exactly.
+ */
+template<typename State, typename Cost, typename Instance>
+class EPEAStar : public Search<State, Cost> {
+    static_assert(PartialExpansionProblem<Instance, State, Cost>, "EPEAStar needs a problem with an operator selection function");
+
+    struct Node;
+    struct NodeCompare;
+    using Move = typename Instance::Move;
+    using Hot = HotNode<Cost>; // f holds the stored F
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
+
+    static constexpr Cost INFINITE_COST = numeric_limits<Cost>::max();
+
+public:
+    EPEAStar(const Instance* problemInstance, size_t extra_expansion_time)
+        : Search<State, Cost>(problemInstance), instance(problemInstance),
+        open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}),
+        closed(&nodes, [this](const State& state) {
+            return this->hash(state);
+        }) {
+        this->extra_expansion_time = extra_expansion_time;
+
+        this->searchStats["Algorithm"] = "EPEA*";
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = 1;
+    }
+
+    vector<State> findPath() override {
+        this->start();
+        this->prefaultMemory(nodes, closed, 1);
+
+        Cost startH = this->heuristic(this->problemInstance->initial_state);
+        NodeId startNode = nodes.emplace(Hot{startH, 0}, this->problemInstance->initial_state, startH, NO_NODE);
+
+        closed.insert(startNode, nodes.cold(startNode).state);
+        open.push(startNode);
+
+        while (!open.empty()) {
+            NodeId current = open.top();
+            if (this->limitReached()) {
+                this->bestBound = nodes.hot(current).f;
+                break;
+            }
+            open.pop();
+            if (nodes.cold(current).h == 0){
+                this->pathLength = nodes.hot(current).g;
+                return finish(current);
+            }
+            expand(current);
+        }
+        return finish(NO_NODE);
+    }
+
+private:
+    // The cold part of a node, the stored F, g and heap index live in the arena's HotNode
+    struct Node {
+        const State state;
+        Cost h{};
+        NodeId parent = NO_NODE;
+
+        Node(const State& s, Cost h, NodeId parent) : state(s), h(h), parent(parent) {}
+    };
+
+    struct NodeCompare {
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return x.g < y.g;
+            return x.f < y.f;
+        }
+    };
+
+    const Instance* instance;
+    Arena nodes;
+    MinHeap open;
+    ClosedSet<State, Arena> closed;
+
+    size_t reinsertions = 0; // expansions that put the node back with a larger stored F
+    size_t skippedMoves = 0; // moves left for a later expansion of the same node
+
+    void expand(NodeId n) {
+        this->expandedNodes++;
+        const State& state = nodes.cold(n).state;
+        const Cost h = nodes.cold(n).h;
+        const Cost g = nodes.hot(n).g;
+        const Cost offset = nodes.hot(n).f - (g + h); // the stored F is f plus this
+
+        Move moves[Instance::MAX_MOVES];
+        size_t moveCount = instance->getMoves(state, moves);
+        Cost nextOffset = INFINITE_COST;
+        for (size_t i = 0; i < moveCount; i++) {
+            Cost delta = instance->moveDeltaF(state, moves[i], h);
+            if (delta != offset) {
+                if (delta > offset) {
+                    skippedMoves++;
+                    nextOffset = min(nextOffset, delta);
+                }
+                continue; // generated by an earlier expansion or left for a later one
+            }
+
+            State successorState = instance->successor(state, moves[i]);
+            this->generatedNodes++;
+            Cost successorG = g + this->getCost(state, successorState);
+
+            size_t successorHash = closed.hash(successorState);
+            NodeId duplicate = closed.find(successorState, successorHash);
+            if (duplicate != NO_NODE) {
+                Hot& duplicateNode = nodes.hot(duplicate);
+                if (duplicateNode.g > successorG) {
+                    // the improved node starts over from its f, all of its moves are generated again
+                    this->duplicatedNodes++;
+                    duplicateNode.g = successorG;
+                    duplicateNode.f = successorG + nodes.cold(duplicate).h;
+                    nodes.cold(duplicate).parent = n;
+                    if (open.contains(duplicate))
+                        open.update(duplicate);
+                    else
+                        open.push(duplicate); // reopen
+                }
+                this->generatedNodes--; // undo the generation of the duplicate
+                continue;
+            }
+
+            Cost successorH = h + delta - (successorG - g); // what the operator selection function already knew
+            NodeId successor = nodes.emplace(Hot{successorG + successorH, successorG}, successorState, successorH, n);
+            closed.insert(successor, successorHash);
+            this->wasteTime(this->extra_expansion_time);
+            open.push(successor);
+        }
+
+        if (nextOffset != INFINITE_COST) {
+            reinsertions++;
+            nodes.hot(n).f = g + h + nextOffset;
+            open.push(n);
+        }
+    }
+
+    vector<State> reconstructPath(NodeId goal) const {
+        vector<State> path;
+        NodeId current = goal;
+        while (current != NO_NODE) {
+            path.push_back(nodes.cold(current).state);
+            current = nodes.cold(current).parent;
+        }
+        reverse(path.begin(), path.end());
+        return path;
+    }
+
+    vector<State> finish(NodeId n) {
+        this->recordNodeMemory(sizeof(Hot) + sizeof(Node), nodes.size());
+        this->recordTableMemory("Closed", closed);
+        this->searchStats["Open Memory"] = open.memoryBytes();
+        this->searchStats["Reinsertions"] = reinsertions;
+        this->searchStats["Skipped Moves"] = skippedMoves;
+        this->end();
+        if(n == NO_NODE) {
+            return {};
+        }
+        return reconstructPath(n);
+    }
+};
@@ -0,0 +1,274 @@
+#pragma once
+#include "search.hpp"
+
+#include "async_file_writer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * External memory A* (Edelkamp, Jabbar and Schroedl 2004) with delayed duplicate detection, for problems
+ * with integer costs and a consistent heuristic whose states can be packed (SerializableProblem).
+ *
+ * Open and closed live in files under a scratch directory: one bucket per (g, h), each split into
+ * PARTITIONS files by state hash. A record is the packed state followed by its packed parent. Buckets are
+ * expanded in order of f, then g; successors are appended to their buckets through buffers that an
+ * AsyncFileWriter writes while the search goes on, and the next partition is read ahead while the current
+ * one is expanded. Duplicates are only removed when a partition is about to be expanded: within it, and
+ * against the same partition of the buckets with the same h and the locality previous g values (2 is
+ * enough for undirected unit cost graphs, other duplicates are only expanded again). Only one partition,
+ * with its previous layers, has to fit in memory.
+ *
+ * The path is rebuilt backwards from the goal record by looking each parent up in its bucket.
+ */
+template<typename State, typename Cost, typename Instance>
+class ExternalAStar : public Search<State, Cost> {
+    static_assert(SerializableProblem<Instance, State>, "ExternalAStar needs a problem whose states can be packed");
+
+    static constexpr size_t PARTITIONS = 16;
+    static constexpr size_t BUFFER_BYTES = size_t(1) << 20; // per bucket partition being written
+
+    // A bucket key, (g, h)
+    using Bucket = pair<long, long>;
+    using Bytes = vector<unsigned char>;
+
+    // What a partition needs to be expanded: its records and those of the same partition in previous layers
+    struct Loaded {
+        Bytes records;
+        vector<Bytes> previous;
+    };
+
+    // The scratch directory, removed with all its buckets when the search ends or throws
+    struct ScratchDirectory {
+        string path;
+
+        ~ScratchDirectory() { remove(); }
+
+        void remove() {
+            if (path.empty()) return;
+            error_code ignored;
+            filesystem::remove_all(path, ignored);
+            path.clear();
+        }
+    };
+
+public:
+    ExternalAStar(const Instance* problemInstance, size_t extra_expansion_time, string directory = "/tmp", size_t locality = 2)
+        : Search<State, Cost>(problemInstance), instance(problemInstance), directory(std::move(directory)), locality(locality),
+        stateBytes(problemInstance->packedBytes()), recordBytes(2 * stateBytes) {
+        this->extra_expansion_time = extra_expansion_time;
+
+        this->searchStats["Algorithm"] = "External A*";
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = 1;
+        this->searchStats["Partitions"] = PARTITIONS;
+        this->searchStats["Locality"] = locality;
+        this->searchStats["Record Bytes"] = recordBytes;
+    }
+
+    vector<State> findPath() override {
+        this->start();
+        string pattern = directory + "/external-astar-XXXXXX";
+        if (mkdtemp(pattern.data()) == nullptr) throw runtime_error("Could not create a scratch directory in " + directory);
+        scratch.path = pattern;
+        this->searchStats["Scratch Directory"] = scratch.path;
+
+        const State& initial = this->problemInstance->initial_state;
+        Bytes record(recordBytes);
+        instance->pack(initial, record.data());
+        instance->pack(initial, record.data() + stateBytes); // the root is its own parent
+        add({0, static_cast<long>(this->heuristic(initial))}, partition(initial), record.data());
+        flushBuffers();
+
+        Bytes goal;
+        long goalG = -1;
+        while (!pending.empty() && goalG < 0 && !stopped) {
+            auto [f, g] = *pending.begin();
+            pending.erase(pending.begin());
+            Bucket bucket{g, f - g};
+            writer.drain(); // every record of the bucket is on disk
+            goalG = expandBucket(bucket, goal);
+            flushBuffers();
+            buckets++;
+        }
+        writer.drain();
+
+        vector<State> path;
+        if (goalG >= 0) {
+            this->pathLength = goalG;
+            path = reconstructPath(goal, goalG);
+        } else if (stopped) {
+            this->bestBound = stoppedAt;
+        }
+        return finish(std::move(path));
+    }
+
+private:
+    const Instance* instance;
+    string directory;
+    size_t locality;
+    size_t stateBytes, recordBytes;
+
+    ScratchDirectory scratch; // before the writer, so the writer finishes its writes before the directory goes
+    AsyncFileWriter writer;
+    map<pair<Bucket, size_t>, Bytes> buffers; // records not yet queued, per bucket partition
+    set<pair<long, long>> pending; // (f, g) of the buckets with records that have not been expanded
+    set<Bucket> expanded;
+
+    size_t buckets = 0;
+    size_t bytesRead = 0;
+    bool stopped = false;
+    long stoppedAt = 0;
+
+    size_t partition(const State& state) const { return this->hash(state) % PARTITIONS; }
+
+    string path(Bucket bucket, size_t part) const {
+        return scratch.path + "/" + to_string(bucket.first) + "_" + to_string(bucket.second) + "_" + to_string(part);
+    }
+
+    // Buffers a record for a bucket partition, queueing the buffer once it is full
+    void add(Bucket bucket, size_t part, const unsigned char* record) {
+        if (expanded.count(bucket)) {
+            throw runtime_error("External A* needs a consistent heuristic, a record went to an expanded bucket");
+        }
+        pending.insert({bucket.first + bucket.second, bucket.first});
+        Bytes& buffer = buffers[{bucket, part}];
+        buffer.insert(buffer.end(), record, record + recordBytes);
+        if (buffer.size() >= BUFFER_BYTES) {
+            writer.append(path(bucket, part), std::move(buffer));
+            buffers.erase({bucket, part});
+        }
+    }
+
+    void flushBuffers() {
+        for (auto& [key, buffer] : buffers) {
+            writer.append(path(key.first, key.second), std::move(buffer));
+        }
+        buffers.clear();
+    }
+
+    Loaded load(Bucket bucket, size_t part) const {
+        Loaded loaded{AsyncFileWriter::readFile(path(bucket, part)), {}};
+        for (size_t k = 1; k <= locality && static_cast<long>(k) <= bucket.first; k++) {
+            loaded.previous.push_back(AsyncFileWriter::readFile(path({bucket.first - k, bucket.second}, part)));
+        }
+        return loaded;
+    }
+
+    /**
+     * Removes the duplicates from each partition of the bucket, writes the partition back as it is now
+     * closed and expands its states
+     * @return the g of the goal when the bucket holds one, which is then copied to goal, otherwise -1
+     */
+    long expandBucket(Bucket bucket, Bytes& goal) {
+        auto [g, h] = bucket;
+        expanded.insert(bucket);
+        future<Loaded> next = async(launch::async, [this, bucket] { return load(bucket, 0); });
+        for (size_t part = 0; part < PARTITIONS; part++) {
+            Loaded loaded = next.get();
+            if (part + 1 < PARTITIONS) next = async(launch::async, [this, bucket, part] { return load(bucket, part + 1); });
+            if (loaded.records.empty()) continue;
+            bytesRead += loaded.records.size();
+
+            std::unordered_set<string_view> seen;
+            for (const Bytes& layer : loaded.previous) {
+                bytesRead += layer.size();
+                for (size_t i = 0; i < layer.size(); i += recordBytes) {
+                    seen.insert(key(layer.data() + i));
+                }
+            }
+            Bytes closed;
+            for (size_t i = 0; i < loaded.records.size(); i += recordBytes) {
+                const unsigned char* record = loaded.records.data() + i;
+                if (!seen.insert(key(record)).second) {
+                    this->duplicatedNodes++;
+                    continue;
+                }
+                closed.insert(closed.end(), record, record + recordBytes);
+            }
+
+            for (size_t i = 0; i < closed.size(); i += recordBytes) {
+                const unsigned char* record = closed.data() + i;
+                if (this->limitReached()) {
+                    stopped = true;
+                    stoppedAt = g + h;
+                    return -1;
+                }
+                if (h == 0) {
+                    goal.assign(record, record + recordBytes);
+                    writer.replace(path(bucket, part), std::move(closed));
+                    return g;
+                }
+                expand(instance->unpack(record), record, g);
+            }
+            writer.replace(path(bucket, part), std::move(closed));
+        }
+        return -1;
+    }
+
+    void expand(const State& state, const unsigned char* record, long g) {
+        this->expandedNodes++;
+        Bytes successorRecord(recordBytes);
+        copy(record, record + stateBytes, successorRecord.begin() + stateBytes);
+        for (const auto& successorState : this->getSuccessors(state)) {
+            if (successorState == state) continue; // skip the parent state
+            this->generatedNodes++;
+            long successorG = g + static_cast<long>(this->getCost(state, successorState));
+            long successorH = static_cast<long>(this->heuristic(successorState));
+            instance->pack(successorState, successorRecord.data());
+            this->wasteTime(this->extra_expansion_time);
+            add({successorG, successorH}, partition(successorState), successorRecord.data());
+        }
+    }
+
+    string_view key(const unsigned char* record) const {
+        return string_view(reinterpret_cast<const char*>(record), stateBytes);
+    }
+
+    // Follows the parents of the goal record back to the root, each one is in the closed file of its bucket
+    vector<State> reconstructPath(Bytes record, long g) {
+        vector<State> path{instance->unpack(record.data())};
+        while (!equal(record.begin(), record.begin() + stateBytes, record.begin() + stateBytes)) {
+            State parent = instance->unpack(record.data() + stateBytes);
+            g -= static_cast<long>(this->getCost(parent, path.back()));
+            Bucket bucket{g, static_cast<long>(this->heuristic(parent))};
+            Bytes records = AsyncFileWriter::readFile(this->path(bucket, partition(parent)));
+            bytesRead += records.size();
+            string_view wanted = key(record.data() + stateBytes);
+            bool found = false;
+            for (size_t i = 0; i < records.size() && !found; i += recordBytes) {
+                if (key(records.data() + i) == wanted) {
+                    record.assign(records.begin() + i, records.begin() + i + recordBytes);
+                    found = true;
+                }
+            }
+            if (!found) throw runtime_error("External A* lost the parent of a path state");
+            path.push_back(std::move(parent));
+        }
+        reverse(path.begin(), path.end());
+        return path;
+    }
+
+    vector<State> finish(vector<State> path) {
+        this->searchStats["Buckets Expanded"] = buckets;
+        this->searchStats["Bytes Written"] = writer.bytesWritten();
+        this->searchStats["Bytes Read"] = bytesRead;
+        this->searchStats["Write Wait Time"] = writer.waitTime();
+        scratch.remove();
+        this->end();
+        return path;
+    }
+};
@@ -0,0 +1,279 @@
+#pragma once
+#include "search.hpp"
+
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "path_finding.hpp"
+#include "grid_abstraction.hpp"
+
+#include <boost/unordered/unordered_flat_map.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * HPA* (Botea, Muller and Schaeffer 2004), the query side of a GridAbstraction. The start and the goals are
+ * linked to the transitions of their clusters by a search inside each cluster, then A* plans over the
+ * transitions, collecting the goals, with the grid's Manhattan distance as heuristic. The abstract path is
+ * refined one hop at a time: a hop across a border is a move, a hop inside a cluster is a breadth first
+ * search in it. A robot can start moving once the first hop is refined ("First Move Time"), the rest of the
+ * path does not have to be refined before it is needed.
+ *
+ * Crossing borders only at the transitions makes paths slightly longer than optimal, with no bound.
+ */
+template<typename Cost = float>
+class HPAStar : public Search<Pathfinding::State, Cost> {
+    using State = Pathfinding::State;
+    using Grid = Pathfinding::PathfindingInstance<State, Cost>;
+    using Abstraction = Pathfinding::GridAbstraction;
+    using Edge = Abstraction::Edge;
+    using Key = uint64_t; // an abstract node in the high half, the goals left to collect in the low half
+
+    struct Node;
+    struct NodeCompare;
+    using Hot = HotNode<Cost>;
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
+    using Clock = chrono::high_resolution_clock;
+
+public:
+    static constexpr size_t MAX_GOALS = 32;
+
+    HPAStar(const Grid* grid, const Abstraction* abstraction, size_t extra_expansion_time)
+        : Search<State, Cost>(grid), grid(grid), abstraction(abstraction),
+        open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}) {
+        this->extra_expansion_time = extra_expansion_time;
+        if (grid->initial_state.goals.size() > MAX_GOALS) throw invalid_argument("HPA* plans for at most " + to_string(MAX_GOALS) + " goals");
+
+        this->searchStats["Algorithm"] = "HPA*";
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = 1;
+        this->searchStats["Cluster Size"] = abstraction->clusterSize;
+        this->searchStats["Clusters"] = abstraction->clusters.size();
+        this->searchStats["Transitions"] = abstraction->transitions.size();
+        this->searchStats["Abstraction Time"] = abstraction->buildTime;
+    }
+
+    vector<State> findPath() override {
+        this->start();
+        auto plannedAt = Clock::now();
+        addQueryPoints();
+        NodeId goal = planAbstractPath();
+        double planTime = chrono::duration<double>(Clock::now() - plannedAt).count();
+        this->searchStats["Abstract Search Time"] = planTime;
+        if (goal == NO_NODE) return finish({});
+
+        hops.clear();
+        for (NodeId n = goal; n != NO_NODE; n = nodes.cold(n).parent) {
+            hops.push_back(static_cast<uint32_t>(nodes.cold(n).state >> 32));
+        }
+        reverse(hops.begin(), hops.end());
+        this->searchStats["Abstract Hops"] = hops.size() - 1;
+
+        auto refineStart = Clock::now();
+        vector<State> path{grid->initial_state};
+        for (size_t hop = 0; hop + 1 < hops.size(); hop++) {
+            refineHop(hop, path);
+            if (hop == 0) this->searchStats["First Move Time"] = chrono::duration<double>(Clock::now() - this->clockStart).count();
+        }
+        this->searchStats["Refinement Time"] = chrono::duration<double>(Clock::now() - refineStart).count();
+        this->pathLength = static_cast<long>(path.size() - 1);
+        return finish(std::move(path));
+    }
+
+    /**
+     * Appends the moves of one hop of the abstract path to path, so a caller can refine hops as it follows them
+     * @param hop the index of the hop, between the hop-th and the next abstract node
+     */
+    void refineHop(size_t hop, vector<State>& path) const {
+        Position from = cellOf(hops[hop]);
+        Position to = cellOf(hops[hop + 1]);
+        uint32_t cluster = abstraction->clusterOf(from);
+        vector<Position> cells;
+        if (cluster != abstraction->clusterOf(to)) {
+            cells.push_back(to); // across a border
+        } else {
+            vector<uint32_t> parents;
+            abstraction->distancesInCluster(cluster, {from}, &parents);
+            const auto& bounds = abstraction->clusters[cluster];
+            for (Position cell = to; !(cell == from);) {
+                cells.push_back(cell);
+                uint32_t parent = parents[abstraction->localIndex(bounds, cell)];
+                cell = Position{bounds.row + parent / bounds.width, bounds.col + parent % bounds.width};
+            }
+            reverse(cells.begin(), cells.end());
+        }
+        for (const Position& cell : cells) {
+            State next = path.back();
+            Pathfinding::applyMove(next, cell);
+            path.push_back(std::move(next));
+        }
+    }
+
+private:
+    // The cold part of a node, the f, g and heap index live in the arena's HotNode
+    struct Node {
+        const Key state;
+        NodeId parent = NO_NODE;
+
+        Node(Key key, NodeId parent) : state(key), parent(parent) {}
+    };
+
+    struct NodeCompare {
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return x.g > y.g;
+            return x.f < y.f;
+        }
+    };
+
+    const Grid* grid;
+    const Abstraction* abstraction;
+    Arena nodes;
+    MinHeap open;
+    boost::unordered_flat_map<Key, NodeId> closed; // a key is small, it needs no ClosedSet
+
+    // Abstract nodes are the transitions, then the start, then the goals
+    vector<Position> points; // the start and the goals
+    vector<vector<Edge>> pointEdges;
+    boost::unordered_flat_map<uint32_t, vector<Edge>> transitionToPoint; // the edges back to the points
+    vector<uint32_t> goalBit; // per abstract node, the goal it stands on, 0 for none
+    vector<uint32_t> hops; // the abstract path
+
+    inline uint32_t transitionCount() const {
+        return static_cast<uint32_t>(abstraction->transitions.size());
+    }
+
+    inline Position cellOf(uint32_t node) const {
+        return node < transitionCount() ? abstraction->transitions[node].cell : points[node - transitionCount()];
+    }
+
+    // Links the start and every goal to the transitions and the other points of their clusters
+    void addQueryPoints() {
+        points.push_back(grid->initial_state.actor);
+        for (const auto& goal : grid->initial_state.goals) {
+            points.push_back(goal);
+        }
+        boost::unordered_flat_map<Position, uint32_t> goalBits;
+        for (size_t i = 1; i < points.size(); i++) {
+            goalBits[points[i]] |= uint32_t(1) << (i - 1);
+        }
+        goalBit.assign(transitionCount() + points.size(), 0);
+        for (uint32_t node = 0; node < goalBit.size(); node++) {
+            auto it = goalBits.find(cellOf(node));
+            if (it != goalBits.end()) goalBit[node] = it->second;
+        }
+
+        pointEdges.assign(points.size(), {});
+        for (size_t i = 0; i < points.size(); i++) {
+            uint32_t cluster = abstraction->clusterOf(points[i]);
+            const auto& bounds = abstraction->clusters[cluster];
+            vector<uint16_t> distances = abstraction->distancesInCluster(cluster, {points[i]});
+            uint32_t self = transitionCount() + static_cast<uint32_t>(i);
+            for (uint32_t transition : bounds.transitions) {
+                uint16_t distance = distances[abstraction->localIndex(bounds, abstraction->transitions[transition].cell)];
+                if (distance == Abstraction::UNREACHABLE) continue;
+                pointEdges[i].push_back(Edge{transition, distance});
+                transitionToPoint[transition].push_back(Edge{self, distance});
+            }
+            for (size_t j = 0; j < points.size(); j++) {
+                if (j == i || abstraction->clusterOf(points[j]) != cluster) continue;
+                uint16_t distance = distances[abstraction->localIndex(bounds, points[j])];
+                if (distance != Abstraction::UNREACHABLE) pointEdges[i].push_back(Edge{transitionCount() + static_cast<uint32_t>(j), distance});
+            }
+        }
+    }
+
+    // Manhattan distance to the closest goal left
+    Cost heuristic(uint32_t node, uint32_t goalsLeft) const {
+        Position cell = cellOf(node);
+        Cost closest = goalsLeft == 0 ? 0 : numeric_limits<Cost>::max();
+        for (size_t i = 1; i < points.size(); i++) {
+            if (!(goalsLeft & (uint32_t(1) << (i - 1)))) continue;
+            closest = min<Cost>(closest, std::abs((int)cell.row - (int)points[i].row) + std::abs((int)cell.col - (int)points[i].col));
+        }
+        return closest;
+    }
+
+    // A* over the abstract nodes and the goals left, @return the node that collected the last goal
+    NodeId planAbstractPath() {
+        uint32_t allGoals = points.size() > 1 ? static_cast<uint32_t>((uint64_t(1) << (points.size() - 1)) - 1) : 0;
+        uint32_t start = transitionCount();
+        uint32_t startGoals = allGoals & ~goalBit[start];
+        Key startKey = Key(start) << 32 | startGoals;
+        NodeId startNode = nodes.emplace(Hot{heuristic(start, startGoals), 0}, startKey, NO_NODE);
+        closed[startKey] = startNode;
+        open.push(startNode);
+
+        while (!open.empty()) {
+            NodeId current = open.top();
+            if (this->limitReached()) {
+                this->bestBound = nodes.hot(current).f;
+                return NO_NODE;
+            }
+            open.pop();
+            Key key = nodes.cold(current).state;
+            uint32_t node = static_cast<uint32_t>(key >> 32);
+            uint32_t goalsLeft = static_cast<uint32_t>(key);
+            if (goalsLeft == 0) return current;
+            this->expandedNodes++;
+
+            auto relax = [&](const Edge& edge) {
+                this->generatedNodes++;
+                Cost g = nodes.hot(current).g + edge.cost;
+                uint32_t left = goalsLeft & ~goalBit[edge.to];
+                Key successorKey = Key(edge.to) << 32 | left;
+                auto found = closed.find(successorKey);
+                if (found != closed.end()) {
+                    NodeId duplicate = found->second;
+                    this->generatedNodes--; // undo the generation of the duplicate
+                    Hot& duplicateNode = nodes.hot(duplicate);
+                    if (duplicateNode.g <= g) return;
+                    this->duplicatedNodes++;
+                    duplicateNode.f += g - duplicateNode.g;
+                    duplicateNode.g = g;
+                    nodes.cold(duplicate).parent = current;
+                    if (open.contains(duplicate))
+                        open.update(duplicate);
+                    else
+                        open.push(duplicate);
+                    return;
+                }
+                NodeId successor = nodes.emplace(Hot{g + heuristic(edge.to, left), g}, successorKey, current);
+                closed[successorKey] = successor;
+                this->wasteTime(this->extra_expansion_time);
+                open.push(successor);
+            };
+            if (node < transitionCount()) {
+                for (const Edge& edge : abstraction->transitions[node].edges) relax(edge);
+                auto it = transitionToPoint.find(node);
+                if (it != transitionToPoint.end()) {
+                    for (const Edge& edge : it->second) relax(edge);
+                }
+            } else {
+                for (const Edge& edge : pointEdges[node - transitionCount()]) relax(edge);
+            }
+        }
+        return NO_NODE;
+    }
+
+    vector<State> finish(vector<State> path) {
+        this->suboptimality = 0; // transitions cut the paths, no bound on how much longer they get
+        this->recordNodeMemory(sizeof(Hot) + sizeof(Node), nodes.size());
+        this->recordTableMemory("Closed", closed);
+        this->searchStats["Open Memory"] = open.memoryBytes();
+        this->end();
+        return path;
+    }
+};
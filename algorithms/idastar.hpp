@@ -0,0 +1,168 @@
+#pragma once
+#include "search.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+// The Move type of an InPlaceProblem, a placeholder for other problems
+template<typename Instance>
+struct InPlaceMove {
+    using type = char;
+};
+template<typename Instance> requires requires { typename Instance::Move; }
+struct InPlaceMove<Instance> {
+    using type = typename Instance::Move;
+};
+
+/**
+ * Iterative deepening A*: depth first searches bounded by an f threshold that grows to the smallest f
+ * that exceeded it. There is no open or closed list, memory is just the current path.
+ *
+ * When the Instance implements InPlaceProblem a single State is changed in place and restored on the
+ * way back, with the heuristic updated incrementally and the move back to the parent pruned. Otherwise
+ * successors are copied from getSuccessors and the parent state is pruned.
+ */
+template<typename State, typename Cost = float, typename Instance = ProblemInstance<State, Cost>>
+class IDAStar : public Search<State, Cost> {
+    static constexpr Cost INFINITE_COST = numeric_limits<Cost>::max();
+
+public:
+    IDAStar(const Instance* problemInstance, size_t extra_expansion_time) : Search<State, Cost>(problemInstance),
+        instance(problemInstance) {
+        this->extra_expansion_time = extra_expansion_time;
+
+        this->searchStats["Algorithm"] = "IDA*";
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = 1;
+    }
+    IDAStar(const Instance* problemInstance) : IDAStar(problemInstance, 0) {}
+
+    vector<State> findPath() override {
+        this->start();
+
+        State state = this->problemInstance->initial_state;
+        Cost h = this->heuristic(state);
+        threshold = h;
+        while (true) {
+            iterations++;
+            Cost next;
+            if constexpr (InPlaceProblem<Instance, State, Cost>) {
+                next = searchInPlace(state, 0, h, nullptr);
+            } else {
+                statePath.assign(1, state);
+                next = searchCopying(0, h);
+            }
+            if (found || this->status != SearchStatus::NoSolution) break;
+            if (next == INFINITE_COST) break; // every path was cut off by the problem, not the threshold
+            threshold = next;
+        }
+        return finish();
+    }
+
+private:
+    using Move = typename InPlaceMove<Instance>::type;
+
+    const Instance* instance;
+    Cost threshold{};
+    size_t iterations = 0;
+    bool found = false;
+    vector<Move> movePath; // moves from the initial state to the current one (in place search)
+    vector<State> statePath; // states from the initial state to the current one (copying search)
+
+    // @return the smallest f above the threshold seen below this node
+    Cost searchInPlace(State& state, Cost g, Cost h, const Move* parentInverse) requires InPlaceProblem<Instance, State, Cost> {
+        Cost f = g + h;
+        if (f > threshold) return f;
+        if (h == 0) {
+            found = true;
+            this->pathLength = g;
+            return f;
+        }
+        if (this->limitReached()) return INFINITE_COST;
+        this->expandedNodes++;
+
+        Move moves[Instance::MAX_MOVES];
+        size_t moveCount = instance->getMoves(state, moves);
+        Cost next = INFINITE_COST;
+        for (size_t i = 0; i < moveCount; i++) {
+            if (parentInverse != nullptr && moves[i] == *parentInverse) continue; // skip the parent state
+            this->generatedNodes++;
+            Cost cost = instance->moveCost(state, moves[i]);
+            Move inverse = instance->inverseMove(state, moves[i]);
+            Cost childH = instance->applyInPlace(state, moves[i], h);
+            this->wasteTime(this->extra_expansion_time);
+
+            movePath.push_back(moves[i]);
+            Cost t = searchInPlace(state, g + cost, childH, &inverse);
+            if (found || this->status != SearchStatus::NoSolution) return t;
+            movePath.pop_back();
+
+            instance->applyInPlace(state, inverse, childH);
+            next = min(next, t);
+        }
+        return next;
+    }
+
+    // Same as searchInPlace for problems without the in place interface, the current state is statePath.back()
+    Cost searchCopying(Cost g, Cost h) {
+        Cost f = g + h;
+        if (f > threshold) return f;
+        if (h == 0) {
+            found = true;
+            this->pathLength = g;
+            return f;
+        }
+        if (this->limitReached()) return INFINITE_COST;
+        this->expandedNodes++;
+
+        size_t depth = statePath.size() - 1;
+        Cost next = INFINITE_COST;
+        for (auto& successor : this->getSuccessors(statePath[depth])) {
+            if (successor == statePath[depth]) continue;
+            if (depth > 0 && successor == statePath[depth - 1]) continue; // skip the parent state
+            this->generatedNodes++;
+            Cost cost = this->getCost(statePath[depth], successor);
+            Cost childH = this->heuristic(successor);
+            this->wasteTime(this->extra_expansion_time);
+
+            statePath.push_back(std::move(successor));
+            Cost t = searchCopying(g + cost, childH);
+            if (found || this->status != SearchStatus::NoSolution) return t;
+            statePath.pop_back();
+
+            next = min(next, t);
+        }
+        return next;
+    }
+
+    vector<State> reconstructPath() {
+        if constexpr (InPlaceProblem<Instance, State, Cost>) {
+            vector<State> path;
+            State state = this->problemInstance->initial_state;
+            path.push_back(state);
+            for (const Move& move : movePath) {
+                instance->applyInPlace(state, move, 0);
+                path.push_back(state);
+            }
+            return path;
+        } else {
+            return statePath;
+        }
+    }
+
+    vector<State> finish() {
+        this->bestBound = threshold; // every f below the threshold has been exhausted
+        this->searchStats["Iterations"] = iterations;
+        this->searchStats["Final Threshold"] = static_cast<double>(threshold);
+        this->searchStats["Max Path Memory"] = movePath.capacity() * sizeof(Move) + statePath.capacity() * sizeof(State);
+        this->end();
+        if (!found) {
+            return {};
+        }
+        return reconstructPath();
+    }
+};
@@ -3,15 +3,15 @@
 #pragma once
 #include "search.hpp"
 
-#include <boost/unordered/unordered_flat_map.hpp>
-using boost::unordered_flat_map;
-
-#include <queue>
-#include <boost/heap/d_ary_heap.hpp>
-#include <utils/ctpl.hpp>
+#include "work_stealing_pool.hpp"
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "closed_set.hpp"
 
 #include <algorithm>
+#include <limits>
 #include <vector>
+#include <optional>
 #include <iostream>
 
 #include <thread>
@@ -27,25 +27,23 @@ class KBFS : public Search<State, Cost> {
     using HashFn = typename Search<State, Cost>::HashFn;
 
     size_t threadCount;
-    ctpl::thread_pool threadPool;
+    optional<WorkStealingPool> threadPool; // threadCount - 1 workers, the main thread runs tasks while it waits
     struct Node;
     struct NodeCompare;
-    using d_ary_heap = boost::heap::d_ary_heap<Node*, boost::heap::arity<2>, boost::heap::mutable_<true>, boost::heap::compare<NodeCompare>>;
-    using handle_type = typename d_ary_heap::handle_type;
+    using Hot = HotNode<Cost>;
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
 
 
 public:
-    KBFS(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time, size_t threadCount) : Search<State, Cost>(problemInstance), threadPool(threadCount) {
-        closed = unordered_flat_map<State, Node*, HashFn>(0,     
-        [this](const State& state) {
-            return this->hash(state);
-        });
-        openMap = unordered_flat_map<State, Node*, HashFn>(0,     
-        [this](const State& state) {
+    KBFS(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time, size_t threadCount) : Search<State, Cost>(problemInstance),
+        open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}),
+        closed(&nodes, [this](const State& state) {
             return this->hash(state);
-        });
+        }) {
         this->extra_expansion_time = extra_expansion_time;
         this->threadCount = threadCount;
+        this->successorBuffers.resize(threadCount);
 
         this->searchStats["Algorithm"] = "KBFS";
         this->searchStats["Extra Expansion Time"] = extra_expansion_time;
@@ -55,177 +53,192 @@ public:
 
     vector<State> findPath() override {
         this->start();
-        nodes.reserve(10'000'000);
-        nodes.emplace_back(this->problemInstance->initial_state,
-            0, this->heuristic(this->problemInstance->initial_state), nullptr);
-        Node* startNode = &nodes.back();
-
-        closed.emplace(startNode->state, startNode);
-        startNode->handle = open.push(startNode);
-
-        while (!open.empty()) {
-            vector<Node*> threadNodes;
+        // started here rather than in the constructor so the workers are pinned with the chosen affinity
+        this->pinThread(0);
+        this->prefaultMemory(nodes, closed, threadCount);
+        threadPool.emplace(threadCount > 0 ? threadCount - 1 : 0, WorkStealingPool::DEFAULT_TASK_CAPACITY,
+                           [this](size_t worker) { this->pinThread(worker + 1); });
+        Cost startH = this->heuristic(this->problemInstance->initial_state);
+        NodeId startNode = nodes.emplace(Hot{this->fValue(0, startH), 0}, this->problemInstance->initial_state, startH);
+
+        closed.insert(startNode, nodes.cold(startNode).state);
+        if (startH == 0)
+            offerSolution(startNode);
+        else
+            open.push(startNode);
+
+        // goals never go into open, so once the best f in open reaches the incumbent nothing can beat it
+        while (!open.empty() && nodes.hot(open.top()).f < incumbent) {
+            if (this->limitReached()) {
+                this->bestBound = min(nodes.hot(open.top()).f, incumbent);
+                break;
+            }
+            vector<NodeId> threadNodes;
             
             // Get nodes for the amount of nodes in the open list up to the thread count
             for (size_t i = 0; i < this->threadCount; i++) {
-                if (open.empty()) break; // Stops creating threads if the open list is empty
+                if (open.empty() || nodes.hot(open.top()).f >= incumbent) break; // Stops creating threads if nothing useful is left
                 threadNodes.push_back(open.top());
-                Node* popped = threadNodes.back();
                 open.pop();
-                openMap.erase(popped->state); // remove it from openMap
-                if (popped->h == 0) {
-                    this->pathLength = popped->g;
-                    return finish(popped); // if node is goal, return the path
-                    // the first node found in the open list is the shortest path unless multiple nodes were expanded, but if h is 0, the node with the smallest g value is the shortest path, which will also have a smaller f value
-                }
             }
 
-            vector<vector<Node*>> allSuccessors(threadNodes.size()); // Persistent storage for successors
-            vector<std::future<void>> results(threadNodes.size());
-
+            TaskGroup batch;
             for (size_t i = 0; i < threadNodes.size(); i++) {
-                if (i >= threadNodes.size()) break;
-
-                // Allocate memory for the successors
-                allSuccessors[i].resize(this->problemInstance->maxActionCount()); // second dimension is for each action
-                for (size_t j = 0; j < this->problemInstance->maxActionCount(); j++) {
-                    nodes.push_back(Node());
-                    allSuccessors[i][j] = &nodes.back();
-                }
-
-                // threads.emplace_back(&KBFS::expand, this, threadNodes[i], ref(allSuccessors[i]));
-                results[i] = threadPool.push([this, &threadNodes, &allSuccessors, i] (int id) {
-                    this->expand(threadNodes[i], allSuccessors[i]);
+                threadPool->submit(batch, [this, n = threadNodes[i], i] (size_t) {
+                    this->expand(n, successorBuffers[i]);
                 });
             }
             
-            // wait for all threads to finish
-            for (size_t i = 0; i < threadNodes.size(); i++) {
-                // threads[i].join();
-                results[i].get();
-            }
+            // wait for all threads to finish, the main thread expands nodes of the batch too
+            threadPool->wait(batch);
 
             // add the successors to the open list
             // cout << "Processing batch of: " << threadNodes.size() << endl;
             for (size_t i = 0; i < threadNodes.size(); i++) {
                 this->expandedNodes++;
 
-                // cout << "Size of successors: " << threadNodes[i]->successors.size() << endl;
-                for (size_t j = 0; j < threadNodes[i]->successors.size(); j++) {
-                    Node* successor = threadNodes[i]->successors[j];
+                SuccessorBuffer& buffer = successorBuffers[i];
+                for (size_t j = 0; j < buffer.count; j++) {
                     this->generatedNodes++;
-                    updateDuplicateIfNeeded(successor);
+                    updateDuplicateIfNeeded(buffer.successors[j], threadNodes[i]);
                 }
-                threadNodes[i]->successors.clear(); // clear the successors vector for the next iteration
             }
         }
-        return finish(nullptr);
+        if (incumbentNode != NO_NODE) { // optimal unless a limit stopped the search, then the best so far
+            this->pathLength = nodes.hot(incumbentNode).g;
+            return finish(incumbentNode);
+        }
+        return finish(NO_NODE);
     }
 
 private:
 
+    // The cold part of a node, the f, g and heap index live in the arena's HotNode
     struct Node {
-        d_ary_heap::handle_type handle;
         State state;
-        Cost f{}, g{}, h{};
-        Node* parent;
-        vector<Node*> successors;
-        size_t num_successors = 0;
-
-        Node() : state(State()), parent(nullptr) {}
-        Node(State s) : state(s), parent(nullptr) {}
-        Node(State s, Cost g, Cost h, Node* parent) : state(s), g(g), h(h), parent(parent) {
-            f = g + h;
-        }
-        Node(Node* n) : state(n->state), f(n->f), g(n->g), h(n->h), parent(n->parent) {}
+        Cost h{};
+        NodeId parent = NO_NODE;
 
-        bool operator > (const Node& other) const { 
-            if (f == other.f) 
-                return g > other.g;
-            return f > other.f;
-        }
+        Node(const State& s, Cost h, NodeId parent = NO_NODE) : state(s), h(h), parent(parent) {}
+        Node(State&& s, Cost h, NodeId parent) : state(std::move(s)), h(h), parent(parent) {}
+    };
 
-        //override << 
-        friend ostream& operator<<(ostream& os, const Node& n) {
-            // print like [f, g, h]
-            os << "[" << n.f << ", " << n.g << ", " << n.h << "]";
-            return os;
-        }
+    // A successor computed by a pool thread, it only becomes a Node if it is not a duplicate
+    struct Successor {
+        State state;
+        Cost g{}, h{};
+        size_t hash = 0;
+    };
+
+    // Reused between batches so the pool threads write into already allocated States
+    struct SuccessorBuffer {
+        vector<Successor> successors;
+        size_t count = 0;
     };
     
     struct NodeCompare {
-        bool operator()(const Node* a, const Node* b) const {
-            return *a > *b;
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return x.g < y.g;
+            return x.f < y.f;
         }
     };
 
-    vector<Node> nodes;
-    d_ary_heap open{};
-    unordered_flat_map<State, Node*, HashFn> closed;
-    unordered_flat_map<State, Node*, HashFn> openMap;
-
-    void updateDuplicateIfNeeded(Node* n){
-        // check and updates the duplicate node
-        auto duplicate = closed.find(n->state);
-        if (duplicate != closed.end()) { 
-            Node* duplicateNode = duplicate->second;
-            if (duplicateNode->f >= n->f) {
+    Arena nodes;
+    MinHeap open;
+    ClosedSet<State, Arena> closed;
+    vector<SuccessorBuffer> successorBuffers; // one per batch slot
+
+    // The cheapest solution generated so far, a batch can generate goals in any order
+    Cost incumbent = numeric_limits<Cost>::max();
+    NodeId incumbentNode = NO_NODE;
+    size_t prunedNodes = 0;
+
+    void offerSolution(NodeId goal) {
+        if (nodes.hot(goal).g < incumbent) {
+            incumbent = nodes.hot(goal).g;
+            incumbentNode = goal;
+        }
+    }
+
+    void updateDuplicateIfNeeded(Successor& successor, NodeId parent){
+        Cost f = this->fValue(successor.g, successor.h);
+        if (f >= incumbent) {
+            prunedNodes++; // cannot lead to a cheaper solution
+            return;
+        }
+        // check and updates the duplicate node, a node is only allocated for new states
+        NodeId duplicate = closed.find(successor.state, successor.hash);
+        if (duplicate != NO_NODE) { 
+            Hot& duplicateNode = nodes.hot(duplicate);
+            if (duplicateNode.f > f) {
                 this->duplicatedNodes++;
-                duplicateNode->g = n->g;
-                duplicateNode->f = n->f;
-                duplicateNode->parent = n->parent;
-                
-                // if its in openMap, update the handle
-                auto openDuplicate = openMap.find(n->state);
-                if (openDuplicate != openMap.end()) {
-                    open.update(openDuplicate->second->handle);
-                }
+                duplicateNode.g = successor.g;
+                duplicateNode.f = f;
+                nodes.cold(duplicate).parent = parent;
+
+                if (successor.h == 0)
+                    offerSolution(duplicate);
+                else if (open.contains(duplicate))
+                    open.update(duplicate);
+                else
+                    open.push(duplicate); // reopen, a batch expands nodes out of f order so it may have been closed too early
             }
             this->generatedNodes--;
             return; // skip this successor because it's already in closed list and it was already updated
-        } else 
-            closed.emplace(n->state, n);
-        n->handle = open.push(n);
-        // add to openMap
-        openMap.emplace(n->state, n);
+        }
+        NodeId n = nodes.emplace(Hot{f, successor.g}, std::move(successor.state), successor.h, parent);
+        closed.insert(n, successor.hash);
+        if (successor.h == 0)
+            offerSolution(n);
+        else
+            open.push(n);
     }
 
-    // vector<Node*>& successors is a reference to the vector of successors for the node n that will be expanded
-    void expand(Node* n, vector<Node*>& successors) {
-        vector<State> successorStates = this->getSuccessors(n->state);
-        for (size_t i = 0; i < successorStates.size(); i++) {
-            State successorState = successorStates[i];
-            if (successorState == n->state) continue;
-            successors[i]->state = successorState;
-            successors[i]->g = n->g + this->getCost(n->state, successorState);
-            successors[i]->h = this->heuristic(successorState);
-            successors[i]->f = successors[i]->g + successors[i]->h;
-            successors[i]->parent = n;
-            n->num_successors++;
+    // Computes the successors of n into buffer, runs on a pool thread
+    void expand(NodeId n, SuccessorBuffer& buffer) {
+        const State& state = nodes.cold(n).state;
+        Cost g = nodes.hot(n).g;
+        vector<State> successorStates = this->getSuccessors(state);
+        if (buffer.successors.size() < successorStates.size()) buffer.successors.resize(successorStates.size());
+        buffer.count = 0;
+        for (State& successorState : successorStates) {
+            if (successorState == state) continue;
+            Successor& successor = buffer.successors[buffer.count++];
+            successor.g = g + this->getCost(state, successorState);
+            successor.h = this->heuristic(successorState);
+            successor.hash = closed.hash(successorState); // hashing here takes it off the main thread
+            successor.state = std::move(successorState);
         }
-        n->successors = successors;
-        n->successors.resize(n->num_successors);
         this->wasteTime(this->extra_expansion_time);
     }
 
-    static vector<State> reconstructPath(
-        Node* goal
-    ) {
+    vector<State> reconstructPath(NodeId goal) const {
         vector<State> path;
-        Node* current = goal;
-        while (current != nullptr) {
-            path.push_back(current->state);
-            current = current->parent;
+        NodeId current = goal;
+        while (current != NO_NODE) {
+            path.push_back(nodes.cold(current).state);
+            current = nodes.cold(current).parent;
         }
         reverse(path.begin(), path.end());
         return path;
     }
 
-    vector<State> finish(Node* n) {
+    vector<State> finish(NodeId n) {
+        this->recordNodeMemory(sizeof(Hot) + sizeof(Node), nodes.size());
+        this->recordTableMemory("Closed", closed);
+        this->searchStats["Open Memory"] = open.memoryBytes();
+        this->searchStats["Pool Steals"] = threadPool->steals();
+        this->searchStats["Pruned Nodes"] = prunedNodes;
+        this->recordWaitStats("Pool Idle", threadPool->workerIdleStats());
+        this->recordWaitStats("Batch Wait", threadPool->groupWaitStats());
         this->end();
-        if(n == nullptr) {
+        if(n == NO_NODE) {
             return {};
         }
         return reconstructPath(n);
     }
-}; 
\ No newline at end of file
+};
\ No newline at end of file
@@ -0,0 +1,356 @@
+#pragma once
+#include "search.hpp"
+
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "closed_set.hpp"
+
+#include <boost/unordered/unordered_flat_map.hpp>
+#include <boost/unordered/unordered_flat_set.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * Lifelong Planning A* (Koenig, Likhachev and Furcy 2004), an A* that can be asked again after its problem
+ * changed. Every node keeps g, its cost when it was last expanded, and rhs, the best cost its predecessors
+ * offer now. Open holds the nodes where the two differ, keyed by [min(g, rhs) + h, min(g, rhs)], so the
+ * first plan expands what A* would. After the problem changed, repair regenerates the successors of the
+ * expanded nodes on the changed cells (MutableProblem) and the next plan only expands the nodes whose cost
+ * changed with them.
+ *
+ * Any state with h = 0 is a goal, so a plan stops once open holds nothing cheaper than the cheapest goal,
+ * as if all goals led to one virtual goal. The start stays fixed: D* Lite moves the start by searching
+ * backwards from a single goal, which problems with many goal states do not have.
+ *
+ * A replan is only cheap when the change leaves the cost of most expanded nodes alone. Blocking a cell of the
+ * current path is the worst case with a fixed start: every node whose g went through the cell becomes
+ * underconsistent and is expanded twice, once to raise g and once to lower it, so a replan can expand more
+ * than a search from scratch. Changes next to the path only touch the nodes around them.
+ *
+ * findPath plans, then replans times asks change to change the problem (given the last path) and replans
+ * after each change, reporting the last path. plan and repair can also be called directly.
+ */
+template<typename State, typename Cost, typename Instance>
+class LPAStar : public Search<State, Cost> {
+    static_assert(MutableProblem<Instance, State>, "LPAStar needs a problem that reports the cells it changed");
+
+public:
+    using Cell = typename Instance::Cell;
+    using ChangeFn = function<vector<Cell>(const vector<State>& lastPath)>;
+
+private:
+    struct Node;
+    struct NodeCompare;
+    using Hot = HotNode<Cost>; // f and g hold the two parts of the key
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
+    using Clock = chrono::high_resolution_clock;
+
+    static constexpr Cost INFINITE_COST = numeric_limits<Cost>::max();
+
+public:
+    LPAStar(const Instance* problemInstance, size_t extra_expansion_time, size_t replans = 0, ChangeFn change = {})
+        : Search<State, Cost>(problemInstance), instance(problemInstance),
+        open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}),
+        closed(&nodes, [this](const State& state) {
+            return this->hash(state);
+        }),
+        replans(change ? replans : 0), change(std::move(change)) {
+        this->extra_expansion_time = extra_expansion_time;
+
+        this->searchStats["Algorithm"] = "LPA*";
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = 1;
+        this->searchStats["Replans"] = this->replans;
+    }
+
+    vector<State> findPath() override {
+        this->start();
+        vector<State> path = timedPlan();
+        for (size_t i = 0; i < replans && !stopped; i++) {
+            auto repairStart = Clock::now();
+            repair(change(path));
+            repairTime += chrono::duration<double>(Clock::now() - repairStart).count();
+            path = timedPlan();
+        }
+        return finish(std::move(path));
+    }
+
+    /**
+     * Brings g up to date for every node that can be on a path cheaper than the cheapest goal
+     * @return the path to the cheapest goal, empty when no goal can be reached or a limit was reached
+     */
+    vector<State> plan() {
+        if (startNode == NO_NODE) {
+            const State& initial = this->problemInstance->initial_state;
+            startNode = newNode(initial);
+            nodes.cold(startNode).rhs = 0;
+            updateOpen(startNode);
+        }
+        while (!open.empty()) {
+            NodeId n = open.top();
+            const Hot& key = nodes.hot(n);
+            if (goalsDirty) findCheapestGoal();
+            bool goalSettled = cheapestGoal == NO_NODE || !open.contains(cheapestGoal); // consistent, g is its cost
+            if (goalSettled && (key.f > goalCost || (key.f == goalCost && key.g >= goalCost))) break; // nothing cheaper is left
+            if (this->limitReached()) {
+                stopped = true;
+                this->bestBound = key.f;
+                this->pathLength = -1;
+                return {};
+            }
+            open.pop();
+            expand(n);
+        }
+        if (goalsDirty) findCheapestGoal();
+        if (cheapestGoal == NO_NODE || goalCost == INFINITE_COST) {
+            this->pathLength = -1;
+            return {};
+        }
+        this->pathLength = static_cast<long>(goalCost);
+        return reconstructPath(cheapestGoal);
+    }
+
+    /**
+     * Follows a change of the problem: regenerates the successors of the expanded nodes on the cells and puts
+     * the nodes whose rhs changed back into open
+     */
+    void repair(const vector<Cell>& cells) {
+        boost::unordered_flat_set<Cell> seen;
+        vector<NodeId> touched;
+        for (const Cell& cell : cells) {
+            if (!seen.insert(cell).second) continue;
+            auto it = nodesOnCell.find(cell);
+            if (it == nodesOnCell.end()) continue;
+            vector<NodeId> onCell = it->second; // generating can add to the table
+            for (NodeId n : onCell) {
+                Node& node = nodes.cold(n);
+                if (!node.generated) continue; // its successors will be generated from the changed problem
+                repairedNodes++;
+                for (const Edge& edge : node.successors) {
+                    auto& predecessors = nodes.cold(edge.node).predecessors;
+                    predecessors.erase(find_if(predecessors.begin(), predecessors.end(),
+                                               [n](const Edge& e) { return e.node == n; }));
+                    touched.push_back(edge.node);
+                }
+                node.successors.clear();
+                generate(n);
+                for (const Edge& edge : node.successors) {
+                    touched.push_back(edge.node);
+                }
+            }
+        }
+        for (NodeId n : touched) {
+            updateNode(n);
+        }
+    }
+
+private:
+    struct Edge {
+        NodeId node; // the successor in successors, the predecessor in predecessors
+        Cost cost;
+    };
+
+    // The cold part of a node, the key and heap index live in the arena's HotNode
+    struct Node {
+        const State state;
+        Cost h{};
+        Cost g = INFINITE_COST; // the cost when it was last expanded
+        Cost rhs = INFINITE_COST; // the best cost its predecessors offer
+        bool generated = false; // its successors are in successors
+        vector<Edge> successors;
+        vector<Edge> predecessors; // only the generated edges into it
+
+        Node(const State& s, Cost h) : state(s), h(h) {}
+    };
+
+    struct NodeCompare {
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return x.g < y.g;
+            return x.f < y.f;
+        }
+    };
+
+    const Instance* instance;
+    Arena nodes;
+    MinHeap open;
+    ClosedSet<State, Arena> closed;
+    boost::unordered_flat_map<Cell, vector<NodeId>> nodesOnCell;
+    NodeId startNode = NO_NODE;
+
+    vector<NodeId> goals; // the generated nodes with h = 0
+    NodeId cheapestGoal = NO_NODE;
+    Cost goalCost = INFINITE_COST; // the g of cheapestGoal
+    bool goalsDirty = false; // the cheapest goal got more expensive, the others have to be looked at
+
+    size_t replans;
+    ChangeFn change;
+    bool stopped = false; // by a limit
+    size_t repairedNodes = 0;
+    double repairTime = 0;
+    ostringstream planExpansions, planCosts, planTimes; // one entry per plan, the first one from scratch
+    size_t plans = 0;
+
+    NodeId newNode(const State& state) {
+        Cost h = this->heuristic(state);
+        NodeId n = nodes.emplace(Hot{INFINITE_COST, INFINITE_COST}, state, h);
+        closed.insert(n, nodes.cold(n).state);
+        nodesOnCell[instance->cellOf(state)].push_back(n);
+        if (h == 0) goals.push_back(n);
+        return n;
+    }
+
+    // Generates the successors of n from the problem as it is now and links them to n
+    void generate(NodeId n) {
+        nodes.cold(n).generated = true;
+        const State& state = nodes.cold(n).state;
+        for (const auto& successorState : this->getSuccessors(state)) {
+            if (successorState == state) continue;
+            Cost cost = this->getCost(state, successorState);
+            size_t successorHash = closed.hash(successorState);
+            NodeId successor = closed.find(successorState, successorHash);
+            if (successor == NO_NODE) {
+                this->generatedNodes++;
+                successor = newNode(successorState);
+                this->wasteTime(this->extra_expansion_time);
+            }
+            nodes.cold(n).successors.push_back(Edge{successor, cost});
+            nodes.cold(successor).predecessors.push_back(Edge{n, cost});
+        }
+    }
+
+    void expand(NodeId n) {
+        this->expandedNodes++;
+        if (!nodes.cold(n).generated) generate(n);
+        Node& node = nodes.cold(n);
+        if (node.g > node.rhs) { // overconsistent, its cost is final until the problem changes
+            node.g = node.rhs;
+            noteGoalCost(n);
+            for (const Edge& edge : node.successors) {
+                Node& successor = nodes.cold(edge.node);
+                if (node.g + edge.cost < successor.rhs) {
+                    successor.rhs = node.g + edge.cost;
+                    updateOpen(edge.node);
+                }
+            }
+        } else { // underconsistent, it got more expensive so everything that went through it may have too
+            node.g = INFINITE_COST;
+            noteGoalCost(n);
+            updateNode(n);
+            for (const Edge& edge : node.successors) {
+                updateNode(edge.node);
+            }
+        }
+    }
+
+    // Recomputes rhs from the predecessors
+    void updateNode(NodeId n) {
+        if (n == startNode) return;
+        Node& node = nodes.cold(n);
+        node.rhs = INFINITE_COST;
+        for (const Edge& edge : node.predecessors) {
+            Cost g = nodes.cold(edge.node).g;
+            if (g != INFINITE_COST) node.rhs = min(node.rhs, g + edge.cost);
+        }
+        updateOpen(n);
+    }
+
+    // Keeps n in open with its key exactly while g and rhs differ
+    void updateOpen(NodeId n) {
+        const Node& node = nodes.cold(n);
+        if (node.g == node.rhs) {
+            if (open.contains(n)) open.erase(n);
+            return;
+        }
+        Cost k2 = min(node.g, node.rhs);
+        nodes.hot(n).f = k2 + node.h;
+        nodes.hot(n).g = k2;
+        if (open.contains(n))
+            open.update(n);
+        else
+            open.push(n);
+    }
+
+    void noteGoalCost(NodeId n) {
+        const Node& node = nodes.cold(n);
+        if (node.h != 0) return;
+        if (node.g < goalCost) {
+            cheapestGoal = n;
+            goalCost = node.g;
+        } else if (n == cheapestGoal && node.g > goalCost) {
+            goalsDirty = true;
+        }
+    }
+
+    void findCheapestGoal() {
+        goalsDirty = false;
+        cheapestGoal = NO_NODE;
+        goalCost = INFINITE_COST;
+        for (NodeId n : goals) {
+            if (nodes.cold(n).g < goalCost) {
+                cheapestGoal = n;
+                goalCost = nodes.cold(n).g;
+            }
+        }
+    }
+
+    vector<State> timedPlan() {
+        size_t expansionsBefore = this->expandedNodes;
+        auto planStart = Clock::now();
+        vector<State> path = plan();
+        double elapsed = chrono::duration<double>(Clock::now() - planStart).count();
+        const char* separator = plans++ == 0 ? "" : ",";
+        planExpansions << separator << this->expandedNodes - expansionsBefore;
+        planCosts << separator << this->pathLength;
+        planTimes << separator << elapsed;
+        return path;
+    }
+
+    // Walks back from the goal, each time to the predecessor offering the lowest cost
+    vector<State> reconstructPath(NodeId goal) const {
+        vector<State> path;
+        NodeId current = goal;
+        while (current != startNode) {
+            path.push_back(nodes.cold(current).state);
+            NodeId best = NO_NODE;
+            Cost bestCost = INFINITE_COST;
+            for (const Edge& edge : nodes.cold(current).predecessors) {
+                Cost g = nodes.cold(edge.node).g;
+                if (g != INFINITE_COST && g + edge.cost < bestCost) {
+                    best = edge.node;
+                    bestCost = g + edge.cost;
+                }
+            }
+            current = best;
+        }
+        path.push_back(nodes.cold(startNode).state);
+        reverse(path.begin(), path.end());
+        return path;
+    }
+
+    vector<State> finish(vector<State> path) {
+        this->recordNodeMemory(sizeof(Hot) + sizeof(Node), nodes.size());
+        this->recordTableMemory("Closed", closed);
+        this->searchStats["Open Memory"] = open.memoryBytes();
+        this->searchStats["Plan Expansions"] = planExpansions.str();
+        this->searchStats["Plan Costs"] = planCosts.str();
+        this->searchStats["Plan Times"] = planTimes.str();
+        this->searchStats["Repaired Nodes"] = repairedNodes;
+        this->searchStats["Repair Time"] = repairTime;
+        this->end();
+        return path;
+    }
+};
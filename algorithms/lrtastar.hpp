@@ -0,0 +1,326 @@
+#pragma once
+#include "search.hpp"
+
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "closed_set.hpp"
+#include "latency_histogram.hpp"
+
+#include <boost/unordered/unordered_flat_map.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * The h values an agent has learned, keyed by State. States it never learned about keep the problem's
+ * heuristic. The caller owns it, so what one query learns carries over to the next ones on the instance.
+ */
+template<typename State, typename Cost = float>
+class LearnedHeuristic {
+public:
+    using HashFn = function<size_t(const State&)>;
+    using value_type = pair<const State, Cost>;
+
+    explicit LearnedHeuristic(HashFn hashFn) : values(0, Hasher{std::move(hashFn)}) {}
+
+    // @return the learned h of state, or fallback when nothing was learned about it
+    Cost get(const State& state, Cost fallback) const {
+        auto it = values.find(state);
+        return it == values.end() ? fallback : it->second;
+    }
+
+    // Learned values only go up, a lower one would make the heuristic less informed
+    void raise(const State& state, Cost h) {
+        auto [it, inserted] = values.try_emplace(state, h);
+        if (!inserted) it->second = max(it->second, h);
+    }
+
+    size_t size() const { return values.size(); }
+    size_t bucket_count() const { return values.bucket_count(); }
+    float load_factor() const { return values.load_factor(); }
+
+private:
+    struct Hasher {
+        HashFn hashFn;
+        size_t operator()(const State& state) const { return hashFn(state); }
+    };
+
+    boost::unordered_flat_map<State, Cost, Hasher> values;
+};
+
+/**
+ * LSS-LRTA* (Koenig and Sun 2009), an agent centered real-time search. Each step runs A* from the agent for
+ * at most lookahead expansions (stopping early at a goal), raises the learned h of every state it expanded
+ * with a Dijkstra pass from the frontier inwards, then moves the agent along the path to the best frontier
+ * node. With a lookahead of 1 it is LRTA*. The time to the first move, and every step's, is bounded by the
+ * lookahead and not by the instance.
+ *
+ * The returned path is the trajectory the agent took, revisits included. It runs trials queries from the
+ * initial state one after the other with the same learned heuristic, and reports the last one. With
+ * enough trials the trajectory converges to an optimal path: a trial that raised no h followed the
+ * heuristic exactly from the start, so it cost h(start), and the trials stop there.
+ */
+template<typename State, typename Cost = float>
+class LRTAStar : public Search<State, Cost> {
+    struct Node;
+    struct NodeCompare;
+    using Hot = HotNode<Cost>;
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
+    using Clock = chrono::high_resolution_clock;
+
+    static constexpr Cost INFINITE_COST = numeric_limits<Cost>::max();
+
+public:
+    LRTAStar(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time, size_t lookahead,
+             LearnedHeuristic<State, Cost>* learned, size_t trials = 1)
+        : Search<State, Cost>(problemInstance),
+        open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}),
+        closed(&nodes, [this](const State& state) {
+            return this->hash(state);
+        }),
+        lookahead(max<size_t>(lookahead, 1)), learned(learned), trials(max<size_t>(trials, 1)) {
+        this->extra_expansion_time = extra_expansion_time;
+
+        this->searchStats["Algorithm"] = lookahead > 1 ? "LSS-LRTA*" : "LRTA*";
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = 1;
+        this->searchStats["Lookahead"] = this->lookahead;
+        this->searchStats["Trials"] = this->trials;
+    }
+
+    vector<State> findPath() override {
+        this->start();
+        vector<State> trajectory;
+        Cost cost = 0;
+        for (size_t trial = 0; trial < trials && !stopped && !deadEnd && !converged; trial++) {
+            size_t updatesBefore = updates;
+            trajectory = runTrial(cost);
+            if (stopped || deadEnd) break;
+            trialCosts << (trial ? " " : "") << cost;
+            converged = updates == updatesBefore;
+        }
+        if (!stopped && !deadEnd) {
+            this->pathLength = static_cast<long>(cost);
+            return finish(std::move(trajectory));
+        }
+        return finish({});
+    }
+
+private:
+    // The cold part of a node, the f, g and heap index live in the arena's HotNode
+    struct Node {
+        const State state;
+        Cost h{}; // learned h, lowered to infinity and back up by the learning pass
+        NodeId parent = NO_NODE;
+        bool expanded = false;
+
+        Node(const State& s, Cost h, NodeId parent) : state(s), h(h), parent(parent) {}
+    };
+
+    struct NodeCompare {
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return x.g > y.g;
+            return x.f < y.f;
+        }
+    };
+
+    // An edge of the local search space, the learning pass follows them backwards
+    struct Edge {
+        NodeId from, to;
+        Cost cost;
+    };
+
+    // The local search space, cleared at every step
+    Arena nodes;
+    MinHeap open;
+    ClosedSet<State, Arena> closed;
+    vector<NodeId> expanded;
+    vector<Edge> edges;
+    vector<Cost> previousH; // the h of each expanded node before learning
+
+    size_t lookahead;
+    LearnedHeuristic<State, Cost>* learned;
+    size_t trials;
+
+    bool stopped = false; // by a limit
+    bool deadEnd = false; // the agent can reach no goal
+    bool converged = false; // a trial learned nothing, its path is optimal
+    size_t updates = 0; // h values raised by learning
+    size_t steps = 0;
+    size_t moves = 0;
+    double firstMoveTime = -1;
+    LatencyHistogram stepLatency;
+    ostringstream trialCosts;
+
+    Cost learnedH(const State& state) const {
+        return learned->get(state, this->heuristic(state));
+    }
+
+    // Moves the agent from the initial state to a goal, cost is set to what the moves cost
+    vector<State> runTrial(Cost& cost) {
+        State current = this->problemInstance->initial_state;
+        vector<State> trajectory{current};
+        cost = 0;
+        while (this->heuristic(current) != 0) {
+            auto stepStart = Clock::now();
+            NodeId target = search(current);
+            if (stopped) break;
+            if (target == NO_NODE) {
+                deadEnd = true; // every state the agent can reach has been explored
+                break;
+            }
+            learn();
+
+            vector<State> segment;
+            for (NodeId n = target; nodes.cold(n).parent != NO_NODE; n = nodes.cold(n).parent) {
+                segment.push_back(nodes.cold(n).state);
+            }
+            trajectory.insert(trajectory.end(), segment.rbegin(), segment.rend());
+            moves += segment.size();
+            cost += nodes.hot(target).g;
+            current = nodes.cold(target).state;
+
+            steps++;
+            auto now = Clock::now();
+            stepLatency.record(chrono::duration<double>(now - stepStart).count());
+            if (firstMoveTime < 0) firstMoveTime = chrono::duration<double>(now - this->clockStart).count();
+        }
+        return trajectory;
+    }
+
+    /**
+     * A* from the agent for at most lookahead expansions, stopping before it would expand a goal
+     * @return the frontier node to move to, NO_NODE when there is none or a limit was reached
+     */
+    NodeId search(const State& agent) {
+        nodes.clear();
+        open.clear();
+        closed.clear();
+        expanded.clear();
+        edges.clear();
+
+        Cost agentH = learnedH(agent);
+        NodeId root = nodes.emplace(Hot{agentH, 0}, agent, agentH, NO_NODE);
+        closed.insert(root, agent);
+        open.push(root);
+
+        while (!open.empty() && expanded.size() < lookahead) {
+            NodeId n = open.top();
+            if (n != root && this->heuristic(nodes.cold(n).state) == 0) break; // the agent can move to a goal
+            if (this->limitReached()) {
+                stopped = true;
+                this->bestBound = -1;
+                return NO_NODE;
+            }
+            open.pop();
+            expand(n);
+        }
+        if (open.empty() || nodes.hot(open.top()).f == INFINITE_COST) return NO_NODE;
+        return open.top();
+    }
+
+    void expand(NodeId n) {
+        this->expandedNodes++;
+        nodes.cold(n).expanded = true;
+        expanded.push_back(n);
+        const State& state = nodes.cold(n).state;
+        for (const auto& successorState : this->getSuccessors(state)) {
+            if (successorState == state) continue; // skip the parent state
+            this->generatedNodes++;
+            Cost cost = this->getCost(state, successorState);
+            Cost g = nodes.hot(n).g + cost;
+
+            size_t successorHash = closed.hash(successorState);
+            NodeId duplicate = closed.find(successorState, successorHash);
+            if (duplicate != NO_NODE) {
+                this->generatedNodes--; // undo the generation of the duplicate
+                edges.push_back(Edge{n, duplicate, cost});
+                Hot& duplicateNode = nodes.hot(duplicate);
+                if (duplicateNode.g <= g) continue;
+                this->duplicatedNodes++;
+                duplicateNode.g = g;
+                duplicateNode.f = nodes.cold(duplicate).h == INFINITE_COST ? INFINITE_COST : g + nodes.cold(duplicate).h;
+                nodes.cold(duplicate).parent = n;
+                if (open.contains(duplicate))
+                    open.update(duplicate);
+                else if (!nodes.cold(duplicate).expanded)
+                    open.push(duplicate);
+                continue;
+            }
+
+            Cost h = learnedH(successorState);
+            NodeId successor = nodes.emplace(Hot{h == INFINITE_COST ? INFINITE_COST : g + h, g}, successorState, h, n);
+            closed.insert(successor, successorHash);
+            edges.push_back(Edge{n, successor, cost});
+            this->wasteTime(this->extra_expansion_time);
+            open.push(successor);
+        }
+    }
+
+    /**
+     * Sets the h of every expanded node to its cost to the frontier plus the frontier node's h, the
+     * largest value that keeps the heuristic admissible, and stores it in the learned heuristic
+     */
+    void learn() {
+        sort(edges.begin(), edges.end(), [](const Edge& a, const Edge& b) { return a.to < b.to; });
+        previousH.clear();
+        for (NodeId n : expanded) {
+            previousH.push_back(nodes.cold(n).h);
+            nodes.cold(n).h = INFINITE_COST;
+        }
+        using Entry = pair<Cost, NodeId>;
+        priority_queue<Entry, vector<Entry>, greater<Entry>> frontier;
+        for (NodeId n = 0; n < nodes.size(); n++) {
+            if (!nodes.cold(n).expanded) frontier.push({nodes.cold(n).h, n}); // generated but not expanded
+        }
+        while (!frontier.empty()) {
+            auto [h, n] = frontier.top();
+            frontier.pop();
+            if (h != nodes.cold(n).h || h == INFINITE_COST) continue; // stale
+            auto into = lower_bound(edges.begin(), edges.end(), n, [](const Edge& e, NodeId id) { return e.to < id; });
+            for (; into != edges.end() && into->to == n; ++into) {
+                Node& from = nodes.cold(into->from);
+                if (from.expanded && h + into->cost < from.h) {
+                    from.h = h + into->cost;
+                    frontier.push({from.h, into->from});
+                }
+            }
+        }
+        for (size_t i = 0; i < expanded.size(); i++) {
+            const Node& node = nodes.cold(expanded[i]);
+            if (node.h > previousH[i]) updates++;
+            learned->raise(node.state, node.h);
+        }
+    }
+
+    vector<State> finish(vector<State> path) {
+        this->suboptimality = converged ? 1 : 0; // the trajectory has no bound until the learned heuristic converges
+        this->recordTableMemory("Learned", *learned);
+        this->searchStats["Trial Costs"] = trialCosts.str();
+        this->searchStats["Converged"] = converged;
+        this->searchStats["Learning Updates"] = updates;
+        this->searchStats["Steps"] = steps;
+        this->searchStats["Moves"] = moves;
+        this->searchStats["First Move Time"] = firstMoveTime;
+        this->searchStats["Step Latency Histogram"] = stepLatency.toString();
+        this->searchStats["Step Latency Mean"] = stepLatency.mean();
+        this->searchStats["Step Latency P99"] = stepLatency.percentile(0.99);
+        this->searchStats["Step Latency Max"] = stepLatency.max();
+        this->end();
+        return path;
+    }
+};
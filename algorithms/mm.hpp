@@ -0,0 +1,249 @@
+#pragma once
+#include "search.hpp"
+
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "closed_set.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * MM (Holte, Felner, Sharon and Sturtevant 2016), bidirectional heuristic search that meets in the middle.
+ * A forward search from the initial state uses heuristic(), a backward search from the goal state uses
+ * pairwiseHeuristic(state, initial state). Each direction orders its open list by pr(n) = max(f(n), 2g(n)),
+ * so neither search expands a node past half of the optimal cost, and the direction with the smaller
+ * pr at its top is expanded. Every generated node is looked up in the other direction's table, a hit
+ * is a path whose cost updates the incumbent U.
+ *
+ * U is optimal once it is at most max(C, fminF, fminB, gminF + gminB + epsilon), C being the smaller top
+ * pr and epsilon the cheapest edge cost (0 is always safe). The backward search applies getSuccessors
+ * to go backwards, so moves must be reversible with the same cost both ways.
+ */
+template<typename State, typename Cost, typename Instance>
+class MM : public Search<State, Cost> {
+    static_assert(KnownGoalProblem<Instance, State>, "MM needs a problem with a single known goal state");
+
+    struct Node;
+    struct NodeCompare;
+    using Hot = HotNode<Cost>; // f holds pr(n) = max(g + h, 2g)
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
+    using Entry = pair<Cost, NodeId>;
+    using LazyHeap = priority_queue<Entry, vector<Entry>, greater<Entry>>; // stale entries are skipped at the top
+
+    static constexpr Cost INFINITE_COST = numeric_limits<Cost>::max();
+
+public:
+    MM(const Instance* problemInstance, size_t extra_expansion_time, Cost epsilon = 0)
+        : Search<State, Cost>(problemInstance), instance(problemInstance), epsilon(epsilon),
+        forward("Forward", [this](const State& state) { return this->hash(state); },
+                [this](const State& state) { return this->heuristic(state); }),
+        backward("Backward", [this](const State& state) { return this->hash(state); },
+                 [this](const State& state) { return this->pairwiseHeuristic(state, this->problemInstance->initial_state); }) {
+        this->extra_expansion_time = extra_expansion_time;
+
+        this->searchStats["Algorithm"] = "MM";
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = 1;
+        this->searchStats["Epsilon"] = static_cast<double>(epsilon);
+    }
+
+    vector<State> findPath() override {
+        this->start();
+        this->prefaultBytes /= 2; // split between the two directions
+        this->prefaultMemory(forward.nodes, forward.table, 1);
+        this->prefaultMemory(backward.nodes, backward.table, 1);
+
+        const State& initial = this->problemInstance->initial_state;
+        const State& goal = instance->goalState();
+        if (initial == goal) {
+            forward.add(initial, 0, NO_NODE);
+            meetForward = 0;
+            incumbent = 0;
+        } else {
+            forward.add(initial, 0, NO_NODE);
+            backward.add(goal, 0, NO_NODE);
+        }
+
+        while (incumbent > 0 && !forward.open.empty() && !backward.open.empty()) {
+            Cost bound = lowerBound();
+            if (incumbent <= bound) break;
+            if (this->limitReached()) {
+                this->bestBound = bound;
+                stopped = true;
+                break;
+            }
+            bool goForward = forward.topPriority() <= backward.topPriority();
+            if (goForward)
+                expand(forward, backward);
+            else
+                expand(backward, forward);
+        }
+
+        if (incumbent != INFINITE_COST && !stopped) {
+            this->pathLength = incumbent; // proven, or one side ran out of nodes
+        }
+        return finish();
+    }
+
+private:
+    // The cold part of a node, the pr, g and heap index live in the arena's HotNode
+    struct Node {
+        const State state;
+        Cost h{};
+        NodeId parent = NO_NODE;
+
+        Node(const State& s, Cost h, NodeId parent) : state(s), h(h), parent(parent) {}
+    };
+
+    struct NodeCompare {
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return x.g < y.g;
+            return x.f < y.f;
+        }
+    };
+
+    // One of the two searches, its table holds every node it generated
+    struct Direction {
+        const char* name;
+        function<Cost(const State&)> heuristic;
+        Arena nodes;
+        MinHeap open;
+        ClosedSet<State, Arena> table;
+        LazyHeap byF, byG; // the smallest f and g in open
+        size_t expanded = 0;
+
+        Direction(const char* name, typename ClosedSet<State, Arena>::HashFn hashFn, function<Cost(const State&)> heuristic)
+            : name(name), heuristic(std::move(heuristic)), open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}),
+            table(&nodes, std::move(hashFn)) {}
+
+        NodeId add(const State& state, Cost g, NodeId parent) {
+            Cost h = heuristic(state);
+            NodeId id = nodes.emplace(Hot{priority(g, h), g}, state, h, parent);
+            table.insert(id, state);
+            push(id);
+            return id;
+        }
+
+        void push(NodeId id) {
+            if (open.contains(id))
+                open.update(id);
+            else
+                open.push(id);
+            byF.push({nodes.hot(id).g + nodes.cold(id).h, id});
+            byG.push({nodes.hot(id).g, id});
+        }
+
+        static Cost priority(Cost g, Cost h) { return max(g + h, 2 * g); }
+
+        Cost topPriority() const { return open.empty() ? INFINITE_COST : nodes.hot(open.top()).f; }
+
+        // the smallest value in a lazy heap whose top still matches a node in open
+        template<typename Value>
+        Cost lowest(LazyHeap& heap, Value value) {
+            while (!heap.empty()) {
+                auto [cost, id] = heap.top();
+                if (open.contains(id) && value(id) == cost) return cost;
+                heap.pop();
+            }
+            return INFINITE_COST;
+        }
+        Cost lowestF() { return lowest(byF, [this](NodeId id) { return nodes.hot(id).g + nodes.cold(id).h; }); }
+        Cost lowestG() { return lowest(byG, [this](NodeId id) { return nodes.hot(id).g; }); }
+    };
+
+    const Instance* instance;
+    Cost epsilon;
+    Direction forward, backward;
+
+    Cost incumbent = INFINITE_COST; // U, the cheapest path found through a node both searches generated
+    NodeId meetForward = NO_NODE, meetBackward = NO_NODE;
+    size_t meetings = 0;
+    bool stopped = false;
+
+    // max(C, fminF, fminB, gminF + gminB + epsilon), no path through open costs less
+    Cost lowerBound() {
+        Cost c = min(forward.topPriority(), backward.topPriority());
+        Cost gSum = forward.lowestG() + backward.lowestG() + epsilon;
+        return max({c, forward.lowestF(), backward.lowestF(), gSum});
+    }
+
+    void expand(Direction& side, Direction& other) {
+        this->expandedNodes++;
+        side.expanded++;
+        NodeId n = side.open.top();
+        side.open.pop();
+        const State& state = side.nodes.cold(n).state;
+        for (const auto& successorState : this->getSuccessors(state)) {
+            if (successorState == state) continue; // skip the parent state
+            this->generatedNodes++;
+            Cost g = side.nodes.hot(n).g + this->getCost(state, successorState);
+
+            size_t successorHash = side.table.hash(successorState);
+            NodeId successor = side.table.find(successorState, successorHash);
+            if (successor != NO_NODE) {
+                this->generatedNodes--; // undo the generation of the duplicate
+                Hot& duplicate = side.nodes.hot(successor);
+                if (duplicate.g <= g) continue;
+                this->duplicatedNodes++;
+                duplicate.g = g;
+                duplicate.f = Direction::priority(g, side.nodes.cold(successor).h);
+                side.nodes.cold(successor).parent = n;
+                side.push(successor); // reopens it when it was expanded
+            } else {
+                successor = side.add(successorState, g, n);
+                this->wasteTime(this->extra_expansion_time);
+            }
+
+            NodeId match = other.table.find(successorState, successorHash);
+            if (match != NO_NODE && g + other.nodes.hot(match).g < incumbent) {
+                meetings++;
+                incumbent = g + other.nodes.hot(match).g;
+                meetForward = &side == &forward ? successor : match;
+                meetBackward = &side == &forward ? match : successor;
+            }
+        }
+    }
+
+    vector<State> reconstructPath() const {
+        vector<State> path;
+        for (NodeId current = meetForward; current != NO_NODE; current = forward.nodes.cold(current).parent) {
+            path.push_back(forward.nodes.cold(current).state);
+        }
+        reverse(path.begin(), path.end());
+        if (meetBackward != NO_NODE) {
+            for (NodeId current = backward.nodes.cold(meetBackward).parent; current != NO_NODE; current = backward.nodes.cold(current).parent) {
+                path.push_back(backward.nodes.cold(current).state);
+            }
+        }
+        return path;
+    }
+
+    vector<State> finish() {
+        this->recordNodeMemory(sizeof(Hot) + sizeof(Node), forward.nodes.size() + backward.nodes.size());
+        for (Direction* side : {&forward, &backward}) {
+            string name = side->name;
+            this->recordTableMemory(name + " Closed", side->table);
+            this->searchStats[name + " Expanded Nodes"] = side->expanded;
+            this->searchStats[name + " Open Memory"] = side->open.memoryBytes();
+        }
+        this->searchStats["Meetings"] = meetings;
+        this->end();
+        if (this->pathLength < 0) {
+            return {};
+        }
+        return reconstructPath();
+    }
+};
@@ -0,0 +1,286 @@
+#pragma once
+#include "search.hpp"
+
+#include "work_stealing_deque.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * Parallel IDA* for problems with in place moves. Every f threshold iteration the tree is expanded
+ * breadth first (with the same pruning as IDA*) until there are enough subtrees for all threads, the
+ * subtrees are dealt out to per thread work stealing deques and each thread searches its subtrees depth
+ * first, stealing from the others when its own run out.
+ *
+ * Threads are created once and meet at a barrier between iterations. The first solution found ends the
+ * search, it is optimal because every f in the iteration is at most the threshold.
+ */
+template<typename State, typename Cost, typename Instance>
+class ParallelIDAStar : public Search<State, Cost> {
+    static_assert(InPlaceProblem<Instance, State, Cost>, "ParallelIDAStar needs a problem with in place moves");
+
+    using Move = typename Instance::Move;
+    static constexpr Cost INFINITE_COST = numeric_limits<Cost>::max();
+    static constexpr size_t SUBTREES_PER_THREAD = 64; // more subtrees even out the work but cost more copies
+    static constexpr size_t COUNTER_FLUSH_INTERVAL = 1024; // expansions between updates of the shared counters
+
+    // The root of a subtree and the moves that lead to it
+    struct Subtree {
+        State state;
+        Cost g{}, h{};
+        vector<Move> moves;
+        Move parentInverse{};
+    };
+
+    struct alignas(64) Worker {
+        WorkStealingDeque<uint32_t> subtrees;
+        State state;
+        vector<Move> movePath;
+        Cost next = INFINITE_COST;
+        size_t expanded = 0, generated = 0; // not yet added to the shared counters
+        size_t steals = 0;
+        mt19937 rng;
+
+        explicit Worker(size_t id) : rng(static_cast<uint32_t>(id)) {}
+    };
+
+public:
+    ParallelIDAStar(const Instance* problemInstance, size_t extra_expansion_time, size_t threadCount)
+        : Search<State, Cost>(problemInstance), instance(problemInstance), threadCount(max<size_t>(threadCount, 1)) {
+        this->extra_expansion_time = extra_expansion_time;
+
+        this->searchStats["Algorithm"] = "Parallel IDA*";
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = this->threadCount;
+    }
+
+    vector<State> findPath() override {
+        this->start();
+
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.push_back(make_unique<Worker>(i));
+        }
+        barrier<> iterationStart(threadCount), iterationEnd(threadCount);
+        vector<jthread> threads;
+        for (size_t i = 1; i < threadCount; i++) {
+            threads.emplace_back([this, i, &iterationStart, &iterationEnd] {
+                this->pinThread(i);
+                while (true) {
+                    iterationStart.arrive_and_wait();
+                    if (finished) return;
+                    searchSubtrees(i);
+                    iterationEnd.arrive_and_wait();
+                }
+            });
+        }
+
+        this->pinThread(0);
+        Cost rootH = this->heuristic(this->problemInstance->initial_state);
+        threshold = rootH;
+        while (true) {
+            iterations++;
+            Cost next = buildFrontier(rootH);
+            if (found || stopped) break;
+
+            // deal the subtrees out, the owners are waiting at the barrier so pushing for them is safe
+            for (size_t i = 0; i < frontier.size(); i++) {
+                workers[i % threadCount]->subtrees.push(static_cast<uint32_t>(i));
+            }
+            iterationStart.arrive_and_wait();
+            searchSubtrees(0);
+            iterationEnd.arrive_and_wait();
+            if (found || stopped) break;
+
+            for (auto& worker : workers) {
+                next = min(next, worker->next);
+            }
+            if (next == INFINITE_COST) break; // every path was cut off by the problem, not the threshold
+            threshold = next;
+        }
+        finished = true;
+        iterationStart.arrive_and_wait();
+        threads.clear(); // join
+        return finish();
+    }
+
+private:
+    const Instance* instance;
+    size_t threadCount;
+    vector<unique_ptr<Worker>> workers;
+    vector<Subtree> frontier;
+
+    Cost threshold{};
+    size_t iterations = 0;
+    atomic<bool> found{false};
+    atomic<bool> stopped{false};
+    bool finished = false;
+    vector<Move> solution;
+    mutex statsMutex; // guards the shared counters, limitReached and the solution
+
+    /**
+     * Expands the tree breadth first under the threshold until there are SUBTREES_PER_THREAD subtrees per thread
+     * @return the smallest f above the threshold that was cut off on the way
+     */
+    Cost buildFrontier(Cost rootH) {
+        Cost next = INFINITE_COST;
+        frontier.clear();
+        frontier.push_back(Subtree{this->problemInstance->initial_state, 0, rootH, {}, {}});
+        if (rootH == 0) return solve(frontier.front().moves, 0);
+
+        vector<Subtree> level;
+        while (!frontier.empty() && frontier.size() < SUBTREES_PER_THREAD * threadCount) {
+            level.clear();
+            for (Subtree& parent : frontier) {
+                this->expandedNodes++; // the subtree roots left in frontier are counted by the worker expanding them
+                Move moves[Instance::MAX_MOVES];
+                size_t moveCount = instance->getMoves(parent.state, moves);
+                for (size_t i = 0; i < moveCount; i++) {
+                    if (!parent.moves.empty() && moves[i] == parent.parentInverse) continue; // skip the parent state
+                    this->generatedNodes++;
+                    Subtree child{parent.state, parent.g + instance->moveCost(parent.state, moves[i]), 0, parent.moves, instance->inverseMove(parent.state, moves[i])};
+                    child.h = instance->applyInPlace(child.state, moves[i], parent.h);
+                    child.moves.push_back(moves[i]);
+                    if (child.g + child.h > threshold) {
+                        next = min(next, child.g + child.h);
+                        continue;
+                    }
+                    if (child.h == 0) return solve(child.moves, child.g);
+                    level.push_back(std::move(child));
+                }
+            }
+            swap(frontier, level);
+            if (this->limitReached()) {
+                stopped = true;
+                break;
+            }
+        }
+        return next;
+    }
+
+    void searchSubtrees(size_t id) {
+        Worker& worker = *workers[id];
+        worker.next = INFINITE_COST;
+        while (!found.load(memory_order_relaxed) && !stopped.load(memory_order_relaxed)) {
+            optional<uint32_t> index = worker.subtrees.pop();
+            if (!index) index = steal(worker);
+            if (!index) break; // every deque is empty, no new subtrees appear during an iteration
+
+            const Subtree& subtree = frontier[*index];
+            worker.state = subtree.state;
+            worker.movePath = subtree.moves;
+            Cost t = search(worker, subtree.g, subtree.h, subtree.moves.empty() ? nullptr : &subtree.parentInverse);
+            worker.next = min(worker.next, t);
+        }
+        flush(worker);
+    }
+
+    // Tries the other deques, starting from a random one, until one gives up a subtree or all are empty
+    optional<uint32_t> steal(Worker& thief) {
+        while (true) {
+            bool allEmpty = true;
+            size_t first = thief.rng() % threadCount;
+            for (size_t i = 0; i < threadCount; i++) {
+                Worker& victim = *workers[(first + i) % threadCount];
+                if (&victim == &thief || victim.subtrees.empty()) continue;
+                allEmpty = false;
+                if (auto index = victim.subtrees.steal()) {
+                    thief.steals++;
+                    return index;
+                }
+            }
+            if (allEmpty) return nullopt;
+        }
+    }
+
+    // @return the smallest f above the threshold seen below this node
+    Cost search(Worker& worker, Cost g, Cost h, const Move* parentInverse) {
+        Cost f = g + h;
+        if (f > threshold) return f;
+        if (h == 0) return solve(worker.movePath, g);
+        if (++worker.expanded >= COUNTER_FLUSH_INTERVAL && flush(worker)) return INFINITE_COST;
+        if (found.load(memory_order_relaxed)) return INFINITE_COST;
+
+        Move moves[Instance::MAX_MOVES];
+        size_t moveCount = instance->getMoves(worker.state, moves);
+        Cost next = INFINITE_COST;
+        for (size_t i = 0; i < moveCount; i++) {
+            if (parentInverse != nullptr && moves[i] == *parentInverse) continue; // skip the parent state
+            worker.generated++;
+            Cost cost = instance->moveCost(worker.state, moves[i]);
+            Move inverse = instance->inverseMove(worker.state, moves[i]);
+            Cost childH = instance->applyInPlace(worker.state, moves[i], h);
+            this->wasteTime(this->extra_expansion_time);
+
+            worker.movePath.push_back(moves[i]);
+            Cost t = search(worker, g + cost, childH, &inverse);
+            if (found.load(memory_order_relaxed) || stopped.load(memory_order_relaxed)) return INFINITE_COST;
+            worker.movePath.pop_back();
+
+            instance->applyInPlace(worker.state, inverse, childH);
+            next = min(next, t);
+        }
+        return next;
+    }
+
+    // Records the first solution, any solution in an iteration is optimal
+    Cost solve(const vector<Move>& moves, Cost g) {
+        lock_guard<mutex> lock(statsMutex);
+        if (!found.exchange(true)) {
+            solution = moves;
+            this->pathLength = g;
+        }
+        return g;
+    }
+
+    /**
+     * Adds the worker's counters to the shared ones and checks the limits, the clock on every flush
+     * @return true once the search has to stop
+     */
+    bool flush(Worker& worker) {
+        lock_guard<mutex> lock(statsMutex);
+        this->expandedNodes += worker.expanded;
+        this->generatedNodes += worker.generated;
+        worker.expanded = 0;
+        worker.generated = 0;
+        if (!found && this->limitReachedNow()) stopped = true;
+        return stopped;
+    }
+
+    vector<State> reconstructPath() const {
+        vector<State> path;
+        State state = this->problemInstance->initial_state;
+        path.push_back(state);
+        for (const Move& move : solution) {
+            instance->applyInPlace(state, move, 0);
+            path.push_back(state);
+        }
+        return path;
+    }
+
+    vector<State> finish() {
+        size_t steals = 0;
+        for (auto& worker : workers) {
+            steals += worker->steals;
+        }
+        this->bestBound = threshold; // every f below the threshold has been exhausted
+        this->searchStats["Iterations"] = iterations;
+        this->searchStats["Final Threshold"] = static_cast<double>(threshold);
+        this->searchStats["Subtrees"] = frontier.size();
+        this->searchStats["Steals"] = steals;
+        this->end();
+        if (!found) {
+            return {};
+        }
+        return reconstructPath();
+    }
+};
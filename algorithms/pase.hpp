@@ -0,0 +1,415 @@
+#pragma once
+#include "search.hpp"
+
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "closed_set.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include <iostream>
+
+#include <atomic>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+
+using std::lock_guard;
+using std::mutex;
+
+using namespace std;
+
+/**
+ * PA*SE (Phillips, Likhachev and Koenig 2014): parallel A* for slow expansions. A thread may expand any
+ * open node s that no other node can still improve: for every s' in open or being expanded with
+ * f(s') < f(s), g(s) <= g(s') + epsilon * h(s', s), where h(s', s) is the problem's pairwiseHeuristic.
+ * With epsilon = 1 every node is expanded with its optimal g and the path is optimal, a larger epsilon
+ * lets more nodes be expanded in parallel and the path costs at most epsilon times the optimum.
+ *
+ * Only the first CANDIDATE_LIMIT nodes of open (in f order) are tried. open, closed and the nodes being
+ * expanded share one lock, successors are generated outside it.
+ *
+ * The expensive part of an expansion is evaluating its edges (getCost and extra_expansion_time per edge).
+ * The mode decides who does that:
+ *   Nodes      the thread that expands a node evaluates all of its edges (PA*SE)
+ *   Edges      the expanding thread only lists the successors, every edge is queued and evaluated by
+ *              whichever thread is free, the node counts as being expanded until its last edge is committed (ePA*SE)
+ *   LazyEdges  the successors go into open as unevaluated edges keyed with a lower bound on their cost
+ *              (pairwiseHeuristic of the edge), an edge is only evaluated once it is picked from open,
+ *              so edges that never get near the top of open are never evaluated
+ */
+enum class EdgeMode { Nodes, Edges, LazyEdges };
+
+inline std::string toString(EdgeMode mode) {
+    switch (mode) {
+        case EdgeMode::Nodes: return "nodes";
+        case EdgeMode::Edges: return "edges";
+        case EdgeMode::LazyEdges: return "lazy edges";
+    }
+    return "unknown";
+}
+
+template<typename State, typename Cost = float>
+class PAStarSE : public Search<State, Cost> {
+    struct Node;
+    struct NodeCompare;
+    using Hot = HotNode<Cost>;
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
+
+    static constexpr size_t CANDIDATE_LIMIT = 64; // open nodes tried per pick, each costs up to CANDIDATE_LIMIT pairwise checks
+
+public:
+    PAStarSE(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time, size_t threadCount, double epsilon = 1,
+             EdgeMode mode = EdgeMode::Nodes)
+        : Search<State, Cost>(problemInstance),
+        open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}),
+        closed(&nodes, [this](const State& state) {
+            return this->hash(state);
+        }),
+        threadCount(max<size_t>(threadCount, 1)),
+        epsilon(static_cast<Cost>(epsilon)),
+        mode(mode) {
+        this->extra_expansion_time = extra_expansion_time;
+
+        this->searchStats["Algorithm"] = mode == EdgeMode::Nodes ? "PA*SE" : "ePA*SE";
+        this->searchStats["Edge Mode"] = toString(mode);
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = this->threadCount;
+        this->searchStats["Epsilon"] = epsilon;
+    }
+
+    vector<State> findPath() override {
+        this->start();
+        this->prefaultMemory(nodes, closed, threadCount);
+        Cost startH = this->heuristic(this->problemInstance->initial_state);
+        size_t startHash = closed.hash(this->problemInstance->initial_state);
+        NodeId startNode = nodes.emplace(Hot{startH, 0}, this->problemInstance->initial_state, startH, NO_NODE, startHash);
+
+        closed.insert(startNode, startHash);
+        open.push(startNode);
+
+        stop_source stopSource;
+        vector<jthread> threads;
+        for (size_t i = 0; i < threadCount; i++) {
+            threads.emplace_back(&PAStarSE::search, this, stopSource.get_token(), i);
+        }
+
+        // a thread finishes when it expands a goal, runs out of nodes or hits a limit, the others follow
+        spinThenWait(threadsCompleted, [](size_t completed) { return completed >= 1; }, waitStats);
+        stopSource.request_stop();
+        signalChange();
+        threads.clear(); // join
+
+        if (goal != NO_NODE)
+            this->pathLength = nodes.hot(goal).g;
+        else if (!open.empty())
+            this->bestBound = nodes.hot(open.top()).f;
+        return finish(goal);
+    }
+
+private:
+    // The cold part of a node, the f, g and heap index live in the arena's HotNode
+    struct Node {
+        const State state;
+        Cost h{};
+        NodeId parent = NO_NODE;
+        size_t hash = 0;
+        bool evaluated = true; // false for an edge from parent whose cost is unknown yet, its g is a lower bound
+        uint32_t pendingEdges = 0; // Edges mode: edges of this node not committed yet
+
+        Node(const State& s, Cost h, NodeId parent, size_t hash, bool evaluated = true)
+            : state(s), h(h), parent(parent), hash(hash), evaluated(evaluated) {}
+        Node(State&& s, Cost h, NodeId parent, size_t hash, bool evaluated = true)
+            : state(std::move(s)), h(h), parent(parent), hash(hash), evaluated(evaluated) {}
+    };
+
+    struct NodeCompare {
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return x.g < y.g;
+            return x.f < y.f;
+        }
+    };
+
+    // A successor generated outside the lock
+    struct Successor {
+        State state;
+        Cost g{}, h{};
+        size_t hash = 0;
+    };
+
+    Arena nodes; // allocation is thread safe
+    MinHeap open;
+    ClosedSet<State, Arena> closed;
+    size_t threadCount;
+    Cost epsilon;
+    EdgeMode mode;
+
+    mutex lock; // guards open, closed, beingExpanded, the g and f of nodes and the counters
+    vector<NodeId> beingExpanded; // nodes being expanded and, in LazyEdges mode, edges being evaluated
+    deque<NodeId> edgeQueue; // Edges mode: edges waiting for a thread, taken before any open node
+    NodeId goal = NO_NODE;
+    size_t independenceChecks = 0;
+    size_t blockedPicks = 0; // picks that found open nodes but none safe to expand
+    size_t edgesCreated = 0;
+    size_t edgesEvaluated = 0;
+
+    atomic<size_t> threadsCompleted{0};
+    atomic<uint32_t> version{0}; // bumped when open or beingExpanded changes, idle threads wait on it
+    WaitStats waitStats;
+
+    void signalChange() {
+        version.fetch_add(1, std::memory_order_release);
+        version.notify_all();
+    }
+
+    // Whether other, with a smaller f, may still lower the g of candidate. Called under lock.
+    bool mayImprove(NodeId other, NodeId candidate) {
+        const Hot& o = nodes.hot(other);
+        const Hot& c = nodes.hot(candidate);
+        if (o.f >= c.f) return false; // with a consistent heuristic only smaller f can lead to a cheaper path
+        independenceChecks++;
+        return c.g > o.g + epsilon * this->pairwiseHeuristic(nodes.cold(other).state, nodes.cold(candidate).state);
+    }
+
+    /**
+     * The first open node (in f order) that no node in open or being expanded can improve, taken out of open.
+     * Called under lock.
+     * @return NO_NODE when none of the first CANDIDATE_LIMIT nodes is safe
+     */
+    NodeId pickSafeNode() {
+        NodeId picked = NO_NODE;
+        vector<NodeId> before; // the open nodes ahead of the candidate, the only ones in open that can have a smaller f
+        open.visitInOrder(CANDIDATE_LIMIT, [&](NodeId candidate) {
+            if (!nodes.cold(candidate).evaluated) {
+                picked = candidate; // evaluating an edge commits nothing, the result goes back into open
+                return false;
+            }
+            bool safe = true;
+            for (NodeId other : beingExpanded) {
+                if (mayImprove(other, candidate)) {
+                    safe = false;
+                    break;
+                }
+            }
+            for (size_t i = 0; safe && i < before.size(); i++) {
+                if (mayImprove(before[i], candidate)) safe = false;
+            }
+            if (safe) {
+                picked = candidate;
+                return false;
+            }
+            before.push_back(candidate);
+            return true;
+        });
+        if (picked != NO_NODE) open.erase(picked);
+        else if (!open.empty()) blockedPicks++;
+        return picked;
+    }
+
+    void search(stop_token st, size_t id) {
+        this->pinThread(id);
+        typename Arena::LocalRange localNodes;
+        vector<Successor> successors;
+        while (!st.stop_requested()) {
+            NodeId current = NO_NODE;
+            uint32_t seenVersion = 0;
+            Cost g{};
+            bool isEdge = false;
+            {
+                lock_guard<mutex> guard(lock);
+                seenVersion = version.load(std::memory_order_acquire);
+                if (goal != NO_NODE || this->limitReached()) break;
+                if (!edgeQueue.empty()) {
+                    current = edgeQueue.front();
+                    edgeQueue.pop_front();
+                } else {
+                    current = pickSafeNode();
+                }
+                if (current == NO_NODE) {
+                    if (open.empty() && beingExpanded.empty()) break; // no path
+                } else if (!nodes.cold(current).evaluated) {
+                    isEdge = true;
+                    g = nodes.hot(nodes.cold(current).parent).g;
+                    if (mode == EdgeMode::LazyEdges) beingExpanded.push_back(current);
+                } else if (nodes.cold(current).h == 0) {
+                    goal = current; // safe, so its g is within epsilon of the optimum
+                    break;
+                } else {
+                    beingExpanded.push_back(current);
+                    g = nodes.hot(current).g;
+                    this->expandedNodes++;
+                }
+            }
+            if (current == NO_NODE) {
+                // everything in open depends on a node being expanded, wait for an expansion to finish
+                spinThenWait(version, [seenVersion](uint32_t v) { return v != seenVersion; }, waitStats);
+                continue;
+            }
+            if (isEdge) {
+                Cost edgeG = evaluate(nodes.cold(nodes.cold(current).parent).state, nodes.cold(current).state, g);
+                commitEdge(current, edgeG);
+            } else if (mode == EdgeMode::Nodes) {
+                generate(current, g, successors);
+                merge(current, successors, localNodes);
+            } else {
+                listEdges(current, g, successors);
+                addEdges(current, successors, localNodes);
+            }
+            signalChange();
+        }
+        nodes.release(localNodes);
+        threadsCompleted.fetch_add(1);
+        threadsCompleted.notify_all();
+    }
+
+    // The expensive part of generating a successor: the cost of the edge to it
+    Cost evaluate(const State& parent, const State& successor, Cost parentG) {
+        Cost g = parentG + this->getCost(parent, successor);
+        this->wasteTime(this->extra_expansion_time);
+        return g;
+    }
+
+    // Generates and evaluates every successor, done outside the lock
+    void generate(NodeId n, Cost g, vector<Successor>& successors) {
+        const State& state = nodes.cold(n).state;
+        successors.clear();
+        for (State& successorState : this->getSuccessors(state)) {
+            if (successorState == state) continue; // skip the parent state
+            Successor& successor = successors.emplace_back();
+            successor.g = evaluate(state, successorState, g);
+            successor.h = this->heuristic(successorState);
+            successor.hash = closed.hash(successorState);
+            successor.state = std::move(successorState);
+        }
+    }
+
+    void merge(NodeId n, vector<Successor>& successors, typename Arena::LocalRange& localNodes) {
+        lock_guard<mutex> guard(lock);
+        for (Successor& successor : successors) {
+            this->generatedNodes++;
+            NodeId duplicate = closed.find(successor.state, successor.hash);
+            if (duplicate != NO_NODE) {
+                improve(duplicate, successor.g, n);
+                this->generatedNodes--;
+                continue;
+            }
+            NodeId successorNode = nodes.emplaceLocal(localNodes, Hot{successor.g + successor.h, successor.g}, std::move(successor.state), successor.h, n, successor.hash);
+            closed.insert(successorNode, successor.hash);
+            open.push(successorNode);
+        }
+        removeBeingExpanded(n);
+    }
+
+    /**
+     * A node of open reached with g from parent. Called under lock.
+     * A node is only expanded once it is safe, so with epsilon = 1 closed nodes never improve;
+     * with a larger epsilon they are not reopened, which keeps the epsilon bound.
+     */
+    void improve(NodeId duplicate, Cost g, NodeId parent) {
+        Hot& duplicateNode = nodes.hot(duplicate);
+        if (duplicateNode.g > g && open.contains(duplicate)) {
+            this->duplicatedNodes++;
+            duplicateNode.g = g;
+            duplicateNode.f = g + nodes.cold(duplicate).h;
+            nodes.cold(duplicate).parent = parent;
+            open.update(duplicate);
+        }
+    }
+
+    void removeBeingExpanded(NodeId n) {
+        beingExpanded.erase(std::find(beingExpanded.begin(), beingExpanded.end(), n));
+    }
+
+    /**
+     * Lists the successors of n without evaluating their edges, g is only a lower bound (the parent's g plus
+     * the pairwise heuristic of the edge). Done outside the lock.
+     */
+    void listEdges(NodeId n, Cost g, vector<Successor>& successors) {
+        const State& state = nodes.cold(n).state;
+        successors.clear();
+        for (State& successorState : this->getSuccessors(state)) {
+            if (successorState == state) continue; // skip the parent state
+            Successor& successor = successors.emplace_back();
+            successor.g = g + this->pairwiseHeuristic(state, successorState);
+            successor.h = this->heuristic(successorState);
+            successor.hash = closed.hash(successorState);
+            successor.state = std::move(successorState);
+        }
+    }
+
+    // Turns the listed successors into edge nodes, skipping the ones that cannot improve a known node
+    void addEdges(NodeId n, vector<Successor>& successors, typename Arena::LocalRange& localNodes) {
+        lock_guard<mutex> guard(lock);
+        for (Successor& successor : successors) {
+            NodeId duplicate = closed.find(successor.state, successor.hash);
+            if (duplicate != NO_NODE && nodes.hot(duplicate).g <= successor.g) continue; // even the cheapest edge would not help
+            NodeId edge = nodes.emplaceLocal(localNodes, Hot{successor.g + successor.h, successor.g}, std::move(successor.state), successor.h, n, successor.hash, false);
+            edgesCreated++;
+            if (mode == EdgeMode::LazyEdges) {
+                open.push(edge);
+            } else {
+                edgeQueue.push_back(edge);
+                nodes.cold(n).pendingEdges++;
+            }
+        }
+        if (mode == EdgeMode::LazyEdges || nodes.cold(n).pendingEdges == 0) removeBeingExpanded(n);
+    }
+
+    // Commits an evaluated edge, its node becomes a regular open node unless the state is already known
+    void commitEdge(NodeId edge, Cost g) {
+        lock_guard<mutex> guard(lock);
+        Node& edgeNode = nodes.cold(edge);
+        NodeId parent = edgeNode.parent;
+        edgesEvaluated++;
+        this->generatedNodes++;
+        if (mode == EdgeMode::LazyEdges) removeBeingExpanded(edge);
+
+        NodeId duplicate = closed.find(edgeNode.state, edgeNode.hash);
+        if (duplicate != NO_NODE) {
+            improve(duplicate, g, parent);
+            this->generatedNodes--;
+        } else {
+            edgeNode.evaluated = true;
+            nodes.hot(edge).g = g;
+            nodes.hot(edge).f = g + edgeNode.h;
+            closed.insert(edge, edgeNode.hash);
+            open.push(edge);
+        }
+        if (mode == EdgeMode::Edges && --nodes.cold(parent).pendingEdges == 0) removeBeingExpanded(parent);
+    }
+
+    vector<State> reconstructPath(NodeId n) const {
+        vector<State> path;
+        NodeId current = n;
+        while (current != NO_NODE) {
+            path.push_back(nodes.cold(current).state);
+            current = nodes.cold(current).parent;
+        }
+        reverse(path.begin(), path.end());
+        return path;
+    }
+
+    vector<State> finish(NodeId n) {
+        this->recordNodeMemory(sizeof(Hot) + sizeof(Node), nodes.size());
+        this->recordTableMemory("Closed", closed);
+        this->searchStats["Open Memory"] = open.memoryBytes();
+        this->searchStats["Independence Checks"] = independenceChecks;
+        this->searchStats["Blocked Picks"] = blockedPicks;
+        if (mode != EdgeMode::Nodes) {
+            this->searchStats["Edges Created"] = edgesCreated;
+            this->searchStats["Edges Evaluated"] = edgesEvaluated;
+        }
+        this->recordWaitStats("Wait", waitStats);
+        this->end();
+        if (n == NO_NODE) {
+            return {};
+        }
+        return reconstructPath(n);
+    }
+};
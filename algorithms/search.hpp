@@ -1,6 +1,11 @@
 #pragma once
 
 #include "problem_instance.hpp"
+#include "memory_usage.hpp"
+#include "spin_wait.hpp"
+#include "thread_affinity.hpp"
+#include "huge_pages.hpp"
+#include <algorithm>
 #include <vector>
 #include <functional>
 #include <iostream>
@@ -14,6 +19,46 @@
 
 using Value = std::variant<int, long int, size_t, double, bool, std::string>;
 
+// How a search ended
+enum class SearchStatus {
+    Solved,
+    NoSolution,
+    ExpansionLimit,
+    GenerationLimit,
+    Timeout,
+    MemoryLimit
+};
+
+inline std::string toString(SearchStatus status) {
+    switch (status) {
+        case SearchStatus::Solved: return "Solved";
+        case SearchStatus::NoSolution: return "No Solution";
+        case SearchStatus::ExpansionLimit: return "Expansion Limit";
+        case SearchStatus::GenerationLimit: return "Generation Limit";
+        case SearchStatus::Timeout: return "Timeout";
+        case SearchStatus::MemoryLimit: return "Memory Limit";
+    }
+    return "Unknown";
+}
+
+// Bounds on the work a search may do before it gives up, 0 means unlimited
+struct SearchLimits {
+    size_t maxExpansions = 0;
+    size_t maxGenerated = 0;
+    double timeout = 0; // wall clock seconds
+    size_t memoryLimit = 0; // resident set size in bytes
+};
+
+// Everything a caller needs to know about a finished (or stopped) search
+template<typename State>
+struct SearchResult {
+    SearchStatus status;
+    std::vector<State> path;
+    long pathLength; // -1 unless a path was found, a stopped search reports the incumbent it holds
+    double bestBound; // best proven lower bound on the solution cost
+    std::map<std::string, Value> stats;
+};
+
 template<typename State, typename Cost = float>
 class Search {
 public:
@@ -40,6 +85,20 @@ public:
     size_t duplicatedNodes = 0; // Number of nodes duplicated during the search
     
     long pathLength = -1; // Length of the path found
+
+    SearchStatus status = SearchStatus::NoSolution;
+    double bestBound = -1; // Best proven lower bound on the solution cost (the path length when solved)
+
+    SearchLimits limits;
+
+    Cost weight = 1; // nodes are ordered by fValue = g + weight * h
+    double suboptimality = 1; // a solved path costs at most this many times the optimum, 0 when nothing bounds it
+    double referenceCost = 0; // the optimal cost when known (from an A* run), solved paths are rated against it
+
+    std::vector<int> threadCpus; // the cpu of each search thread, empty when threads are not pinned
+
+    size_t prefaultBytes = 0; // node storage to fault in before the search starts
+    double firstExpansionTime = -1; // seconds from start() to the first limit check, which precedes the first expansion
     
     // create a map of string to string to store the search statistics
     std::map<std::string, Value> searchStats;
@@ -48,8 +107,10 @@ public:
     
     inline std::vector<State> getSuccessors(const State& state) const { return problemInstance->getSuccessors(state); }
     inline Cost heuristic(const State& state) const { return problemInstance->heuristic(state); }
+    inline Cost pairwiseHeuristic(const State& from, const State& to) const { return problemInstance->pairwiseHeuristic(from, to); }
     inline Cost getCost(const State& state, const State& successor) const { return problemInstance->getCost(state, successor); }
     inline size_t hash(const State& state) const { return problemInstance->hash(state); }
+    inline Cost fValue(Cost g, Cost h) const { return g + weight * h; }
 
     virtual std::vector<State> findPath() = 0;
 
@@ -61,6 +122,144 @@ public:
         }
     }
 
+    /**
+     * Checks the expansion, generation, time and memory limits and marks the search as stopped.
+     * Counters are compared on every call, the clock only every TIME_CHECK_INTERVAL calls and
+     * the resident set size (a syscall) only every MEMORY_CHECK_INTERVAL calls.
+     * Not thread safe, call it from a single thread (or under a lock).
+     * @return true once any limit has been reached
+     */
+    inline bool limitReached() {
+        if (firstExpansionTime < 0) [[unlikely]] {
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - clockStart;
+            firstExpansionTime = elapsed.count();
+        }
+        if (status != SearchStatus::NoSolution) return true;
+        if (limits.maxExpansions != 0 && expandedNodes >= limits.maxExpansions) {
+            return stopSearch(SearchStatus::ExpansionLimit);
+        }
+        if (limits.maxGenerated != 0 && generatedNodes >= limits.maxGenerated) {
+            return stopSearch(SearchStatus::GenerationLimit);
+        }
+        if (--limitCheckCountdown > 0) return false;
+        limitCheckCountdown = TIME_CHECK_INTERVAL;
+
+        if (limits.timeout > 0) {
+            std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - clockStart;
+            if (elapsed.count() >= limits.timeout) return stopSearch(SearchStatus::Timeout);
+        }
+        if (limits.memoryLimit != 0 && ++memoryCheckCount % (MEMORY_CHECK_INTERVAL / TIME_CHECK_INTERVAL) == 0) {
+            if (MemoryUsage::currentRSS() >= limits.memoryLimit) return stopSearch(SearchStatus::MemoryLimit);
+        }
+        return false;
+    }
+
+    /**
+     * limitReached for engines that already call it only every few thousand expansions, the clock is read
+     * on every call so a timeout is not overshot by TIME_CHECK_INTERVAL batches
+     */
+    inline bool limitReachedNow() {
+        limitCheckCountdown = 1;
+        return limitReached();
+    }
+
+    /**
+     * Runs the search under the given limits
+     * @return the status, path, best bound and statistics of the run
+     */
+    SearchResult<State> run(const SearchLimits& searchLimits) {
+        limits = searchLimits;
+        std::vector<State> path = findPath();
+        return {status, std::move(path), pathLength, bestBound, searchStats};
+    }
+
+    /**
+     * Chooses the cpus search threads are pinned to, see ThreadAffinity for the policies.
+     * An empty policy leaves threads unpinned. The topology is recorded either way.
+     */
+    void setAffinity(const std::string& policy) {
+        auto topology = ThreadAffinity::readTopology();
+        threadCpus = ThreadAffinity::cpuOrder(policy, topology);
+        searchStats["Affinity"] = policy.empty() ? std::string("none") : policy;
+        searchStats["Topology"] = ThreadAffinity::describe(topology);
+        searchStats["Affinity CPUs"] = ThreadAffinity::toString(threadCpus);
+    }
+
+    // Pins the calling thread, the threadIndex-th thread of the search, to its cpu
+    void pinThread(size_t threadIndex) {
+        if (threadCpus.empty()) return;
+        int cpu = threadCpus[threadIndex % threadCpus.size()];
+        if (!ThreadAffinity::pinCurrentThread(cpu)) {
+            std::clog << "Could not pin thread " << threadIndex << " to cpu " << cpu << std::endl;
+        }
+    }
+
+    /**
+     * Chooses the backing of node arenas and closed tables (see HugePages) and how many bytes of node
+     * storage prefaultMemory() faults in. Call it before the search allocates anything.
+     */
+    void setMemoryBacking(HugePages::Mode mode, size_t bytes) {
+        HugePages::setMode(mode);
+        prefaultBytes = bytes;
+        searchStats["Huge Pages"] = HugePages::toString(mode);
+    }
+
+    /**
+     * Faults in the first prefaultBytes of the arena with threads threads (pinned like the search threads)
+     * and sizes the closed table for as many nodes. Call it right after start(), the time it takes counts
+     * towards the time to the first expansion.
+     */
+    template<typename Arena, typename Table>
+    void prefaultMemory(Arena& arena, Table& closed, size_t threads) {
+        if (prefaultBytes == 0) return;
+        auto prefaultStart = std::chrono::high_resolution_clock::now();
+        size_t nodeCount = prefaultBytes / Arena::NODE_BYTES;
+        size_t bytes = arena.prefault(nodeCount, threads, [this](size_t i) { pinThread(i); });
+        closed.reserve(nodeCount);
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - prefaultStart;
+        searchStats["Prefault Bytes"] = bytes;
+        searchStats["Prefault Time"] = elapsed.count();
+    }
+
+    /**
+     * Orders nodes by g + w * h (weighted A*), w > 1 finds paths costing at most w times the optimum with
+     * far fewer expansions. Engines that order by fValue support it: A*, CAFE, KBFS, SPA*, beam and bounded best
+     * first search. ARA* starts from it and lowers it.
+     */
+    void setWeight(double w) {
+        weight = static_cast<Cost>(w);
+        suboptimality = w;
+        searchStats["Weight"] = w;
+    }
+
+    // Rates the path found against the optimal cost, reported as "Cost Ratio"
+    void setReferenceCost(double cost) {
+        referenceCost = cost;
+    }
+
+    // Record how many bytes the node storage uses
+    void recordNodeMemory(size_t nodeBytes, size_t nodeCount) {
+        searchStats["Node Bytes"] = nodeBytes;
+        searchStats["Node Count"] = nodeCount;
+        searchStats["Node Memory"] = nodeBytes * nodeCount;
+    }
+
+    // Record size, load factor and approximate footprint of a hash table under the given name
+    template<typename Table>
+    void recordTableMemory(const std::string& name, const Table& table) {
+        searchStats[name + " Entries"] = table.size();
+        searchStats[name + " Load Factor"] = static_cast<double>(table.load_factor());
+        searchStats[name + " Memory"] = MemoryUsage::hashTableBytes(table);
+    }
+
+    // Record how often and how long threads waited at the wait sites sharing stats
+    void recordWaitStats(const std::string& name, const WaitStats& stats) {
+        searchStats[name + " Waits"] = static_cast<size_t>(stats.waits.load());
+        searchStats[name + " Blocks"] = static_cast<size_t>(stats.blocks.load());
+        searchStats[name + " Spin Time"] = stats.spinSeconds(); // cpu burned while waiting
+        searchStats[name + " Blocked Time"] = stats.blockedSeconds(); // cpu given back while waiting
+    }
+
     inline std::string toJsonValue(const Value& v) {
         return std::visit([](auto&& arg) -> std::string {
             using T = std::decay_t<decltype(arg)>;
@@ -107,6 +306,48 @@ public:
         searchStats["Elapsed Time"] = elapsed.count();
         searchStats["Path Length"] = pathLength;
 
+        if (pathLength >= 0 && status == SearchStatus::NoSolution) {
+            status = SearchStatus::Solved;
+            bestBound = suboptimality > 0 ? pathLength / suboptimality : -1;
+        } else if (pathLength >= 0 && bestBound <= 0) {
+            // stopped by a limit with a solution in hand and no bound from open, the solution's own bound
+            bestBound = suboptimality > 0 ? pathLength / suboptimality : -1;
+        } else if (bestBound > 0) {
+            // engines report the smallest fValue left in open, which is at most weight times the optimum
+            bestBound /= weight;
+        }
+        searchStats["Suboptimality Bound"] = suboptimality;
+        if (referenceCost > 0) {
+            searchStats["Reference Cost"] = referenceCost;
+            searchStats["Cost Ratio"] = pathLength >= 0 ? pathLength / referenceCost : -1.0;
+        }
+        searchStats["Status"] = toString(status);
+        searchStats["Best Bound"] = bestBound;
+        searchStats["Peak RSS"] = MemoryUsage::peakRSS();
+
+        // startup cost (page faults included) and the rate once the search is running
+        searchStats["Time To First Expansion"] = firstExpansionTime;
+        double runningTime = elapsed.count() - std::max(firstExpansionTime, 0.0);
+        searchStats["Expansion Rate"] = runningTime > 0 ? expandedNodes / runningTime : 0.0;
+        HugePages::Counters& pages = HugePages::counters();
+        searchStats["Reserved Explicit Huge Page Bytes"] = pages.explicitBytes.load(); // cumulative, see HugePages::Counters
+        searchStats["Reserved Transparent Huge Page Bytes"] = pages.transparentBytes.load();
+        searchStats["Reserved Small Page Bytes"] = pages.smallBytes.load();
+        searchStats["Huge Page Fallbacks"] = pages.fallbacks.load();
+        searchStats["AnonHugePages"] = MemoryUsage::anonHugePageBytes(); // what the kernel actually backed with THP
+
         this->printStats();
     }
+
+private:
+    static constexpr size_t TIME_CHECK_INTERVAL = 256;
+    static constexpr size_t MEMORY_CHECK_INTERVAL = 4096;
+    size_t limitCheckCountdown = TIME_CHECK_INTERVAL;
+    size_t memoryCheckCount = 0;
+
+    bool stopSearch(SearchStatus reason) {
+        status = reason;
+        std::clog << toString(reason) << " reached" << std::endl;
+        return true;
+    }
 }; 
\ No newline at end of file
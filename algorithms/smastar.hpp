@@ -0,0 +1,384 @@
+#pragma once
+#include "search.hpp"
+
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "closed_set.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+#include <queue>
+#include <utility>
+#include <vector>
+#include <iostream>
+
+using namespace std;
+
+/**
+ * Simplified Memory-bounded A* (Russell 1992). A* that never holds more than nodeBudget nodes: when the
+ * budget is full, the worst leaf in open (highest f, then shallowest) is forgotten. Its f is backed up
+ * into its parent, which remembers it by successor and goes back into open keyed with the smallest f it
+ * forgot, so the forgotten subtrees are regenerated when they are the best thing left, keyed with at least
+ * the f they backed up (pathmax). A successor that would itself be the worst leaf is not generated, its f
+ * is backed up the same way.
+ *
+ * Expanded nodes left without children (dead ends, every successor was a duplicate) stay in open with an
+ * infinite f: they keep catching duplicates, but they are the first to go when memory is needed. As in the
+ * original, nodes too deep for a successor to fit with their path are dead ends too.
+ *
+ * The path is optimal as long as the budget can hold it with the siblings along it. Otherwise the search
+ * stops with Memory Limit once every f left in open is infinite. Forgotten ids are reused, so the arena,
+ * closed and open stay within the budget.
+ */
+template<typename State, typename Cost = float>
+class SMAStar : public Search<State, Cost> {
+    struct Node;
+    struct NodeCompare;
+    using Hot = HotNode<Cost>;
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
+
+    static constexpr Cost INFINITE_COST = numeric_limits<Cost>::max();
+
+public:
+    SMAStar(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time, size_t nodeBudget)
+        : Search<State, Cost>(problemInstance),
+        open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}),
+        closed(&nodes, [this](const State& state) {
+            return this->hash(state);
+        }),
+        nodeBudget(max<size_t>(nodeBudget, 2)) {
+        this->extra_expansion_time = extra_expansion_time;
+
+        this->searchStats["Algorithm"] = "SMA*";
+        this->searchStats["Extra Expansion Time"] = extra_expansion_time;
+        this->searchStats["Threads"] = 1;
+        this->searchStats["Node Budget"] = this->nodeBudget;
+    }
+
+    vector<State> findPath() override {
+        this->start();
+        this->prefaultMemory(nodes, closed, 1);
+
+        Cost startH = this->heuristic(this->problemInstance->initial_state);
+        NodeId startNode = allocate(Hot{startH, 0}, this->problemInstance->initial_state, startH, NO_NODE, 0, 0);
+        closed.insert(startNode, nodes.cold(startNode).state);
+        enqueue(startNode);
+
+        while (!open.empty() && !outOfMemory) {
+            NodeId current = open.top();
+            if (nodes.hot(current).f == INFINITE_COST) break; // nothing left that fits in memory
+            if (this->limitReached()) {
+                this->bestBound = nodes.hot(current).f;
+                break;
+            }
+            open.pop();
+            if (nodes.cold(current).h == 0){
+                this->pathLength = nodes.hot(current).g;
+                return finish(current);
+            }
+            expand(current);
+        }
+        if (outOfMemory || depthCut) { // open ran out only because paths were too long to hold
+            this->status = SearchStatus::MemoryLimit;
+            if (!open.empty() && nodes.hot(open.top()).f != INFINITE_COST) this->bestBound = nodes.hot(open.top()).f;
+        }
+        return finish(NO_NODE);
+    }
+
+private:
+    // The cold part of a node, the f, g and heap index live in the arena's HotNode
+    struct Node {
+        const State state;
+        Cost h{};
+        NodeId parent = NO_NODE;
+        uint32_t depth = 0;
+        uint32_t slot = 0; // index among the parent's successors
+        uint32_t children = 0; // successors in memory whose parent this is
+        bool expanded = false;
+        vector<pair<uint32_t, Cost>> backedUp; // (slot, f) of the successors forgotten or left out
+
+        Node(const State& s, Cost h, NodeId parent, uint32_t depth, uint32_t slot)
+            : state(s), h(h), parent(parent), depth(depth), slot(slot) {}
+
+        Cost bestBackedUp() const {
+            Cost best = INFINITE_COST;
+            for (const auto& [slot, f] : backedUp) {
+                best = min(best, f);
+            }
+            return best;
+        }
+
+        void backUp(uint32_t slot, Cost f) {
+            for (auto& entry : backedUp) {
+                if (entry.first == slot) {
+                    entry.second = f;
+                    return;
+                }
+            }
+            backedUp.emplace_back(slot, f);
+        }
+
+        // Takes the backed up f of a successor out, as it is about to be in memory again
+        optional<Cost> takeBackedUp(uint32_t slot) {
+            for (auto it = backedUp.begin(); it != backedUp.end(); ++it) {
+                if (it->first == slot) {
+                    Cost f = it->second;
+                    backedUp.erase(it);
+                    return f;
+                }
+            }
+            return nullopt;
+        }
+    };
+
+    struct NodeCompare {
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return nodes->cold(a).depth > nodes->cold(b).depth; // deeper first
+            return x.f < y.f;
+        }
+    };
+
+    // A candidate for forgetting, stale once the node changed (generation) or stopped being a leaf in open
+    struct Leaf {
+        Cost f;
+        uint32_t depth;
+        NodeId id;
+        uint32_t generation;
+
+        bool operator<(const Leaf& other) const { // the top is the highest f, then the shallowest
+            if (f == other.f) return depth > other.depth;
+            return f < other.f;
+        }
+    };
+
+    Arena nodes;
+    MinHeap open;
+    ClosedSet<State, Arena> closed;
+    priority_queue<Leaf> leaves;
+    vector<uint32_t> generations; // per id, bumped when the node is forgotten
+    vector<NodeId> freeIds;
+
+    size_t nodeBudget;
+    size_t liveNodes = 0;
+    size_t peakLiveNodes = 0;
+    size_t forgottenNodes = 0;
+    size_t reexpansions = 0;
+    size_t regeneratedNodes = 0;
+    bool outOfMemory = false;
+    bool depthCut = false; // a node was too deep to hold a successor along with its path
+    NodeId expanding = NO_NODE; // not requeued until its expansion is over
+
+    template<typename... ColdArgs>
+    NodeId allocate(const Hot& hot, ColdArgs&&... coldArgs) {
+        NodeId id;
+        if (!freeIds.empty()) {
+            id = freeIds.back();
+            freeIds.pop_back();
+            nodes.reconstruct(id, hot, std::forward<ColdArgs>(coldArgs)...);
+        } else {
+            id = nodes.emplace(hot, std::forward<ColdArgs>(coldArgs)...);
+            generations.push_back(0);
+        }
+        liveNodes++;
+        peakLiveNodes = max(peakLiveNodes, liveNodes);
+        return id;
+    }
+
+    // Puts the node into open, or moves it to its new place, and makes it a candidate for forgetting
+    void enqueue(NodeId id) {
+        if (open.contains(id))
+            open.update(id);
+        else
+            open.push(id);
+        if (nodes.cold(id).children == 0) {
+            leaves.push(Leaf{nodes.hot(id).f, nodes.cold(id).depth, id, generations[id]});
+        }
+        if (leaves.size() > 4 * nodeBudget) pruneLeaves();
+    }
+
+    /**
+     * Keys an expanded node in open with the best f backed up from its successors, so it regenerates them
+     * when that is the best thing left. One with children but nothing to regenerate leaves open, one without
+     * children stays in it (with an infinite f when nothing is left below it) to be forgotten.
+     */
+    void requeue(NodeId id) {
+        Node& node = nodes.cold(id);
+        if (!node.expanded || id == expanding) return;
+        Cost best = node.bestBackedUp();
+        if (best == INFINITE_COST && node.children > 0) {
+            if (open.contains(id)) open.erase(id);
+            return;
+        }
+        nodes.hot(id).f = best;
+        enqueue(id);
+    }
+
+    bool isLeaf(const Leaf& leaf) const {
+        return generations[leaf.id] == leaf.generation && open.contains(leaf.id)
+            && nodes.cold(leaf.id).children == 0 && nodes.hot(leaf.id).f == leaf.f;
+    }
+
+    // Drops the stale candidates so the queue stays proportional to the budget
+    void pruneLeaves() {
+        vector<Leaf> live;
+        while (!leaves.empty()) {
+            if (isLeaf(leaves.top())) live.push_back(leaves.top());
+            leaves.pop();
+        }
+        leaves = priority_queue<Leaf>(less<Leaf>(), std::move(live));
+    }
+
+    /**
+     * The worst leaf in open other than keep, dead ends first, left at the top of leaves
+     * @return nothing when there is none, every node in memory is on the way to keep
+     */
+    optional<Leaf> worstLeaf(NodeId keep) {
+        optional<Leaf> kept;
+        optional<Leaf> worst;
+        while (!leaves.empty() && !worst) {
+            Leaf leaf = leaves.top();
+            if (!isLeaf(leaf)) {
+                leaves.pop();
+            } else if (leaf.id == keep) {
+                kept = leaf;
+                leaves.pop();
+            } else {
+                worst = leaf;
+            }
+        }
+        if (kept) leaves.push(*kept);
+        return worst;
+    }
+
+    // Frees a leaf and backs its f up into its parent
+    void forget(NodeId id, Cost f) {
+        Node& node = nodes.cold(id);
+        NodeId parent = node.parent;
+        closed.erase(node.state, closed.hash(node.state));
+        generations[id]++;
+        freeIds.push_back(id);
+        liveNodes--;
+        forgottenNodes++;
+        if (parent == NO_NODE) return;
+
+        Node& parentNode = nodes.cold(parent);
+        parentNode.children--;
+        parentNode.backUp(node.slot, f);
+        requeue(parent);
+    }
+
+    // Moves a node under a new parent, what it backed up was for its old g
+    void reparent(NodeId id, NodeId parent, uint32_t slot) {
+        Node& node = nodes.cold(id);
+        NodeId old = node.parent;
+        node.parent = parent;
+        node.slot = slot;
+        node.depth = nodes.cold(parent).depth + 1;
+        node.backedUp.clear();
+        nodes.cold(parent).children++;
+        if (old == NO_NODE) return;
+        nodes.cold(old).children--;
+        requeue(old);
+    }
+
+    void expand(NodeId n) {
+        this->expandedNodes++;
+        expanding = n;
+        Node& node = nodes.cold(n);
+        bool again = node.expanded;
+        if (again) reexpansions++;
+        node.expanded = true;
+        const State& state = node.state;
+        if (node.depth + 2 > nodeBudget) { // the path to a successor would not fit, n is a dead end
+            depthCut = true;
+            expanding = NO_NODE;
+            requeue(n);
+            return;
+        }
+
+        uint32_t slot = 0;
+        for (const auto& successorState : this->getSuccessors(state)) {
+            uint32_t successorSlot = slot++;
+            if (successorState == state) continue; // skip the parent state
+            optional<Cost> backedUp = node.takeBackedUp(successorSlot);
+            if (backedUp == INFINITE_COST) { // nothing below it fits
+                node.backUp(successorSlot, INFINITE_COST);
+                continue;
+            }
+            this->generatedNodes++;
+            Cost g = nodes.hot(n).g + this->getCost(state, successorState);
+
+            size_t successorHash = closed.hash(successorState);
+            NodeId duplicate = closed.find(successorState, successorHash);
+            if (duplicate != NO_NODE) {
+                this->generatedNodes--; // undo the generation of the duplicate
+                Hot& duplicateNode = nodes.hot(duplicate);
+                if (duplicateNode.g <= g || duplicate == node.parent) continue;
+                this->duplicatedNodes++;
+                duplicateNode.g = g;
+                duplicateNode.f = g + nodes.cold(duplicate).h;
+                reparent(duplicate, n, successorSlot);
+                enqueue(duplicate); // reopen, its successors get the better g when it is expanded
+                continue;
+            }
+
+            Cost h = this->heuristic(successorState);
+            Cost f = backedUp ? max(g + h, *backedUp) : g + h; // pathmax, what it backed up bounds it
+            if (liveNodes >= nodeBudget) {
+                optional<Leaf> worst = worstLeaf(n);
+                if (!worst) {
+                    outOfMemory = true; // the budget cannot even hold the path to n and its successors
+                    break;
+                }
+                if (!(Leaf{f, node.depth + 1, NO_NODE, 0} < *worst)) {
+                    node.backUp(successorSlot, f); // it would be the worst leaf itself
+                    continue;
+                }
+                leaves.pop();
+                open.erase(worst->id);
+                forget(worst->id, worst->f);
+            }
+            NodeId successor = allocate(Hot{f, g}, successorState, h, n, node.depth + 1, successorSlot);
+            closed.insert(successor, successorHash);
+            node.children++;
+            if (again) regeneratedNodes++;
+            this->wasteTime(this->extra_expansion_time);
+            enqueue(successor);
+        }
+
+        expanding = NO_NODE;
+        requeue(n);
+    }
+
+    vector<State> reconstructPath(NodeId goal) const {
+        vector<State> path;
+        NodeId current = goal;
+        while (current != NO_NODE) {
+            path.push_back(nodes.cold(current).state);
+            current = nodes.cold(current).parent;
+        }
+        reverse(path.begin(), path.end());
+        return path;
+    }
+
+    vector<State> finish(NodeId n) {
+        this->recordNodeMemory(sizeof(Hot) + sizeof(Node), nodes.size());
+        this->recordTableMemory("Closed", closed);
+        this->searchStats["Open Memory"] = open.memoryBytes();
+        this->searchStats["Peak Live Nodes"] = peakLiveNodes;
+        this->searchStats["Forgotten Nodes"] = forgottenNodes;
+        this->searchStats["Reexpansions"] = reexpansions;
+        this->searchStats["Regenerated Nodes"] = regeneratedNodes;
+        this->end();
+        if(n == NO_NODE) {
+            return {};
+        }
+        return reconstructPath(n);
+    }
+};
@@ -1,17 +1,16 @@
 #pragma once
 #include "search.hpp"
 
-#include <boost/unordered/unordered_flat_map.hpp>
-using boost::unordered_flat_map;
-
-#include <queue>
-#include <boost/heap/d_ary_heap.hpp>
+#include "node_arena.hpp"
+#include "indexed_heap.hpp"
+#include "closed_set.hpp"
 
 #include <algorithm>
 #include <vector>
 #include <iostream>
 
 #include <atomic>
+#include <limits>
 #include <mutex>
 #include <stop_token>
 
@@ -29,15 +28,16 @@ class SPAStar : public Search<State, Cost> {
 
     struct Node;
     struct NodeCompare;
-    using MinHeap = boost::heap::d_ary_heap<Node*, boost::heap::arity<2>, boost::heap::mutable_<true>, boost::heap::compare<NodeCompare>>;
+    using Hot = HotNode<Cost>;
+    using Arena = NodeArena<Hot, Node>;
+    using MinHeap = IndexedHeap<NodeCompare, ArenaHeapIndex<Arena>>;
 
 public:
-    SPAStar(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time, size_t threadCount) : Search<State, Cost>(problemInstance){
-        open = MinHeap();
-        closed = unordered_flat_map<State, Node*, HashFn>(0,     
-        [this](const State& state) {
+    SPAStar(const ProblemInstance<State, Cost>* problemInstance, size_t extra_expansion_time, size_t threadCount) : Search<State, Cost>(problemInstance),
+        open(NodeCompare{&nodes}, ArenaHeapIndex<Arena>{&nodes}),
+        closed(&nodes, [this](const State& state) {
             return this->hash(state);
-        });
+        }) {
         this->extra_expansion_time = extra_expansion_time;
         this->threadCount = threadCount;
 
@@ -49,112 +49,108 @@ public:
 
     vector<State> findPath() override {
         this->start();
-        nodes.reserve(10'000'000); // reserve 10 million nodes
-        // Side note, push back is amortized O(1), so we can compare the speed loss of reserve vs push_back at some point
-
-        nodes.emplace_back(this->problemInstance->initial_state,
-            0, this->heuristic(this->problemInstance->initial_state), nullptr);
-        Node* startNode = &nodes.back();
+        this->prefaultMemory(nodes, closed, threadCount);
+        Cost startH = this->heuristic(this->problemInstance->initial_state);
+        NodeId startNode = nodes.emplace(Hot{this->fValue(0, startH), 0}, this->problemInstance->initial_state, startH, NO_NODE);
 
-        closed.emplace(startNode->state, startNode);
-        startNode->handle = open.push(startNode);
+        closed.insert(startNode, nodes.cold(startNode).state);
+        if (startH == 0)
+            offerSolution(startNode);
+        else
+            open.push(startNode);
 
         // create a stop source
         stop_source stopSource;
 
         // start this->threadCount threads doing search()
         vector<jthread> threads;
-        vector<Node*> finish_states;
-        finish_states.resize(this->threadCount);
         for (size_t i = 0; i < this->threadCount; i++) {
-            threads.emplace_back(&SPAStar::search, this, stopSource.get_token(), &finish_states[i]);
+            threads.emplace_back(&SPAStar::search, this, stopSource.get_token(), i);
         }
 
-        // wait finished threads to be > 0
-        while (threadsCompleted.load() < 1) {
-            this_thread::yield();
-        }
+        // a thread only finishes once nothing cheaper than the incumbent is left, or on a limit
+        spinThenWait(threadsCompleted, [](size_t completed) { return completed >= 1; }, waitStats);
 
         // now we know that at least one thread has finished, so we can request stop    
         stopSource.request_stop();
+        signalOpen(); // wake the threads waiting for open
 
         // now we wait for all the threads to finish
         for (size_t i = 0; i < threads.size(); i++) {
             threads[i].join();
         }
 
-        // check all the threads finish states to see which has the smallest f while having h = 0
-        Node* finish_state = nullptr;
-        for (size_t i = 0; i < finish_states.size(); i++) {
-            if (finish_states[i] == nullptr) continue;
-            if (finish_states[i]->h == 0) {
-                if (finish_state == nullptr || finish_states[i]->f < finish_state->f) {
-                    finish_state = finish_states[i];
-                }
-            }
-        }
-        if (finish_state != nullptr)
-            this->pathLength = finish_state->g;
-        return finish(finish_state);
+        // without a limit open holds nothing with f below the incumbent, so it is optimal, with one it is the best so far
+        NodeId goal = incumbentNode;
+        if (goal != NO_NODE)
+            this->pathLength = nodes.hot(goal).g;
+        if (this->status != SearchStatus::NoSolution && !open.empty())
+            this->bestBound = std::min(nodes.hot(open.top()).f, incumbent.load());
+        return finish(goal);
     }
 
-    void search(stop_token st, Node** finish_state) {
+    void search(stop_token st, size_t id) {
+        this->pinThread(id);
+        typename Arena::LocalRange localNodes; // this thread's nodes share pages, first touched on its NUMA node
         while (!st.stop_requested()) {
-            Node* current;
+            NodeId current = NO_NODE;
+            uint32_t seenVersion = 0;
             {
                 lock_guard<mutex> lock(open_mutex); // lock for heap operations
-                if (open.empty()) {
-                    if(threadsCompleted.load() == this->threadCount-1) {
+                // read before checking activeExpansions, so an expansion ending after the check still wakes this thread
+                seenVersion = openVersion.load(std::memory_order_acquire);
+                if (limitReached()) break;
+                if (open.empty() || nodes.hot(open.top()).f >= incumbent.load(std::memory_order_relaxed)) {
+                    // nothing left that could beat the incumbent and nobody can push anymore, the search is over
+                    if (activeExpansions.load() == 0) {
                         break;
                     }
-                    continue;
+                } else {
+                    current = open.top();
+                    open.pop();
+                    activeExpansions.fetch_add(1);
                 }
-                current = open.top();
-                open.pop();
-
             }
-            if (current->h == 0){
-                *finish_state = current; // update the output pointer
-                break;
+            if (current == NO_NODE) {
+                // other threads are still expanding, wait for them to push a node or to finish
+                spinThenWait(openVersion, [seenVersion](uint32_t version) { return version != seenVersion; }, waitStats);
+                continue;
             }
-            expand(current);
+            expand(current, localNodes);
+            finishExpansion();
         }
+        nodes.release(localNodes);
         threadsCompleted.fetch_add(1);
+        threadsCompleted.notify_all();
     }
 
 private:
+    // The cold part of a node, the f, g and heap index live in the arena's HotNode
     struct Node {
-        MinHeap::handle_type handle;
         const State state;
-        Cost f{}, g{}, h{};
-        Node* parent;
-
-        Node() = default;
-        Node(State s) : state(s), parent(nullptr) {}
-        Node(State s, Cost g, Cost h, Node* parent) : state(s), g(g), h(h), parent(parent) {
-            f = g + h;
-        }
+        Cost h{};
+        NodeId parent = NO_NODE;
 
-        bool operator > (const Node& other) const { 
-            if (f == other.f) 
-                return g > other.g;
-            return f > other.f;
-        }
+        Node(const State& s, Cost h, NodeId parent) : state(s), h(h), parent(parent) {}
     };
 
     struct NodeCompare {
-        bool operator()(const Node* a, const Node* b) const {
-            return *a > *b;
+        const Arena* nodes;
+        bool operator()(NodeId a, NodeId b) const {
+            const Hot& x = nodes->hot(a);
+            const Hot& y = nodes->hot(b);
+            if (x.f == y.f)
+                return x.g < y.g;
+            return x.f < y.f;
         }
     };
 
-    vector<Node> nodes;
+    Arena nodes; // allocation is thread safe, so no lock is needed to add nodes
     MinHeap open;
-    unordered_flat_map<State, Node*, HashFn> closed;
+    ClosedSet<State, Arena> closed;
     size_t threadCount = 0;
     mutex open_mutex{};
     mutex closed_mutex{};
-    mutex nodes_mutex{};
 
     // These are just for data collection
     mutex generated_mutex{};
@@ -162,50 +158,97 @@ private:
     mutex duplicated_mutex{};
     
     atomic<size_t> threadsCompleted{0}; // Track total completed threads
+    atomic<size_t> activeExpansions{0}; // Nodes popped from open whose successors are not pushed yet
+    atomic<uint32_t> openVersion{0}; // bumped when a node is pushed or the last expansion ends, idle threads wait on it
+    WaitStats waitStats;
+
+    // The cheapest solution found so far, written under closed_mutex. Goal nodes never go into open,
+    // nodes with f at or above the incumbent are not generated and not expanded.
+    atomic<Cost> incumbent{numeric_limits<Cost>::max()};
+    NodeId incumbentNode = NO_NODE;
+    size_t prunedNodes = 0; // guarded by generated_mutex
+
+    // Called under closed_mutex for a goal node whose g just got set
+    void offerSolution(NodeId goal) {
+        Cost g = nodes.hot(goal).g;
+        if (g < incumbent.load(std::memory_order_relaxed)) {
+            incumbent.store(g, std::memory_order_relaxed);
+            incumbentNode = goal;
+        }
+    }
+
+    // Wakes the threads waiting for open to change
+    void signalOpen() {
+        openVersion.fetch_add(1, std::memory_order_release);
+        openVersion.notify_all();
+    }
+
+    // The last expansion ending with an empty open means there is no path, the waiting threads have to see it
+    void finishExpansion() {
+        if (activeExpansions.fetch_sub(1) == 1) signalOpen();
+    }
+
+    // Called under open_mutex so only one thread at a time checks the limits
+    bool limitReached() {
+        lock_guard<mutex> expandedLock(expanded_mutex);
+        lock_guard<mutex> generatedLock(generated_mutex);
+        return Search<State, Cost>::limitReached();
+    }
 
-    void expand(Node* n) {
+    void expand(NodeId n, typename Arena::LocalRange& localNodes) {
         {
             lock_guard<mutex> lock(expanded_mutex);
             this->expandedNodes++;
         }
-        for (const auto& successorState : this->getSuccessors(n->state)) {
-            if (successorState == n->state) continue; // skip the parent state
+        const State& state = nodes.cold(n).state;
+        Cost parentG;
+        {
+            const lock_guard<mutex> lock(closed_mutex); // a cheaper path may be updating it
+            parentG = nodes.hot(n).g;
+        }
+        for (const auto& successorState : this->getSuccessors(state)) {
+            if (successorState == state) continue; // skip the parent state
             {
                 lock_guard<mutex> lock(generated_mutex);
                 this->generatedNodes++;
             }
             this->wasteTime(this->extra_expansion_time);
             // Generate the successor node and calculate its f, g, and h values
-            Node* successor;
-            {
-                lock_guard<mutex> lock(nodes_mutex);
-                nodes.emplace_back(successorState,
-                    n->g + this->getCost(n->state, successorState),
-                    this->heuristic(successorState),
-                    n);
-                successor = &nodes.back();
+            Cost g = parentG + this->getCost(state, successorState);
+            Cost h = this->heuristic(successorState);
+            Cost f = this->fValue(g, h);
+            if (f >= incumbent.load(std::memory_order_relaxed)) {
+                lock_guard<mutex> lock(generated_mutex);
+                prunedNodes++; // cannot lead to a cheaper solution
+                continue;
             }
+            size_t successorHash = closed.hash(successorState); // hashed outside the lock
 
             {
                 const lock_guard<mutex> lock(closed_mutex);
-                // Check if successor is already in closed list
-                auto duplicate = closed.find(successorState);
-                if (duplicate != closed.end()) { 
-                    Node* duplicateNode = duplicate->second;
-                    if (duplicateNode->f <= successor->f) { // only > because less effort to skip if they have the same f value
-                        continue;
+                // Check if successor is already in closed list before allocating a node for it
+                NodeId duplicate = closed.find(successorState, successorHash);
+                if (duplicate != NO_NODE) { 
+                    if (nodes.hot(duplicate).f > f) { // only > because less effort to skip if they have the same f value
                         {
                             lock_guard<mutex> lock(duplicated_mutex);
                             this->duplicatedNodes++;
                         }
-                        duplicateNode->g = successor->g;
-                        // h should be the same because it's the same state
-                        duplicateNode->f = successor->f;
-                        duplicateNode->parent = successor->parent;
                         {
                             const lock_guard<mutex> lock(open_mutex);
-                            open.update(duplicateNode->handle);
+                            Hot& duplicateNode = nodes.hot(duplicate);
+                            duplicateNode.g = g;
+                            // h should be the same because it's the same state
+                            duplicateNode.f = f;
+                            nodes.cold(duplicate).parent = n;
+                            if (h == 0)
+                                offerSolution(duplicate);
+                            else if (open.contains(duplicate))
+                                open.update(duplicate);
+                            else
+                                open.push(duplicate); // reopen
                         }
+                        if (h != 0) signalOpen();
                     }
                     {
                         const lock_guard<mutex> lock(generated_mutex);
@@ -213,34 +256,43 @@ private:
                     }
                     continue; // skip this successor because it's already in closed list and it was already updated
                 } else {
-                    closed.emplace(successorState, successor);
+                    NodeId successor = nodes.emplaceLocal(localNodes, Hot{f, g}, successorState, h, n);
+                    closed.insert(successor, successorHash);
+                    if (h == 0) {
+                        offerSolution(successor);
+                        continue;
+                    }
                     {
                         const lock_guard<mutex> lock(open_mutex);
-                        successor->handle = open.push(successor);
+                        open.push(successor);
                     }
+                    signalOpen();
                 }
             }
         }
     }
 
-    static vector<State> reconstructPath(
-        Node* goal
-    ) {
+    vector<State> reconstructPath(NodeId goal) const {
         vector<State> path;
-        Node* current = goal;
-        while (current != nullptr) {
-            path.push_back(current->state);
-            current = current->parent;
+        NodeId current = goal;
+        while (current != NO_NODE) {
+            path.push_back(nodes.cold(current).state);
+            current = nodes.cold(current).parent;
         }
         reverse(path.begin(), path.end());
         return path;
     }
 
-    vector<State> finish(Node* n) {
+    vector<State> finish(NodeId n) {
+        this->recordNodeMemory(sizeof(Hot) + sizeof(Node), nodes.size());
+        this->recordTableMemory("Closed", closed);
+        this->searchStats["Open Memory"] = open.memoryBytes();
+        this->recordWaitStats("Wait", waitStats);
+        this->searchStats["Pruned Nodes"] = prunedNodes;
         this->end();
-        if(n == nullptr) {
+        if(n == NO_NODE) {
             return {};
         }
         return reconstructPath(n);
     }
-}; 
\ No newline at end of file
+};
\ No newline at end of file
@@ -1,14 +1,63 @@
 #include "sliding_puzzle.hpp"
 #include "path_finding.hpp"
+#include "jump_point.hpp"
+#include "grid_abstraction.hpp"
 #include "astar.hpp"
 #include "cafe.hpp"
 #include "kbfs.hpp"
 #include "spastar.hpp"
+#include "idastar.hpp"
+#include "parallel_idastar.hpp"
+#include "pase.hpp"
+#include "arastar.hpp"
+#include "mm.hpp"
+#include "epeastar.hpp"
+#include "bfhs.hpp"
+#include "external_astar.hpp"
+#include "smastar.hpp"
+#include "beam.hpp"
+#include "lrtastar.hpp"
+#include "lpastar.hpp"
+#include "hpastar.hpp"
 
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <random>
 
 #include <getopt.h>
 
+// Where the search threads and the search memory go
+struct Placement {
+    std::string affinity; // Default is no pinning
+    HugePages::Mode hugePages = HugePages::Mode::Off;
+    size_t prefaultBytes = 0;
+};
+
+template <typename Searcher>
+auto runSearch(Searcher& searcher, const SearchLimits& limits, const Placement& placement, double referenceCost) {
+    searcher.setAffinity(placement.affinity);
+    searcher.setMemoryBacking(placement.hugePages, placement.prefaultBytes);
+    searcher.setReferenceCost(referenceCost);
+    auto result = searcher.run(limits);
+    return result.path;
+}
+
+// Loads the grid's abstraction from file when it is there, otherwise builds it and saves it to file (if any).
+// A file that cannot be read or was saved for another grid is reported and left alone, nothing is returned.
+template <typename Grid>
+std::optional<Pathfinding::GridAbstraction> abstractGrid(const Grid& grid, size_t clusterSize, size_t threadCount, const std::string& file) {
+    try {
+        if (!file.empty() && std::ifstream(file).good()) return Pathfinding::GridAbstraction::load(file, grid, clusterSize);
+        auto abstraction = Pathfinding::GridAbstraction::build(grid, clusterSize, threadCount);
+        if (!file.empty()) abstraction.save(file);
+        return abstraction;
+    } catch (const std::runtime_error& error) {
+        std::cerr << error.what() << std::endl;
+        return std::nullopt;
+    }
+}
+
 template <typename State>
 void print_path(const std::vector<State>& path) {
     for (const auto& state : path) {
@@ -22,6 +71,26 @@ int main(int argc, char* argv[]) {
     std::string problem = "tiles"; // Default problem
     size_t extraExpansionTime = 0; // Default extra expansion time
     size_t threadCount = 1; // Default thread count
+    SearchLimits limits; // Default is unlimited
+    std::optional<double> epsilon; // Default is 1, which keeps PA*SE optimal
+    std::optional<double> weight; // Default is each algorithm's own, 1 for A* and 3 for ARA*
+    double weightStep = 0.5; // How much ARA* lowers the weight after each solution
+    std::string scratchDirectory = "/tmp"; // Where external A* keeps its buckets
+    size_t nodeBudget = size_t(1) << 20; // Most nodes SMA* keeps in memory
+    size_t width = 1000; // Nodes per layer (beam) or expansions per depth (bbfs)
+    double referenceCost = 0; // The optimal cost, when known, to rate the path against
+    size_t lookahead = 32; // Expansions per LSS-LRTA* step
+    size_t trials = 1; // LSS-LRTA* queries run one after the other with the same learned heuristic
+    size_t replans = 10; // LPA* replans, each after a change of the map
+    size_t changes = 1; // Cells that become walls before each LPA* replan
+    std::string changeMode = "on-path"; // Whether those cells are on the last path or next to it
+    size_t clusterSize = 16; // Rows and columns of an HPA* cluster
+    std::string abstractionFile; // Where the grid abstraction is loaded from or saved to, none by default
+    Placement placement;
+
+    auto usage = [&]() {
+        std::cerr << "Usage: " << argv[0] << " [-a <algorithm>] [-p <problem>] [-e <extra-expansion-time>] [-t <threads>] [-m <memory-limit>] [-x <max-expansions>] [-g <max-generated>] [-T <timeout-seconds>] [-A <compact|scatter|cpu-list>] [-H <off|thp|explicit>] [-P <prefault-bytes>] [-E <epsilon>] [-w <weight>] [-W <weight-step>] [-D <scratch-dir>] [-N <node-budget>] [-B <width>] [-R <reference-cost>] [-L <lookahead>] [-Q <trials>] [-U <replans>] [-C <changes>] [-M <on-path|off-path>] [-S <cluster-size>] [-F <abstraction-file>]" << std::endl;
+    };
 
     static struct option long_options[] =
     {
@@ -29,11 +98,32 @@ int main(int argc, char* argv[]) {
         {"problem", required_argument, 0, 'p'},
         {"extra-expansion-time", required_argument, 0, 'e'},
         {"threads", required_argument, 0, 't'},
+        {"memory-limit", required_argument, 0, 'm'},
+        {"max-expansions", required_argument, 0, 'x'},
+        {"max-generated", required_argument, 0, 'g'},
+        {"timeout", required_argument, 0, 'T'},
+        {"affinity", required_argument, 0, 'A'},
+        {"huge-pages", required_argument, 0, 'H'},
+        {"prefault", required_argument, 0, 'P'},
+        {"epsilon", required_argument, 0, 'E'},
+        {"weight", required_argument, 0, 'w'},
+        {"weight-step", required_argument, 0, 'W'},
+        {"scratch-dir", required_argument, 0, 'D'},
+        {"node-budget", required_argument, 0, 'N'},
+        {"width", required_argument, 0, 'B'},
+        {"reference-cost", required_argument, 0, 'R'},
+        {"lookahead", required_argument, 0, 'L'},
+        {"trials", required_argument, 0, 'Q'},
+        {"replans", required_argument, 0, 'U'},
+        {"changes", required_argument, 0, 'C'},
+        {"change-mode", required_argument, 0, 'M'},
+        {"cluster-size", required_argument, 0, 'S'},
+        {"abstraction-file", required_argument, 0, 'F'},
         {0, 0, 0, 0}
     };
 
     int option_index = 0;
-    while ((c = getopt_long(argc, argv, "a:p:e:t:", long_options, &option_index)) != -1) {
+    while ((c = getopt_long(argc, argv, "a:p:e:t:m:x:g:T:A:H:P:E:w:W:D:N:B:R:L:Q:U:C:M:S:F:", long_options, &option_index)) != -1) {
         switch (c) {
             case 'a':
                 algorithmChoice = optarg;
@@ -47,12 +137,113 @@ int main(int argc, char* argv[]) {
             case 't':
                 threadCount = std::stoi(optarg); // Convert string to int
                 break;
+            case 'm':
+                limits.memoryLimit = MemoryUsage::parseBytes(optarg); // e.g. 512M or 4G
+                break;
+            case 'x':
+                limits.maxExpansions = std::stoull(optarg);
+                break;
+            case 'g':
+                limits.maxGenerated = std::stoull(optarg);
+                break;
+            case 'T':
+                limits.timeout = std::stod(optarg); // seconds
+                break;
+            case 'A':
+                placement.affinity = optarg; // compact, scatter or a cpu list like 0,2,4-7
+                try {
+                    ThreadAffinity::cpuOrder(placement.affinity, {});
+                } catch (const std::exception&) {
+                    std::cerr << "-A needs compact, scatter or a cpu list like 0,2,4-7, not " << optarg << std::endl;
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'H':
+                try {
+                    placement.hugePages = HugePages::parseMode(optarg); // off, thp or explicit
+                } catch (const std::invalid_argument& error) {
+                    std::cerr << error.what() << std::endl;
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'P':
+                placement.prefaultBytes = MemoryUsage::parseBytes(optarg); // e.g. 1G of node storage
+                break;
+            case 'E':
+                epsilon = std::stod(optarg); // PA*SE suboptimality bound, at least 1
+                break;
+            case 'w':
+                weight = std::stod(optarg); // weighted A* ordering by g + w * h, at least 1
+                break;
+            case 'W':
+                weightStep = std::stod(optarg); // what ARA* takes off the weight after each solution, above 0
+                break;
+            case 'D':
+                scratchDirectory = optarg; // ideally a fast local disk
+                break;
+            case 'N':
+                nodeBudget = std::stoull(optarg);
+                break;
+            case 'B':
+                width = std::stoull(optarg);
+                break;
+            case 'R':
+                referenceCost = std::stod(optarg); // e.g. the Path Length of an A* run
+                break;
+            case 'L':
+                lookahead = std::stoull(optarg);
+                break;
+            case 'Q':
+                trials = std::stoull(optarg);
+                break;
+            case 'U':
+                replans = std::stoull(optarg);
+                break;
+            case 'C':
+                changes = std::stoull(optarg);
+                break;
+            case 'M':
+                changeMode = optarg;
+                if (changeMode != "on-path" && changeMode != "off-path") {
+                    std::cerr << "-M needs on-path or off-path, not " << optarg << std::endl;
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'S':
+                clusterSize = std::stoull(optarg);
+                if (clusterSize < 2 || clusterSize > Pathfinding::GridAbstraction::MAX_CLUSTER_SIZE) {
+                    std::cerr << "-S needs a cluster size between 2 and " << Pathfinding::GridAbstraction::MAX_CLUSTER_SIZE << std::endl;
+                    usage();
+                    return 1;
+                }
+                break;
+            case 'F':
+                abstractionFile = optarg;
+                break;
             default:
-                std::cerr << "Usage: " << argv[0] << " [-a <algorithm>] [-p <problem>] [-e <extra-expansion-time>] [-t <threads>]" << std::endl;
+                usage();
                 return 1;
         }
     }
     
+    bool weightedAlgorithm = algorithmChoice == "astar" || algorithmChoice == "cafe" || algorithmChoice == "kbfs" || algorithmChoice == "spastar" || algorithmChoice == "arastar" || algorithmChoice == "beam" || algorithmChoice == "bbfs";
+    if (weight && (!weightedAlgorithm || *weight < 1)) {
+        std::cerr << "-w needs a weight of at least 1 and one of astar, cafe, kbfs, spastar, arastar, beam or bbfs" << std::endl;
+        return 1;
+    }
+    if (weightStep <= 0) {
+        std::cerr << "-W needs a weight step above 0, or ARA* would never lower its weight" << std::endl;
+        return 1;
+    }
+    bool paseAlgorithm = algorithmChoice == "pase" || algorithmChoice == "epase" || algorithmChoice == "epase-lazy";
+    if (epsilon && (!paseAlgorithm || *epsilon < 1)) {
+        std::cerr << "-E needs an epsilon of at least 1 and one of pase, epase or epase-lazy" << std::endl;
+        return 1;
+    }
+
     // std::clog << "Algorithm: " << algorithmChoice << std::endl;
     std::clog << "Problem: " << problem << std::endl;
     // std::clog << "Extra expansion time: " << extraExpansionTime << std::endl;
@@ -63,13 +254,33 @@ int main(int argc, char* argv[]) {
             using namespace SlidingPuzzle;
             auto instance = SlidingTileInstance<State>::parseInput(std::cin);
             AStar<State> searcher(&instance, extraExpansionTime);
-            auto path = searcher.findPath();
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
             // print_path(path);
         } else if (problem == "path") {
             using namespace Pathfinding;
             auto instance = PathfindingInstance<State>::parseInput(std::cin);
             AStar<State> searcher(&instance, extraExpansionTime);
-            auto path = searcher.findPath();
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "jps" || problem == "jps+") {
+            using namespace Pathfinding;
+            auto grid = PathfindingInstance<State>::parseInput(std::cin);
+            JumpPointInstance<> instance(grid, problem == "jps+");
+            AStar<JumpState> searcher(&instance, extraExpansionTime);
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "hpa") {
+            using namespace Pathfinding;
+            auto grid = PathfindingInstance<State>::parseInput(std::cin);
+            auto abstraction = abstractGrid(grid, clusterSize, threadCount, abstractionFile);
+            if (!abstraction) return 1;
+            AbstractionHeuristicInstance<> instance(grid, *abstraction);
+            AStar<State> searcher(&instance, extraExpansionTime);
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
             // print_path(path);
         }
     } else if (algorithmChoice == "cafe") {
@@ -77,13 +288,33 @@ int main(int argc, char* argv[]) {
             using namespace SlidingPuzzle;
             auto instance = SlidingTileInstance<State>::parseInput(std::cin);
             CAFE<State> searcher(&instance, extraExpansionTime, threadCount);
-            auto path = searcher.findPath();
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
             // print_path(path);
         } else if (problem == "path") {
             using namespace Pathfinding;
             auto instance = PathfindingInstance<State>::parseInput(std::cin);
             CAFE<State> searcher(&instance, extraExpansionTime, threadCount);
-            auto path = searcher.findPath();
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "jps" || problem == "jps+") {
+            using namespace Pathfinding;
+            auto grid = PathfindingInstance<State>::parseInput(std::cin);
+            JumpPointInstance<> instance(grid, problem == "jps+");
+            CAFE<JumpState> searcher(&instance, extraExpansionTime, threadCount);
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "hpa") {
+            using namespace Pathfinding;
+            auto grid = PathfindingInstance<State>::parseInput(std::cin);
+            auto abstraction = abstractGrid(grid, clusterSize, threadCount, abstractionFile);
+            if (!abstraction) return 1;
+            AbstractionHeuristicInstance<> instance(grid, *abstraction);
+            CAFE<State> searcher(&instance, extraExpansionTime, threadCount);
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
             // print_path(path);
         }
     } else if (algorithmChoice == "kbfs") {
@@ -91,13 +322,33 @@ int main(int argc, char* argv[]) {
             using namespace SlidingPuzzle;
             auto instance = SlidingTileInstance<State>::parseInput(std::cin);
             KBFS<State> searcher(&instance, extraExpansionTime, threadCount);
-            auto path = searcher.findPath();
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
             // print_path(path);
         } else if (problem == "path") {
             using namespace Pathfinding;
             auto instance = PathfindingInstance<State>::parseInput(std::cin);
             KBFS<State> searcher(&instance, extraExpansionTime, threadCount);
-            auto path = searcher.findPath();
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "jps" || problem == "jps+") {
+            using namespace Pathfinding;
+            auto grid = PathfindingInstance<State>::parseInput(std::cin);
+            JumpPointInstance<> instance(grid, problem == "jps+");
+            KBFS<JumpState> searcher(&instance, extraExpansionTime, threadCount);
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "hpa") {
+            using namespace Pathfinding;
+            auto grid = PathfindingInstance<State>::parseInput(std::cin);
+            auto abstraction = abstractGrid(grid, clusterSize, threadCount, abstractionFile);
+            if (!abstraction) return 1;
+            AbstractionHeuristicInstance<> instance(grid, *abstraction);
+            KBFS<State> searcher(&instance, extraExpansionTime, threadCount);
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
             // print_path(path);
         }
     } else if (algorithmChoice == "spastar") {
@@ -105,14 +356,251 @@ int main(int argc, char* argv[]) {
             using namespace SlidingPuzzle;
             auto instance = SlidingTileInstance<State>::parseInput(std::cin);
             SPAStar<State> searcher(&instance, extraExpansionTime, threadCount);
-            auto path = searcher.findPath();
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
             // print_path(path);
         } else if (problem == "path") {
             using namespace Pathfinding;
             auto instance = PathfindingInstance<State>::parseInput(std::cin);
             SPAStar<State> searcher(&instance, extraExpansionTime, threadCount);
-            auto path = searcher.findPath();
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "jps" || problem == "jps+") {
+            using namespace Pathfinding;
+            auto grid = PathfindingInstance<State>::parseInput(std::cin);
+            JumpPointInstance<> instance(grid, problem == "jps+");
+            SPAStar<JumpState> searcher(&instance, extraExpansionTime, threadCount);
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "hpa") {
+            using namespace Pathfinding;
+            auto grid = PathfindingInstance<State>::parseInput(std::cin);
+            auto abstraction = abstractGrid(grid, clusterSize, threadCount, abstractionFile);
+            if (!abstraction) return 1;
+            AbstractionHeuristicInstance<> instance(grid, *abstraction);
+            SPAStar<State> searcher(&instance, extraExpansionTime, threadCount);
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        }
+    } else if (algorithmChoice == "pase" || algorithmChoice == "epase" || algorithmChoice == "epase-lazy") {
+        EdgeMode edgeMode = algorithmChoice == "pase" ? EdgeMode::Nodes : algorithmChoice == "epase" ? EdgeMode::Edges : EdgeMode::LazyEdges;
+        if (problem == "tiles") {
+            using namespace SlidingPuzzle;
+            auto instance = SlidingTileInstance<State>::parseInput(std::cin);
+            PAStarSE<State> searcher(&instance, extraExpansionTime, threadCount, epsilon.value_or(1), edgeMode);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "path") {
+            using namespace Pathfinding;
+            auto instance = PathfindingInstance<State>::parseInput(std::cin);
+            PAStarSE<State> searcher(&instance, extraExpansionTime, threadCount, epsilon.value_or(1), edgeMode);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        }
+    } else if (algorithmChoice == "arastar") {
+        if (problem == "tiles") {
+            using namespace SlidingPuzzle;
+            auto instance = SlidingTileInstance<State>::parseInput(std::cin);
+            ARAStar<State> searcher(&instance, extraExpansionTime, weightStep);
+            searcher.setWeight(weight.value_or(3));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "path") {
+            using namespace Pathfinding;
+            auto instance = PathfindingInstance<State>::parseInput(std::cin);
+            ARAStar<State> searcher(&instance, extraExpansionTime, weightStep);
+            searcher.setWeight(weight.value_or(3));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        }
+    } else if (algorithmChoice == "epeastar") {
+        if (problem == "tiles") {
+            using namespace SlidingPuzzle;
+            auto instance = SlidingTileInstance<State>::parseInput(std::cin);
+            EPEAStar<State, float, SlidingTileInstance<State>> searcher(&instance, extraExpansionTime);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "path") {
+            using namespace Pathfinding;
+            auto instance = PathfindingInstance<State>::parseInput(std::cin);
+            EPEAStar<State, float, PathfindingInstance<State>> searcher(&instance, extraExpansionTime);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        }
+    } else if (algorithmChoice == "bfhs") {
+        if (problem == "tiles") {
+            using namespace SlidingPuzzle;
+            auto instance = SlidingTileInstance<State>::parseInput(std::cin);
+            BFHS<State> searcher(&instance, extraExpansionTime);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "path") {
+            using namespace Pathfinding;
+            auto instance = PathfindingInstance<State>::parseInput(std::cin);
+            BFHS<State> searcher(&instance, extraExpansionTime, 2); // collecting a goal is a one way move
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        }
+    } else if (algorithmChoice == "external") {
+        try {
+            if (problem == "tiles") {
+                using namespace SlidingPuzzle;
+                auto instance = SlidingTileInstance<State>::parseInput(std::cin);
+                ExternalAStar<State, float, SlidingTileInstance<State>> searcher(&instance, extraExpansionTime, scratchDirectory);
+                auto path = runSearch(searcher, limits, placement, referenceCost);
+                // print_path(path);
+            } else if (problem == "path") {
+                using namespace Pathfinding;
+                auto instance = PathfindingInstance<State>::parseInput(std::cin);
+                ExternalAStar<State, float, PathfindingInstance<State>> searcher(&instance, extraExpansionTime, scratchDirectory);
+                auto path = runSearch(searcher, limits, placement, referenceCost);
+                // print_path(path);
+            }
+        } catch (const std::runtime_error& error) { // an unusable -D or a failed write, the scratch directory is already gone
+            std::cerr << error.what() << std::endl;
+            return 1;
+        }
+    } else if (algorithmChoice == "beam" || algorithmChoice == "bbfs") {
+        bool bestFirst = algorithmChoice == "bbfs";
+        if (problem == "tiles") {
+            using namespace SlidingPuzzle;
+            auto instance = SlidingTileInstance<State>::parseInput(std::cin);
+            BeamSearch<State> searcher(&instance, extraExpansionTime, width, threadCount, bestFirst);
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "path") {
+            using namespace Pathfinding;
+            auto instance = PathfindingInstance<State>::parseInput(std::cin);
+            BeamSearch<State> searcher(&instance, extraExpansionTime, width, threadCount, bestFirst);
+            searcher.setWeight(weight.value_or(1));
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        }
+    } else if (algorithmChoice == "lrtastar") {
+        if (problem == "tiles") {
+            using namespace SlidingPuzzle;
+            auto instance = SlidingTileInstance<State>::parseInput(std::cin);
+            LearnedHeuristic<State> learned([&instance](const State& state) { return instance.hash(state); });
+            LRTAStar<State> searcher(&instance, extraExpansionTime, lookahead, &learned, trials);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "path") {
+            using namespace Pathfinding;
+            auto instance = PathfindingInstance<State>::parseInput(std::cin);
+            LearnedHeuristic<State> learned([&instance](const State& state) { return instance.hash(state); });
+            LRTAStar<State> searcher(&instance, extraExpansionTime, lookahead, &learned, trials);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        }
+    } else if (algorithmChoice == "lpastar") {
+        if (problem == "path") {
+            using namespace Pathfinding;
+            auto instance = PathfindingInstance<State>::parseInput(std::cin);
+            // Before each replan the walls of the last change clear and some cells of the last path are blocked,
+            // or with off-path some open cells next to it, which leaves the path as it is
+            std::mt19937 random(0); // the same changes on every run
+            std::vector<Position> blocked;
+            auto changeMap = [&](const std::vector<State>& path) {
+                auto isGoal = [&](Position cell) { return instance.initial_state.goals.find(cell) != instance.initial_state.goals.end(); };
+                std::vector<Position> cells;
+                if (changeMode == "on-path") {
+                    for (size_t i = 1; i + 1 < path.size(); i++) {
+                        if (!isGoal(path[i].actor)) cells.push_back(path[i].actor);
+                    }
+                } else {
+                    boost::unordered_set<Position> onPath{instance.initial_state.actor}, seen;
+                    for (const auto& state : path) onPath.insert(state.actor);
+                    for (const auto& state : path) {
+                        for (auto [dr, dc] : {std::pair{-1, 0}, {1, 0}, {0, -1}, {0, 1}}) {
+                            Position next{state.actor.row + dr, state.actor.col + dc}; // wraps below 0, caught by the bounds check
+                            if (next.row >= instance.rows() || next.col >= instance.cols() || instance.isWall(next)) continue;
+                            if (!onPath.count(next) && !isGoal(next) && seen.insert(next).second) cells.push_back(next);
+                        }
+                    }
+                }
+                std::shuffle(cells.begin(), cells.end(), random);
+                cells.resize(std::min(cells.size(), changes));
+                auto changed = instance.changeWalls(cells, blocked);
+                blocked = cells;
+                return changed;
+            };
+            LPAStar<State, float, PathfindingInstance<State>> searcher(&instance, extraExpansionTime, replans, changeMap);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else {
+            std::cerr << "lpastar needs a problem with changing walls (path)" << std::endl;
+            return 1;
+        }
+    } else if (algorithmChoice == "hpastar") {
+        if (problem == "path") {
+            using namespace Pathfinding;
+            auto instance = PathfindingInstance<State>::parseInput(std::cin);
+            if (instance.initial_state.goals.size() > HPAStar<>::MAX_GOALS) {
+                std::cerr << "hpastar plans for at most " << HPAStar<>::MAX_GOALS << " goals" << std::endl;
+                return 1;
+            }
+            auto abstraction = abstractGrid(instance, clusterSize, threadCount, abstractionFile);
+            if (!abstraction) return 1;
+            HPAStar<> searcher(&instance, &*abstraction, extraExpansionTime);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else {
+            std::cerr << "hpastar needs a grid (path)" << std::endl;
+            return 1;
+        }
+    } else if (algorithmChoice == "smastar") {
+        if (problem == "tiles") {
+            using namespace SlidingPuzzle;
+            auto instance = SlidingTileInstance<State>::parseInput(std::cin);
+            SMAStar<State> searcher(&instance, extraExpansionTime, nodeBudget);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "path") {
+            using namespace Pathfinding;
+            auto instance = PathfindingInstance<State>::parseInput(std::cin);
+            SMAStar<State> searcher(&instance, extraExpansionTime, nodeBudget);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        }
+    } else if (algorithmChoice == "mm") {
+        if (problem == "tiles") {
+            using namespace SlidingPuzzle;
+            auto instance = SlidingTileInstance<State>::parseInput(std::cin);
+            MM<State, float, SlidingTileInstance<State>> searcher(&instance, extraExpansionTime, 1); // every move costs 1
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else {
+            std::cerr << "mm needs a problem with a single goal state (tiles)" << std::endl;
+            return 1;
+        }
+    } else if (algorithmChoice == "idastar") {
+        if (problem == "tiles") {
+            using namespace SlidingPuzzle;
+            auto instance = SlidingTileInstance<State>::parseInput(std::cin);
+            IDAStar<State, float, SlidingTileInstance<State>> searcher(&instance, extraExpansionTime);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        } else if (problem == "path") {
+            using namespace Pathfinding;
+            auto instance = PathfindingInstance<State>::parseInput(std::cin);
+            IDAStar<State, float, PathfindingInstance<State>> searcher(&instance, extraExpansionTime);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
+            // print_path(path);
+        }
+    } else if (algorithmChoice == "pidastar") {
+        if (problem == "tiles") {
+            using namespace SlidingPuzzle;
+            auto instance = SlidingTileInstance<State>::parseInput(std::cin);
+            ParallelIDAStar<State, float, SlidingTileInstance<State>> searcher(&instance, extraExpansionTime, threadCount);
+            auto path = runSearch(searcher, limits, placement, referenceCost);
             // print_path(path);
+        } else {
+            std::cerr << "pidastar needs a problem with in place moves (tiles)" << std::endl;
+            return 1;
         }
     }
     return 0;
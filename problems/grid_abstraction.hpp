@@ -0,0 +1,491 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <limits>
+#include <queue>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+
+#include "problem_instance.hpp"
+#include "path_finding.hpp"
+#include "work_stealing_pool.hpp"
+
+#include <boost/functional/hash.hpp>
+#include <boost/unordered/unordered_flat_map.hpp>
+
+using namespace std;
+
+namespace Pathfinding {
+    /**
+     * The HPA* abstraction of a grid (Botea, Muller and Schaeffer 2004). The grid is cut into square clusters
+     * and every maximal run of open cells facing each other across a cluster border is an entrance. Each
+     * entrance has two sides, its cells in either cluster, and one or, when wide, two transitions: pairs of
+     * facing cells that abstract paths cross the border through. Inside a cluster the abstraction stores
+     * the distance between every two of its transitions and the distance from every cell to every side,
+     * all measured without leaving the cluster.
+     *
+     * Building runs the clusters on a work stealing pool. save and load keep the result in a binary file
+     * that is only accepted for a grid with the same size, walls and cluster size. Walls changed after
+     * building are not seen.
+     */
+    class GridAbstraction {
+    public:
+        static constexpr uint16_t UNREACHABLE = numeric_limits<uint16_t>::max();
+        static constexpr size_t MAX_CLUSTER_SIZE = 128; // keeps cluster distances below UNREACHABLE
+        static constexpr size_t WIDE_ENTRANCE = 6; // entrances at least this wide get a transition at each end
+
+        struct Edge {
+            uint32_t to;
+            uint32_t cost;
+        };
+
+        // A transition cell, the first edge of every transition crosses to the facing one
+        struct Transition {
+            Position cell;
+            uint32_t cluster;
+            vector<Edge> edges;
+        };
+
+        // The cells of an entrance in one of its two clusters
+        struct Side {
+            uint32_t cluster;
+            uint32_t facing; // the side in the other cluster
+            vector<Position> cells;
+        };
+
+        struct Cluster {
+            size_t row, col, height, width; // the rectangle of cells
+            vector<uint32_t> sides; // ascending
+            vector<uint32_t> transitions; // ascending
+            vector<uint16_t> sideDistances; // the distance from each cell to each side, cell major
+        };
+
+        /**
+         * Cuts the grid into clusters of clusterSize by clusterSize cells and measures them
+         * @param threadCount the threads measuring clusters, the calling thread included
+         */
+        template<typename Grid>
+        static GridAbstraction build(const Grid& grid, size_t clusterSize, size_t threadCount) {
+            auto buildStart = chrono::high_resolution_clock::now();
+            GridAbstraction abstraction(grid, clusterSize);
+            WorkStealingPool pool(max<size_t>(threadCount, 1) - 1);
+
+            // the entrances on the right and bottom border of every cluster
+            vector<vector<pair<vector<Position>, vector<Position>>>> entrances(abstraction.clusters.size());
+            TaskGroup findEntrances;
+            for (size_t i = 0; i < abstraction.clusters.size(); i++) {
+                pool.submit(findEntrances, [&abstraction, &entrances, i](size_t) {
+                    entrances[i] = abstraction.findEntrances(i);
+                });
+            }
+            pool.wait(findEntrances);
+            for (auto& clusterEntrances : entrances) {
+                for (auto& [inside, outside] : clusterEntrances) {
+                    abstraction.addEntrance(std::move(inside), std::move(outside));
+                }
+            }
+
+            TaskGroup measure;
+            for (size_t i = 0; i < abstraction.clusters.size(); i++) {
+                pool.submit(measure, [&abstraction, i](size_t) {
+                    abstraction.measureCluster(i);
+                });
+            }
+            pool.wait(measure);
+            abstraction.buildTime = chrono::duration<double>(chrono::high_resolution_clock::now() - buildStart).count();
+            return abstraction;
+        }
+
+        /**
+         * Reads an abstraction saved for this grid
+         * @throws runtime_error when the file cannot be read or was saved for another grid or cluster size
+         */
+        template<typename Grid>
+        static GridAbstraction load(const string& path, const Grid& grid, size_t clusterSize) {
+            auto loadStart = chrono::high_resolution_clock::now();
+            ifstream in(path, ios::binary);
+            if (!in) throw runtime_error("Could not open the grid abstraction " + path);
+            GridAbstraction abstraction(grid, clusterSize);
+            char magic[sizeof(MAGIC)];
+            in.read(magic, sizeof(magic));
+            uint64_t header[4];
+            in.read(reinterpret_cast<char*>(header), sizeof(header));
+            if (!in || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0) throw runtime_error(path + " is not a grid abstraction");
+            if (header[0] != abstraction.rowCount || header[1] != abstraction.colCount || header[2] != clusterSize || header[3] != abstraction.fingerprint)
+                throw runtime_error(path + " was saved for another grid or cluster size");
+
+            uint64_t sideCount = readValue<uint64_t>(in);
+            abstraction.sides.resize(sideCount);
+            for (uint32_t id = 0; id < sideCount; id++) {
+                Side& side = abstraction.sides[id];
+                side.cluster = readValue<uint32_t>(in);
+                side.facing = readValue<uint32_t>(in);
+                side.cells.resize(readValue<uint32_t>(in));
+                for (Position& cell : side.cells) cell = readCell(in);
+                abstraction.clusters.at(side.cluster).sides.push_back(id);
+            }
+            uint64_t transitionCount = readValue<uint64_t>(in);
+            abstraction.transitions.resize(transitionCount);
+            for (uint32_t id = 0; id < transitionCount; id++) {
+                Transition& transition = abstraction.transitions[id];
+                transition.cell = readCell(in);
+                transition.cluster = readValue<uint32_t>(in);
+                transition.edges.resize(readValue<uint32_t>(in));
+                in.read(reinterpret_cast<char*>(transition.edges.data()), transition.edges.size() * sizeof(Edge));
+                abstraction.clusters.at(transition.cluster).transitions.push_back(id);
+            }
+            for (Cluster& cluster : abstraction.clusters) {
+                cluster.sideDistances.resize(cluster.height * cluster.width * cluster.sides.size());
+                in.read(reinterpret_cast<char*>(cluster.sideDistances.data()), cluster.sideDistances.size() * sizeof(uint16_t));
+            }
+            if (!in) throw runtime_error(path + " is truncated");
+            abstraction.buildTime = chrono::duration<double>(chrono::high_resolution_clock::now() - loadStart).count();
+            return abstraction;
+        }
+
+        void save(const string& path) const {
+            ofstream out(path, ios::binary | ios::trunc);
+            out.write(MAGIC, sizeof(MAGIC));
+            uint64_t header[4] = {rowCount, colCount, clusterSize, fingerprint};
+            out.write(reinterpret_cast<const char*>(header), sizeof(header));
+            writeValue<uint64_t>(out, sides.size());
+            for (const Side& side : sides) {
+                writeValue<uint32_t>(out, side.cluster);
+                writeValue<uint32_t>(out, side.facing);
+                writeValue<uint32_t>(out, side.cells.size());
+                for (const Position& cell : side.cells) writeCell(out, cell);
+            }
+            writeValue<uint64_t>(out, transitions.size());
+            for (const Transition& transition : transitions) {
+                writeCell(out, transition.cell);
+                writeValue<uint32_t>(out, transition.cluster);
+                writeValue<uint32_t>(out, transition.edges.size());
+                out.write(reinterpret_cast<const char*>(transition.edges.data()), transition.edges.size() * sizeof(Edge));
+            }
+            for (const Cluster& cluster : clusters) {
+                out.write(reinterpret_cast<const char*>(cluster.sideDistances.data()), cluster.sideDistances.size() * sizeof(uint16_t));
+            }
+            if (!out) throw runtime_error("Could not write the grid abstraction " + path);
+        }
+
+        inline uint32_t clusterOf(Position cell) const {
+            return static_cast<uint32_t>((cell.row / clusterSize) * clustersPerRow + cell.col / clusterSize);
+        }
+
+        // The index of a cell among the cells of its cluster
+        inline size_t localIndex(const Cluster& cluster, Position cell) const {
+            return (cell.row - cluster.row) * cluster.width + (cell.col - cluster.col);
+        }
+
+        // The distance from cell to the k-th side of its cluster inside the cluster, UNREACHABLE if there is none
+        inline uint16_t sideDistance(Position cell, size_t k) const {
+            const Cluster& cluster = clusters[clusterOf(cell)];
+            return cluster.sideDistances[localIndex(cluster, cell) * cluster.sides.size() + k];
+        }
+
+        inline bool isOpen(Position cell) const {
+            return open[cell.row * colCount + cell.col];
+        }
+
+        /**
+         * Breadth first search from the sources without leaving their cluster
+         * @param parents when given, the neighbor each cell was reached from (its own local index at a source)
+         * @return the distance of every cell of the cluster by local index
+         */
+        vector<uint16_t> distancesInCluster(uint32_t clusterId, const vector<Position>& sources, vector<uint32_t>* parents = nullptr) const {
+            const Cluster& cluster = clusters[clusterId];
+            vector<uint16_t> distances(cluster.height * cluster.width, UNREACHABLE);
+            if (parents) parents->assign(distances.size(), numeric_limits<uint32_t>::max());
+            vector<Position> queue;
+            queue.reserve(distances.size());
+            for (const Position& source : sources) {
+                size_t local = localIndex(cluster, source);
+                if (distances[local] == 0) continue;
+                distances[local] = 0;
+                if (parents) (*parents)[local] = static_cast<uint32_t>(local);
+                queue.push_back(source);
+            }
+            for (size_t head = 0; head < queue.size(); head++) {
+                Position cell = queue[head];
+                size_t local = localIndex(cluster, cell);
+                auto visit = [&](size_t row, size_t col) {
+                    Position next{row, col};
+                    if (!isOpen(next)) return;
+                    size_t nextLocal = localIndex(cluster, next);
+                    if (distances[nextLocal] != UNREACHABLE) return;
+                    distances[nextLocal] = distances[local] + 1;
+                    if (parents) (*parents)[nextLocal] = static_cast<uint32_t>(local);
+                    queue.push_back(next);
+                };
+                if (cell.row > cluster.row) visit(cell.row - 1, cell.col);
+                if (cell.row + 1 < cluster.row + cluster.height) visit(cell.row + 1, cell.col);
+                if (cell.col > cluster.col) visit(cell.row, cell.col - 1);
+                if (cell.col + 1 < cluster.col + cluster.width) visit(cell.row, cell.col + 1);
+            }
+            return distances;
+        }
+
+        size_t clusterSize;
+        vector<Cluster> clusters;
+        vector<Side> sides;
+        vector<Transition> transitions;
+        double buildTime = 0; // seconds spent building or loading it
+
+    private:
+        static constexpr char MAGIC[8] = {'G', 'R', 'I', 'D', 'A', 'B', 'S', '1'};
+
+        size_t rowCount, colCount, clustersPerRow;
+        vector<bool> open; // the cells that are not walls
+        uint64_t fingerprint = 0; // of the walls, so a file saved for other walls is refused
+
+        template<typename Grid>
+        GridAbstraction(const Grid& grid, size_t clusterSize)
+            : clusterSize(clusterSize), rowCount(grid.rows()), colCount(grid.cols()) {
+            if (clusterSize < 2 || clusterSize > MAX_CLUSTER_SIZE)
+                throw invalid_argument("The cluster size has to be between 2 and " + to_string(MAX_CLUSTER_SIZE));
+            open.resize(rowCount * colCount);
+            size_t seed = 0;
+            for (size_t r = 0; r < rowCount; r++) {
+                for (size_t c = 0; c < colCount; c++) {
+                    open[r * colCount + c] = !grid.isWall(Position{r, c});
+                    boost::hash_combine(seed, static_cast<bool>(open[r * colCount + c]));
+                }
+            }
+            boost::hash_combine(seed, rowCount);
+            boost::hash_combine(seed, colCount);
+            fingerprint = seed;
+            clustersPerRow = (colCount + clusterSize - 1) / clusterSize;
+            for (size_t r = 0; r < rowCount; r += clusterSize) {
+                for (size_t c = 0; c < colCount; c += clusterSize) {
+                    clusters.push_back(Cluster{r, c, min(clusterSize, rowCount - r), min(clusterSize, colCount - c), {}, {}, {}});
+                }
+            }
+        }
+
+        // The runs of open cells facing open cells across the right and bottom border of a cluster
+        vector<pair<vector<Position>, vector<Position>>> findEntrances(size_t clusterId) const {
+            const Cluster& cluster = clusters[clusterId];
+            vector<pair<vector<Position>, vector<Position>>> found;
+            auto scan = [&](size_t length, auto inside, auto outside) {
+                pair<vector<Position>, vector<Position>> run;
+                for (size_t i = 0; i <= length; i++) {
+                    bool crossing = i < length && isOpen(inside(i)) && isOpen(outside(i));
+                    if (crossing) {
+                        run.first.push_back(inside(i));
+                        run.second.push_back(outside(i));
+                    } else if (!run.first.empty()) {
+                        found.push_back(std::move(run));
+                        run = {};
+                    }
+                }
+            };
+            size_t lastRow = cluster.row + cluster.height - 1;
+            size_t lastCol = cluster.col + cluster.width - 1;
+            if (lastCol + 1 < colCount) {
+                scan(cluster.height, [&](size_t i) { return Position{cluster.row + i, lastCol}; },
+                                     [&](size_t i) { return Position{cluster.row + i, lastCol + 1}; });
+            }
+            if (lastRow + 1 < rowCount) {
+                scan(cluster.width, [&](size_t i) { return Position{lastRow, cluster.col + i}; },
+                                    [&](size_t i) { return Position{lastRow + 1, cluster.col + i}; });
+            }
+            return found;
+        }
+
+        // Adds the two sides of an entrance and its transitions, a wide one at both ends and a narrow one in the middle
+        void addEntrance(vector<Position> inside, vector<Position> outside) {
+            uint32_t insideId = static_cast<uint32_t>(sides.size());
+            uint32_t insideCluster = clusterOf(inside.front());
+            uint32_t outsideCluster = clusterOf(outside.front());
+            vector<size_t> picks = inside.size() >= WIDE_ENTRANCE ? vector<size_t>{0, inside.size() - 1} : vector<size_t>{inside.size() / 2};
+            for (size_t pick : picks) {
+                uint32_t a = static_cast<uint32_t>(transitions.size());
+                transitions.push_back(Transition{inside[pick], insideCluster, {Edge{a + 1, 1}}});
+                transitions.push_back(Transition{outside[pick], outsideCluster, {Edge{a, 1}}});
+                clusters[insideCluster].transitions.push_back(a);
+                clusters[outsideCluster].transitions.push_back(a + 1);
+            }
+            sides.push_back(Side{insideCluster, insideId + 1, std::move(inside)});
+            sides.push_back(Side{outsideCluster, insideId, std::move(outside)});
+            clusters[insideCluster].sides.push_back(insideId);
+            clusters[outsideCluster].sides.push_back(insideId + 1);
+        }
+
+        // The distances from every cell to every side and between the transitions of one cluster
+        void measureCluster(size_t clusterId) {
+            Cluster& cluster = clusters[clusterId];
+            size_t sideCount = cluster.sides.size();
+            cluster.sideDistances.assign(cluster.height * cluster.width * sideCount, UNREACHABLE);
+            for (size_t k = 0; k < sideCount; k++) {
+                vector<uint16_t> distances = distancesInCluster(static_cast<uint32_t>(clusterId), sides[cluster.sides[k]].cells);
+                for (size_t local = 0; local < distances.size(); local++) {
+                    cluster.sideDistances[local * sideCount + k] = distances[local];
+                }
+            }
+            for (uint32_t from : cluster.transitions) {
+                vector<uint16_t> distances = distancesInCluster(static_cast<uint32_t>(clusterId), {transitions[from].cell});
+                for (uint32_t to : cluster.transitions) {
+                    uint16_t distance = distances[localIndex(cluster, transitions[to].cell)];
+                    if (to != from && distance != UNREACHABLE) transitions[from].edges.push_back(Edge{to, distance});
+                }
+            }
+        }
+
+        template<typename T>
+        static T readValue(istream& in) {
+            T value{};
+            in.read(reinterpret_cast<char*>(&value), sizeof(value));
+            return value;
+        }
+
+        template<typename T>
+        static void writeValue(ostream& out, T value) {
+            out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        static Position readCell(istream& in) {
+            uint32_t row = readValue<uint32_t>(in);
+            uint32_t col = readValue<uint32_t>(in);
+            return Position{row, col};
+        }
+
+        static void writeCell(ostream& out, Position cell) {
+            writeValue<uint32_t>(out, static_cast<uint32_t>(cell.row));
+            writeValue<uint32_t>(out, static_cast<uint32_t>(cell.col));
+        }
+    };
+
+    /**
+     * The grid with a heuristic read from its abstraction, for any engine. A path from a cell to a goal in
+     * another cluster leaves the cell's cluster through one of its sides, and each stretch it spends inside a
+     * cluster, between two sides, is at least as long as the closest cells of those sides are inside it.
+     * The shortest such chain of sides (a Dijkstra per goal when constructed) plus the distance from the cell
+     * to the first side is a lower bound on the distance to the goal. It is consistent, and the larger of it
+     * and the grid's Manhattan distance is the heuristic.
+     */
+    template<typename Cost = float>
+    class AbstractionHeuristicInstance : public ProblemInstance<State, Cost> {
+    public:
+        AbstractionHeuristicInstance(const PathfindingInstance<State, Cost>& grid, const GridAbstraction& abstraction)
+            : ProblemInstance<State, Cost>(grid.initial_state), grid(grid), abstraction(abstraction) {
+            for (const auto& goal : grid.initial_state.goals) {
+                goalIndex[goal] = bounds.size();
+                bounds.push_back(boundsTo(goal));
+            }
+        }
+
+        // The functions required by ProblemInstance
+
+        inline vector<State> getSuccessors(const State& state) const override {
+            return grid.getSuccessors(state);
+        }
+
+        inline Cost heuristic(const State& state) const override {
+            Cost h = grid.heuristic(state);
+            if (state.goals.empty()) return h;
+            uint32_t closest = UNBOUNDED;
+            for (const auto& goal : state.goals) {
+                closest = min(closest, lowerBound(state.actor, bounds[goalIndex.at(goal)]));
+            }
+            if (closest == UNBOUNDED) return numeric_limits<Cost>::infinity(); // no goal can be reached
+            return max(h, static_cast<Cost>(closest));
+        }
+
+        inline Cost pairwiseHeuristic(const State& from, const State& to) const override {
+            return grid.pairwiseHeuristic(from, to);
+        }
+
+        inline Cost getCost(const State& state, const State& successor) const override {
+            return grid.getCost(state, successor);
+        }
+
+        inline size_t hash(const State& state) const override {
+            return grid.hash(state);
+        }
+
+        inline size_t maxActionCount() const override {
+            return grid.maxActionCount();
+        }
+
+    private:
+        static constexpr uint32_t UNBOUNDED = numeric_limits<uint32_t>::max();
+
+        struct GoalBounds {
+            uint32_t cluster;
+            vector<uint16_t> inCluster; // the distance to the goal from each cell of its cluster, inside it
+            vector<uint32_t> fromSide; // a lower bound on the distance from any cell of each side to the goal
+        };
+
+        const PathfindingInstance<State, Cost>& grid;
+        const GridAbstraction& abstraction;
+        vector<GoalBounds> bounds;
+        boost::unordered_flat_map<Position, size_t> goalIndex;
+
+        uint32_t lowerBound(Position cell, const GoalBounds& goal) const {
+            uint32_t clusterId = abstraction.clusterOf(cell);
+            const GridAbstraction::Cluster& cluster = abstraction.clusters[clusterId];
+            uint32_t best = UNBOUNDED;
+            if (clusterId == goal.cluster) {
+                uint16_t distance = goal.inCluster[abstraction.localIndex(cluster, cell)];
+                if (distance != GridAbstraction::UNREACHABLE) best = distance;
+            }
+            for (size_t k = 0; k < cluster.sides.size(); k++) {
+                uint16_t distance = abstraction.sideDistance(cell, k);
+                uint32_t rest = goal.fromSide[cluster.sides[k]];
+                if (distance != GridAbstraction::UNREACHABLE && rest != UNBOUNDED) best = min(best, distance + rest);
+            }
+            return best;
+        }
+
+        // Dijkstra over the sides from the goal's cluster outwards
+        GoalBounds boundsTo(Position goal) const {
+            GoalBounds result;
+            result.cluster = abstraction.clusterOf(goal);
+            result.inCluster = abstraction.distancesInCluster(result.cluster, {goal});
+            result.fromSide.assign(abstraction.sides.size(), UNBOUNDED);
+            using Entry = pair<uint32_t, uint32_t>; // bound, side
+            priority_queue<Entry, vector<Entry>, greater<Entry>> frontier;
+            const GridAbstraction::Cluster& goalCluster = abstraction.clusters[result.cluster];
+            for (size_t k = 0; k < goalCluster.sides.size(); k++) {
+                uint16_t distance = abstraction.sideDistance(goal, k);
+                if (distance == GridAbstraction::UNREACHABLE) continue;
+                result.fromSide[goalCluster.sides[k]] = distance;
+                frontier.push({distance, goalCluster.sides[k]});
+            }
+            while (!frontier.empty()) {
+                auto [bound, sideId] = frontier.top();
+                frontier.pop();
+                if (bound != result.fromSide[sideId]) continue; // stale
+                // crossing into this side from the facing one costs a move
+                uint32_t facing = abstraction.sides[sideId].facing;
+                const GridAbstraction::Cluster& cluster = abstraction.clusters[abstraction.sides[facing].cluster];
+                if (bound + 1 < result.fromSide[facing]) {
+                    result.fromSide[facing] = bound + 1;
+                    frontier.push({bound + 1, facing});
+                }
+                // then from the facing side's cluster, any side of it reaches the facing side at least this fast
+                size_t facingIndex = find(cluster.sides.begin(), cluster.sides.end(), facing) - cluster.sides.begin();
+                for (size_t k = 0; k < cluster.sides.size(); k++) {
+                    uint32_t other = cluster.sides[k];
+                    if (other == facing) continue;
+                    uint32_t across = UNBOUNDED; // the distance between the closest cells of the two sides
+                    for (const Position& cell : abstraction.sides[other].cells) {
+                        uint16_t distance = abstraction.sideDistance(cell, facingIndex);
+                        if (distance != GridAbstraction::UNREACHABLE) across = min<uint32_t>(across, distance);
+                    }
+                    if (across == UNBOUNDED) continue;
+                    uint32_t candidate = bound + 1 + across;
+                    if (candidate < result.fromSide[other]) {
+                        result.fromSide[other] = candidate;
+                        frontier.push({candidate, other});
+                    }
+                }
+            }
+            return result;
+        }
+    };
+}
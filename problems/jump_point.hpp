@@ -0,0 +1,239 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+#include "problem_instance.hpp"
+#include "path_finding.hpp"
+
+#include <boost/functional/hash.hpp>
+
+using namespace std;
+
+namespace Pathfinding {
+    // The directions a jump point can be reached from, ALL_DIRECTIONS for the start and collected goals
+    enum Direction : uint8_t { UP, DOWN, LEFT, RIGHT, ALL_DIRECTIONS };
+
+    struct JumpState {
+        State state; // the grid state at the jump point
+        Direction direction = ALL_DIRECTIONS; // how the jump reached it, which decides where it can jump on to
+
+        bool operator==(const JumpState& other) const {
+            return direction == other.direction && state == other.state;
+        }
+    };
+
+    inline std::ostream& operator << (std::ostream& os, const JumpState& s){
+        os << s.state;
+        return os;
+    }
+
+    /**
+     * Jump point search (Harabor and Grastien 2011) for the 4-connected grid, as a problem the engines search
+     * instead of the PathfindingInstance it wraps. Of the many equally short paths through open space only
+     * the canonical ones are kept: they move vertically first and turn from horizontal to vertical only at a
+     * forced cell, one where the cell diagonally behind on the side it turns to is a wall. Moving vertically,
+     * every cell is scanned horizontally both ways. The successors of a state are the jump points where a
+     * canonical path can turn: forced cells, cells whose horizontal scans reach one, and goals left to collect.
+     * A jump costs its length, so paths keep the cost of the grid's.
+     *
+     * With precompute (JPS+, Harabor and Grastien 2012) the distance to the next jump point or wall in every
+     * direction is stored per cell and a jump is a table lookup, goals are checked against it at search time.
+     * Both read the walls when constructed, later changes to the grid are not seen.
+     */
+    template<typename Cost = float>
+    class JumpPointInstance : public ProblemInstance<JumpState, Cost> {
+    public:
+        JumpPointInstance(const PathfindingInstance<State, Cost>& grid, bool precompute)
+            : ProblemInstance<JumpState, Cost>(JumpState{grid.initial_state, ALL_DIRECTIONS}), grid(grid),
+            rowCount(static_cast<int>(grid.rows())), colCount(static_cast<int>(grid.cols())), precompute(precompute) {
+            open.resize(grid.rows() * grid.cols());
+            goalCell.resize(grid.rows() * grid.cols());
+            for (int r = 0; r < rowCount; r++) {
+                for (int c = 0; c < colCount; c++) {
+                    open[index(r, c)] = !grid.isWall(Position{size_t(r), size_t(c)});
+                }
+            }
+            for (const auto& goal : grid.initial_state.goals) {
+                goalCell[index(goal.row, goal.col)] = true;
+            }
+            if (precompute) buildTables();
+        }
+
+        // The functions required by ProblemInstance
+
+        inline vector<JumpState> getSuccessors(const JumpState& jumpState) const override {
+            vector<JumpState> successors;
+            const State& state = jumpState.state;
+            int r = static_cast<int>(state.actor.row);
+            int c = static_cast<int>(state.actor.col);
+            auto jumpFrom = [&](Direction direction) {
+                int distance = jump(state, r, c, direction);
+                if (distance == 0) return;
+                Position target{size_t(r + ROW_STEP[direction] * distance), size_t(c + COL_STEP[direction] * distance)};
+                JumpState successor{state, direction};
+                if (state.goals.find(target) != state.goals.end()) successor.direction = ALL_DIRECTIONS; // a fresh start
+                applyMove(successor.state, target);
+                successors.push_back(std::move(successor));
+            };
+            switch (jumpState.direction) {
+                case ALL_DIRECTIONS:
+                    for (Direction direction : {UP, DOWN, LEFT, RIGHT}) jumpFrom(direction);
+                    break;
+                case UP:
+                case DOWN:
+                    jumpFrom(jumpState.direction);
+                    jumpFrom(LEFT);
+                    jumpFrom(RIGHT);
+                    break;
+                case LEFT:
+                case RIGHT: {
+                    int dc = COL_STEP[jumpState.direction];
+                    jumpFrom(jumpState.direction);
+                    if (isOpen(r - 1, c) && !isOpen(r - 1, c - dc)) jumpFrom(UP);
+                    if (isOpen(r + 1, c) && !isOpen(r + 1, c - dc)) jumpFrom(DOWN);
+                    break;
+                }
+            }
+            return successors;
+        }
+
+        inline Cost heuristic(const JumpState& state) const override {
+            return grid.heuristic(state.state);
+        }
+
+        inline Cost getCost(const JumpState& state, const JumpState& successor) const override {
+            const Position& from = state.state.actor;
+            const Position& to = successor.state.actor;
+            return std::abs((int)from.row - (int)to.row) + std::abs((int)from.col - (int)to.col); // a jump is a straight line
+        }
+
+        inline size_t hash(const JumpState& state) const override {
+            size_t seed = grid.hash(state.state);
+            boost::hash_combine(seed, static_cast<uint8_t>(state.direction));
+            return seed;
+        }
+
+        inline size_t maxActionCount() const override {
+            return 4;
+        }
+
+    private:
+        static constexpr array<int, 4> ROW_STEP = {-1, 1, 0, 0};
+        static constexpr array<int, 4> COL_STEP = {0, 0, -1, 1};
+
+        const PathfindingInstance<State, Cost>& grid;
+        int rowCount, colCount;
+        bool precompute;
+        vector<bool> open; // the cells that are not walls
+        vector<bool> goalCell; // the initial goals, so only those cells look into a state's goals
+        // JPS+: per direction and cell, the steps to the next jump point, or minus the open cells before a wall
+        array<vector<int32_t>, 4> distances;
+
+        inline size_t index(int r, int c) const {
+            return static_cast<size_t>(r) * colCount + c;
+        }
+
+        inline bool isOpen(int r, int c) const {
+            return r >= 0 && c >= 0 && r < rowCount && c < colCount && open[index(r, c)];
+        }
+
+        inline bool isGoal(const State& state, int r, int c) const {
+            return goalCell[index(r, c)] && state.goals.find(Position{size_t(r), size_t(c)}) != state.goals.end();
+        }
+
+        // Moving horizontally by dc into (r, c), a canonical path can turn up or down here
+        inline bool forced(int r, int c, int dc) const {
+            return (isOpen(r - 1, c) && !isOpen(r - 1, c - dc)) || (isOpen(r + 1, c) && !isOpen(r + 1, c - dc));
+        }
+
+        // @return the steps from (r, c) to the next jump point in direction, 0 when a wall comes first
+        int jump(const State& state, int r, int c, Direction direction) const {
+            if (precompute) return jumpByTable(state, r, c, direction);
+            return direction == LEFT || direction == RIGHT ? scanHorizontal(state, r, c, COL_STEP[direction])
+                                                           : scanVertical(state, r, c, ROW_STEP[direction]);
+        }
+
+        int scanHorizontal(const State& state, int r, int c, int dc) const {
+            for (int k = 1;; k++) {
+                int col = c + k * dc;
+                if (!isOpen(r, col)) return 0;
+                if (isGoal(state, r, col) || forced(r, col, dc)) return k;
+            }
+        }
+
+        int scanVertical(const State& state, int r, int c, int dr) const {
+            for (int k = 1;; k++) {
+                int row = r + k * dr;
+                if (!isOpen(row, c)) return 0;
+                if (isGoal(state, row, c) || scanHorizontal(state, row, c, -1) || scanHorizontal(state, row, c, 1)) return k;
+            }
+        }
+
+        /**
+         * The table ignores goals, so the jump also stops at a goal left to collect on its way or, moving
+         * vertically, at the row of one a horizontal scan from there would reach
+         */
+        int jumpByTable(const State& state, int r, int c, Direction direction) const {
+            int32_t stored = distances[direction][index(r, c)];
+            int reach = stored > 0 ? stored : -stored; // the cells the jump could pass
+            int best = stored > 0 ? stored : 0;
+            bool vertical = direction == UP || direction == DOWN;
+            for (const auto& goal : state.goals) {
+                int goalRow = static_cast<int>(goal.row);
+                int goalCol = static_cast<int>(goal.col);
+                int k; // steps along the jump to the goal's row or column
+                if (vertical) {
+                    k = (goalRow - r) * ROW_STEP[direction];
+                    if (k < 1 || k > reach) continue;
+                    int across = goalCol - c;
+                    if (across != 0) {
+                        Direction side = across < 0 ? LEFT : RIGHT;
+                        int32_t sideways = distances[side][index(goalRow, c)];
+                        if (sideways > 0 || -sideways < std::abs(across)) continue; // a wall or jump point comes first
+                    }
+                } else {
+                    if (goalRow != r) continue;
+                    k = (goalCol - c) * COL_STEP[direction];
+                    if (k < 1 || k > reach) continue;
+                }
+                if (best == 0 || k < best) best = k;
+            }
+            return best;
+        }
+
+        void buildTables() {
+            for (auto& table : distances) table.assign(open.size(), 0);
+            // Horizontal jumps, sweeping against the direction so each cell extends its neighbor's entry
+            for (Direction direction : {LEFT, RIGHT}) {
+                int dc = COL_STEP[direction];
+                for (int r = 0; r < rowCount; r++) {
+                    for (int i = 0; i < colCount; i++) {
+                        int c = dc < 0 ? i : colCount - 1 - i;
+                        int next = c + dc;
+                        if (!isOpen(r, c) || !isOpen(r, next)) continue; // 0, a wall right away
+                        int32_t after = distances[direction][index(r, next)];
+                        if (forced(r, next, dc)) distances[direction][index(r, c)] = 1;
+                        else distances[direction][index(r, c)] = after > 0 ? after + 1 : after - 1;
+                    }
+                }
+            }
+            // Vertical jumps stop where a horizontal jump finds a jump point
+            for (Direction direction : {UP, DOWN}) {
+                int dr = ROW_STEP[direction];
+                for (int i = 0; i < rowCount; i++) {
+                    int r = dr < 0 ? i : rowCount - 1 - i;
+                    int next = r + dr;
+                    for (int c = 0; c < colCount; c++) {
+                        if (!isOpen(r, c) || !isOpen(next, c)) continue;
+                        int32_t after = distances[direction][index(next, c)];
+                        if (distances[LEFT][index(next, c)] > 0 || distances[RIGHT][index(next, c)] > 0) distances[direction][index(r, c)] = 1;
+                        else distances[direction][index(r, c)] = after > 0 ? after + 1 : after - 1;
+                    }
+                }
+            }
+        }
+    };
+}
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <sstream>
 #include <iostream>
+#include <cstring>
 
 #include "search.hpp"
 #include "problem_instance.hpp"
@@ -62,6 +63,10 @@ namespace Pathfinding {
             this->dimr = rows;
             this->dimc = cols;
             this->walls = walls;
+            for (const auto& goal : initial_state.goals) {
+                goalIndex[goal] = goalList.size();
+                goalList.push_back(goal);
+            }
         }
 
         /**
@@ -127,6 +132,15 @@ namespace Pathfinding {
             return minDist;
         }
 
+        // Manhattan distance between the actors, goals are only ever collected so to must have a subset of them
+        inline float pairwiseHeuristic(const State& from, const State& to) const override {
+            if (to.goals.size() > from.goals.size()) return std::numeric_limits<float>::infinity();
+            for (const auto& goal : to.goals) {
+                if (from.goals.find(goal) == from.goals.end()) return std::numeric_limits<float>::infinity();
+            }
+            return std::abs((int)from.actor.row - (int)to.actor.row) + std::abs((int)from.actor.col - (int)to.actor.col);
+        }
+
         inline vector<State> getSuccessors(const State& state) const override {
             vector<State> successors;
             for (const auto& move : this->getValidMoves(state)) {
@@ -153,9 +167,110 @@ namespace Pathfinding {
             return 4;
         }
 
+        inline size_t rows() const { return dimr; }
+        inline size_t cols() const { return dimc; }
+
+        inline bool isWall(Position cell) const {
+            return walls.find(cell) != walls.end();
+        }
+
+        // The partial expansion interface (PartialExpansionProblem), a move is the position the actor moves to
+
+        using Move = Position;
+        static constexpr size_t MAX_MOVES = 4;
+
+        inline size_t getMoves(const State& state, Move* moves) const {
+            size_t count = 0;
+            for (const auto& move : getValidMoves(state)) {
+                moves[count++] = move;
+            }
+            return count;
+        }
+
+        // 1 for the move plus the change of the closest goal distance, without copying the goals
+        inline Cost moveDeltaF(const State& state, Move move, Cost h) const {
+            float closest = state.goals.empty() ? 0.0f : std::numeric_limits<float>::max();
+            for (const auto& goal : state.goals) {
+                if (goal == move) {
+                    if (state.goals.size() == 1) closest = 0; // the last goal gets collected
+                    continue;
+                }
+                float dist = std::abs((int)goal.row - (int)move.row) + std::abs((int)goal.col - (int)move.col);
+                closest = std::min(closest, dist);
+            }
+            return 1 + closest - h;
+        }
+
+        inline State successor(const State& state, Move move) const {
+            State next = state;
+            applyMove(next, move);
+            return next;
+        }
+
+        // The serialization interface (SerializableProblem), the actor and a bit per initial goal
+
+        inline size_t packedBytes() const {
+            return 2 * sizeof(uint32_t) + (goalList.size() + 7) / 8;
+        }
+
+        inline void pack(const State& state, unsigned char* out) const {
+            uint32_t actor[2] = {static_cast<uint32_t>(state.actor.row), static_cast<uint32_t>(state.actor.col)};
+            std::memcpy(out, actor, sizeof(actor));
+            unsigned char* bits = out + sizeof(actor);
+            std::fill(bits, out + packedBytes(), 0);
+            for (const auto& goal : state.goals) {
+                size_t i = goalIndex.at(goal);
+                bits[i / 8] |= static_cast<unsigned char>(1 << (i % 8));
+            }
+        }
+
+        inline State unpack(const unsigned char* in) const {
+            State state;
+            uint32_t actor[2];
+            std::memcpy(actor, in, sizeof(actor));
+            state.actor = {actor[0], actor[1]};
+            const unsigned char* bits = in + sizeof(actor);
+            for (size_t i = 0; i < goalList.size(); i++) {
+                if (bits[i / 8] & (1 << (i % 8))) state.goals.insert(goalList[i]);
+            }
+            return state;
+        }
+
+        // The mutable interface (MutableProblem), a state stands on the cell of its actor
+
+        using Cell = Position;
+
+        inline Cell cellOf(const State& state) const {
+            return state.actor;
+        }
+
+        /**
+         * Adds and removes walls, e.g. the cells a robot found blocked or clear again
+         * @return the cells whose states have different successors now, each changed cell and its neighbors
+         */
+        vector<Cell> changeWalls(const vector<Position>& added, const vector<Position>& removed) {
+            vector<Cell> changed;
+            auto touch = [&](Position cell) {
+                changed.push_back(cell);
+                if (cell.row > 0) changed.push_back({cell.row - 1, cell.col});
+                if (cell.row + 1 < dimr) changed.push_back({cell.row + 1, cell.col});
+                if (cell.col > 0) changed.push_back({cell.row, cell.col - 1});
+                if (cell.col + 1 < dimc) changed.push_back({cell.row, cell.col + 1});
+            };
+            for (const auto& cell : added) {
+                if (walls.insert(cell).second) touch(cell);
+            }
+            for (const auto& cell : removed) {
+                if (walls.erase(cell) > 0) touch(cell);
+            }
+            return changed;
+        }
+
     private:
         size_t dimr = 0; // Number of rows in the grid
         size_t dimc = 0; // Number of columns in the grid
         boost::unordered_set<Position> walls; // Set of wall positions
+        vector<Position> goalList; // the initial goals, in the order of their packed bits
+        unordered_flat_map<Position, size_t> goalIndex;
     };
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 #include <vector>
 #include <functional>
 #include <iostream>
+#include <concepts>
 
 template<typename State, typename Cost = float>
 class ProblemInstance {
@@ -26,6 +27,20 @@ public:
      */
     virtual Cost heuristic(const State& state) const = 0;
 
+    /**
+     * A lower bound on the cost of any path from one state to another, used by searches that check
+     * whether two nodes can affect each other (PA*SE). It must be consistent: h(a, c) <= cost(a, b) + h(b, c).
+     * The default of 0 is always safe but makes every pair of nodes look dependent.
+     * @param from The state the path starts in
+     * @param to The state the path ends in
+     * @return The lower bound, infinity when to cannot be reached from from
+     */
+    virtual Cost pairwiseHeuristic(const State& from, const State& to) const {
+        (void)from;
+        (void)to;
+        return 0;
+    }
+
     /**
      * Get the cost of transitioning from one state to another
      * @param state The current state
@@ -47,4 +62,71 @@ public:
      * @return The maximum number of actions that can be taken from a state
      */
     virtual size_t maxActionCount() const = 0;
-}; 
\ No newline at end of file
+};
+
+/**
+ * Optional interface for problems whose states can be changed in place, used by depth first searches
+ * (IDA*) that never copy a State. Moves must be invertible: applying inverseMove(state, move) right after
+ * move restores the state, which also lets a search skip the move leading straight back to the parent.
+ *
+ * getMoves writes at most MAX_MOVES moves and returns how many it wrote.
+ * applyInPlace applies the move and returns the heuristic of the new state given h of the old one.
+ * moveCost is the cost of applying move to state.
+ */
+template<typename Instance, typename State, typename Cost>
+concept InPlaceProblem = requires(const Instance& instance, State& state, typename Instance::Move move,
+                                  typename Instance::Move* moves, Cost h) {
+    { Instance::MAX_MOVES } -> std::convertible_to<size_t>;
+    { instance.getMoves(state, moves) } -> std::convertible_to<size_t>;
+    { instance.inverseMove(state, move) } -> std::same_as<typename Instance::Move>;
+    { instance.applyInPlace(state, move, h) } -> std::convertible_to<Cost>;
+    { instance.moveCost(state, move) } -> std::convertible_to<Cost>;
+    { move == move } -> std::convertible_to<bool>;
+};
+
+/**
+ * Optional interface for problems with a single goal state, used by bidirectional searches (MM) that
+ * also search backwards from the goal, with pairwiseHeuristic(state, initial_state) as the heuristic.
+ */
+template<typename Instance, typename State>
+concept KnownGoalProblem = requires(const Instance& instance) {
+    { instance.goalState() } -> std::convertible_to<const State&>;
+};
+
+/**
+ * Optional interface for partial expansion (EPEA*). Besides listing its moves like InPlaceProblem, a
+ * problem tells how much each move changes f without generating the successor: moveDeltaF(state, move, h)
+ * is the cost of the move plus h(successor) - h, h being the heuristic of state. successor(state, move)
+ * then generates only the successors that are needed.
+ */
+template<typename Instance, typename State, typename Cost>
+concept PartialExpansionProblem = requires(const Instance& instance, const State& state, typename Instance::Move move,
+                                           typename Instance::Move* moves, Cost h) {
+    { Instance::MAX_MOVES } -> std::convertible_to<size_t>;
+    { instance.getMoves(state, moves) } -> std::convertible_to<size_t>;
+    { instance.moveDeltaF(state, move, h) } -> std::convertible_to<Cost>;
+    { instance.successor(state, move) } -> std::convertible_to<State>;
+};
+
+/**
+ * Optional interface for problems whose states can be written to disk, used by external memory searches.
+ * pack writes packedBytes() bytes and unpack reads them back. Equal states must pack to equal bytes, so
+ * duplicates can be found by comparing the bytes.
+ */
+template<typename Instance, typename State>
+concept SerializableProblem = requires(const Instance& instance, const State& state, unsigned char* out, const unsigned char* in) {
+    { instance.packedBytes() } -> std::convertible_to<size_t>;
+    instance.pack(state, out);
+    { instance.unpack(in) } -> std::convertible_to<State>;
+};
+
+/**
+ * Optional interface for problems that change between queries, used by incremental searches (LPA*). Every
+ * state stands on a cell of type Cell (hashable with boost::hash). Whatever changes the problem reports the
+ * cells whose states now have different successors, so a search only regenerates the nodes on them.
+ */
+template<typename Instance, typename State>
+concept MutableProblem = requires(const Instance& instance, const State& state) {
+    typename Instance::Cell;
+    { instance.cellOf(state) } -> std::convertible_to<typename Instance::Cell>;
+};
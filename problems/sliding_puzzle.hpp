@@ -7,6 +7,8 @@
 
 #include "search.hpp"
 #include <cmath>
+#include <array>
+#include <cstdint>
 
 using namespace std;
 
@@ -65,6 +67,28 @@ namespace SlidingPuzzle {
     public:
         SlidingTileInstance(const State& initial, const State& goal) : ProblemInstance<State, Cost>(initial), goal(goal) {
             this->goal = goal;
+
+            // manhattan[tile][i] is the distance from position i to the goal position of the tile
+            std::array<int, SIZE * SIZE> goalIndexLookup{};
+            for (int i = 0; i < SIZE * SIZE; i++) {
+                goalIndexLookup[goal.board[i]] = i;
+            }
+            for (int tile = 0; tile < SIZE * SIZE; tile++) {
+                int goalIndex = goalIndexLookup[tile];
+                for (int i = 0; i < SIZE * SIZE; i++) {
+                    manhattan[tile][i] = tile == EMPTY_TILE ? 0 : abs(goalIndex / SIZE - i / SIZE) + abs(goalIndex % SIZE - i % SIZE);
+                }
+            }
+
+            // the positions the empty tile can move to from each position
+            for (int i = 0; i < SIZE * SIZE; i++) {
+                uint8_t count = 0;
+                if (i >= SIZE) neighbors[i][count++] = i - SIZE;
+                if (i % SIZE > 0) neighbors[i][count++] = i - 1;
+                if (i % SIZE < SIZE - 1) neighbors[i][count++] = i + 1;
+                if (i < SIZE * (SIZE - 1)) neighbors[i][count++] = i + SIZE;
+                neighborCount[i] = count;
+            }
         }
 
         static SlidingTileInstance parseInput(std::istream& input) {
@@ -122,19 +146,25 @@ namespace SlidingPuzzle {
         // The functions required by ProblemInstance
 
         float heuristic(const State& state) const override {
-            int goalIndexLookup[SIZE * SIZE];
-            for (int i = 0; i <= SIZE * SIZE; i++) {
-                goalIndexLookup[goal.board[i]] = i;
+            int distance = 0;
+            for (int i = 0; i < SIZE * SIZE; i++) {
+                distance += manhattan[state.board[i]][i];
             }
+            return distance;
+        }
 
+        // Sum over the tiles of the Manhattan distance between their positions in the two states
+        float pairwiseHeuristic(const State& from, const State& to) const override {
+            std::array<int, SIZE * SIZE> positionIn{};
+            for (int i = 0; i < SIZE * SIZE; i++) {
+                positionIn[to.board[i]] = i;
+            }
             int distance = 0;
             for (int i = 0; i < SIZE * SIZE; i++) {
-                int currentTile = state.board[i];
-                if (currentTile == EMPTY_TILE) {
-                    continue;
-                }
-                int goalIndex = goalIndexLookup[currentTile];
-                distance += abs(goalIndex / SIZE - i / SIZE) + abs(goalIndex % SIZE - i % SIZE);
+                int tile = from.board[i];
+                if (tile == EMPTY_TILE) continue;
+                int j = positionIn[tile];
+                distance += abs(i / SIZE - j / SIZE) + abs(i % SIZE - j % SIZE);
             }
             return distance;
         }
@@ -164,7 +194,82 @@ namespace SlidingPuzzle {
             return 4;
         }
 
+        // The in place interface (InPlaceProblem), a move is the position the empty tile moves to
+
+        using Move = position;
+        static constexpr size_t MAX_MOVES = 4;
+
+        inline size_t getMoves(const State& state, Move* moves) const {
+            for (uint8_t i = 0; i < neighborCount[state.empty]; i++) {
+                moves[i] = neighbors[state.empty][i];
+            }
+            return neighborCount[state.empty];
+        }
+
+        inline Move inverseMove(const State& state, Move) const {
+            return state.empty; // moving the empty tile back to where it was
+        }
+
+        // Slides the tile at move into the empty position, only that tile's distance changes
+        inline Cost applyInPlace(State& state, Move move, Cost h) const {
+            int tile = state.board[move];
+            h += manhattan[tile][state.empty] - manhattan[tile][move];
+            state.board[state.empty] = tile;
+            state.board[move] = EMPTY_TILE;
+            state.empty = move;
+            return h;
+        }
+
+        inline Cost moveCost(const State&, Move) const {
+            return 1;
+        }
+
+        // The partial expansion interface (PartialExpansionProblem), the moves are the in place ones
+
+        // 1 for the move plus the change of the sliding tile's distance, from the Manhattan table
+        inline Cost moveDeltaF(const State& state, Move move, Cost) const {
+            int tile = state.board[move];
+            return 1 + manhattan[tile][state.empty] - manhattan[tile][move];
+        }
+
+        inline State successor(const State& state, Move move) const {
+            State next = state;
+            applyMove(next, move);
+            return next;
+        }
+
+        // The serialization interface (SerializableProblem), a nibble per tile
+
+        inline size_t packedBytes() const {
+            return SIZE * SIZE / 2;
+        }
+
+        inline void pack(const State& state, unsigned char* out) const {
+            for (int i = 0; i < SIZE * SIZE; i += 2) {
+                out[i / 2] = static_cast<unsigned char>(state.board[i] << 4 | state.board[i + 1]);
+            }
+        }
+
+        inline State unpack(const unsigned char* in) const {
+            State state;
+            state.board.resize(SIZE * SIZE);
+            for (int i = 0; i < SIZE * SIZE; i++) {
+                state.board[i] = i % 2 == 0 ? in[i / 2] >> 4 : in[i / 2] & 0xF;
+                if (state.board[i] == EMPTY_TILE) state.empty = i;
+            }
+            return state;
+        }
+
+        // The known goal interface (KnownGoalProblem)
+
+        inline const State& goalState() const {
+            return goal;
+        }
+
     private:
         State goal;
+        std::array<std::array<int, SIZE * SIZE>, SIZE * SIZE> manhattan{};
+        std::array<std::array<position, MAX_MOVES>, SIZE * SIZE> neighbors{};
+        std::array<uint8_t, SIZE * SIZE> neighborCount{};
     };
 }
\ No newline at end of file
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "async_file_writer.hpp"
+
+using namespace std;
+
+string scratchFile(const string& name) {
+    static string directory = [] {
+        char pattern[] = "/tmp/async-file-writer-XXXXXX";
+        return string(mkdtemp(pattern));
+    }();
+    return directory + "/" + name;
+}
+
+vector<unsigned char> bytes(size_t count, unsigned char value) {
+    return vector<unsigned char>(count, value);
+}
+
+// Appends to one file land in the order they were queued
+bool testAppendsInOrder() {
+    string path = scratchFile("append");
+    AsyncFileWriter writer;
+    for (unsigned char i = 0; i < 100; i++) {
+        writer.append(path, bytes(1000, i));
+    }
+    writer.drain();
+    vector<unsigned char> data = AsyncFileWriter::readFile(path);
+    bool ok = data.size() == 100 * 1000;
+    for (size_t i = 0; ok && i < data.size(); i++) {
+        ok = data[i] == i / 1000;
+    }
+    if (!ok || writer.bytesWritten() != 100 * 1000) {
+        cout << "Error: The appended file does not hold the buffers in order.\n";
+        return false;
+    }
+    return true;
+}
+
+bool testReplaceTruncates() {
+    string path = scratchFile("replace");
+    AsyncFileWriter writer;
+    writer.append(path, bytes(5000, 1));
+    writer.replace(path, bytes(10, 2));
+    writer.append(path, bytes(10, 3));
+    writer.drain();
+    vector<unsigned char> data = AsyncFileWriter::readFile(path);
+    if (data.size() != 20 || data[0] != 2 || data[19] != 3) {
+        cout << "Error: Replace did not drop the earlier contents.\n";
+        return false;
+    }
+    return true;
+}
+
+// A tiny queue limit makes every append wait for the writer, nothing is lost
+bool testBoundedQueue() {
+    string path = scratchFile("bounded");
+    {
+        AsyncFileWriter writer(100);
+        for (int i = 0; i < 1000; i++) {
+            writer.append(path, bytes(64, 7));
+        }
+    } // the destructor writes what is left
+    if (AsyncFileWriter::readFile(path).size() != 1000 * 64) {
+        cout << "Error: A bounded queue lost writes.\n";
+        return false;
+    }
+    return true;
+}
+
+bool testFailedWriteThrows() {
+    AsyncFileWriter writer;
+    writer.append("/nonexistent-directory/file", bytes(10, 0));
+    try {
+        writer.drain();
+    } catch (const runtime_error&) {
+        return true;
+    }
+    cout << "Error: A write to a missing directory did not throw.\n";
+    return false;
+}
+
+bool testReadMissingFile() {
+    if (!AsyncFileWriter::readFile(scratchFile("missing")).empty()) {
+        cout << "Error: A missing file should read as empty.\n";
+        return false;
+    }
+    return true;
+}
+
+template <typename Func>
+bool runTest(const string& testName, Func testFunc) {
+    bool result = testFunc();
+    cout << (result ? "[PASS] " : "[FAIL] ") << testName << endl;
+    return result;
+}
+
+int main() {
+    size_t passed = 0, failed = 0;
+    auto count = [&](bool result) { result ? passed++ : failed++; };
+
+    count(runTest("testAppendsInOrder", testAppendsInOrder));
+    count(runTest("testReplaceTruncates", testReplaceTruncates));
+    count(runTest("testBoundedQueue", testBoundedQueue));
+    count(runTest("testFailedWriteThrows", testFailedWriteThrows));
+    count(runTest("testReadMissingFile", testReadMissingFile));
+
+    for (const char* name : {"append", "replace", "bounded"}) {
+        remove(scratchFile(name).c_str());
+    }
+    rmdir(scratchFile("").c_str());
+
+    cout << "\n=== TESTING COMPLETE ===" << endl;
+    cout << "Passed: " << passed << endl;
+    cout << "Failed: " << failed << endl;
+    return failed == 0 ? 0 : 1;
+}
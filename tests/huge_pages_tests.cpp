@@ -0,0 +1,118 @@
+#include <iostream>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include "huge_pages.hpp"
+#include "node_arena.hpp"
+
+using namespace std;
+
+size_t countedBytes() {
+    HugePages::Counters& c = HugePages::counters();
+    return c.explicitBytes + c.transparentBytes + c.smallBytes;
+}
+
+bool testSmallAllocationsUseOperatorNew() {
+    HugePages::setMode(HugePages::Mode::Transparent);
+    size_t before = HugePages::counters().smallBytes;
+    void* memory = HugePages::allocate(1000);
+    bool aligned = reinterpret_cast<uintptr_t>(memory) % HugePages::SMALL_ALIGNMENT == 0;
+    HugePages::deallocate(memory, 1000);
+    if (!aligned || HugePages::counters().smallBytes != before + 1000) {
+        cout << "Error: A 1000 byte allocation was not a small aligned allocation.\n";
+        return false;
+    }
+    return true;
+}
+
+// Large allocations are rounded up to whole, aligned huge pages whatever backing they end up with
+bool testLargeAllocationsAreHugePageAligned() {
+    for (auto mode : {HugePages::Mode::Off, HugePages::Mode::Transparent, HugePages::Mode::Explicit}) {
+        HugePages::setMode(mode);
+        size_t before = countedBytes();
+        size_t bytes = 3 * (size_t(1) << 20);
+        char* memory = static_cast<char*>(HugePages::allocate(bytes));
+        memory[0] = 1;
+        memory[bytes - 1] = 1;
+        bool aligned = reinterpret_cast<uintptr_t>(memory) % HugePages::HUGE_PAGE_SIZE == 0;
+        HugePages::deallocate(memory, bytes);
+        if (!aligned || countedBytes() != before + 2 * HugePages::HUGE_PAGE_SIZE) {
+            cout << "Error: The " << HugePages::toString(mode) << " allocation was not two aligned huge pages.\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Without a reserved pool explicit pages fall back, either way the memory is usable
+bool testExplicitFallsBack() {
+    HugePages::setMode(HugePages::Mode::Explicit);
+    size_t explicitBefore = HugePages::counters().explicitBytes;
+    size_t fallbacksBefore = HugePages::counters().fallbacks;
+    void* memory = HugePages::allocate(HugePages::HUGE_PAGE_SIZE);
+    bool gotExplicit = HugePages::counters().explicitBytes > explicitBefore;
+    bool fellBack = HugePages::counters().fallbacks > fallbacksBefore;
+    HugePages::deallocate(memory, HugePages::HUGE_PAGE_SIZE);
+    if (gotExplicit == fellBack) {
+        cout << "Error: An explicit allocation should either get explicit pages or fall back.\n";
+        return false;
+    }
+    return true;
+}
+
+bool testPrefaultTouchesEveryPage() {
+    HugePages::setMode(HugePages::Mode::Off);
+    size_t bytes = 4 * HugePages::HUGE_PAGE_SIZE;
+    void* memory = HugePages::allocate(bytes);
+    atomic<size_t> started{0};
+    HugePages::prefault(memory, bytes, 3, [&started](size_t) { started++; });
+
+    vector<unsigned char> resident(bytes / HugePages::SMALL_PAGE_SIZE);
+    bool ok = mincore(memory, bytes, resident.data()) == 0;
+    for (unsigned char page : resident) {
+        ok = ok && (page & 1);
+    }
+    HugePages::deallocate(memory, bytes);
+    if (!ok || started != 3) {
+        cout << "Error: Prefault left pages untouched or did not start 3 threads.\n";
+        return false;
+    }
+    return true;
+}
+
+bool testArenaPrefault() {
+    using Arena = NodeArena<HotNode<float>, int>;
+    Arena arena;
+    size_t bytes = arena.prefault(10, 2);
+    NodeId id = arena.emplace(HotNode<float>{1, 2}, 7);
+    if (bytes != Arena::CHUNK_SIZE * Arena::NODE_BYTES || arena.memoryBytes() != bytes || arena.cold(id) != 7) {
+        cout << "Error: Prefaulting 10 nodes should allocate and touch exactly one chunk.\n";
+        return false;
+    }
+    return true;
+}
+
+template <typename Func>
+bool runTest(const string& testName, Func testFunc) {
+    bool result = testFunc();
+    cout << (result ? "[PASS] " : "[FAIL] ") << testName << endl;
+    return result;
+}
+
+int main() {
+    size_t passed = 0, failed = 0;
+    auto count = [&](bool result) { result ? passed++ : failed++; };
+
+    count(runTest("testSmallAllocationsUseOperatorNew", testSmallAllocationsUseOperatorNew));
+    count(runTest("testLargeAllocationsAreHugePageAligned", testLargeAllocationsAreHugePageAligned));
+    count(runTest("testExplicitFallsBack", testExplicitFallsBack));
+    count(runTest("testPrefaultTouchesEveryPage", testPrefaultTouchesEveryPage));
+    count(runTest("testArenaPrefault", testArenaPrefault));
+
+    cout << "\n=== TESTING COMPLETE ===" << endl;
+    cout << "Passed: " << passed << endl;
+    cout << "Failed: " << failed << endl;
+    return failed == 0 ? 0 : 1;
+}
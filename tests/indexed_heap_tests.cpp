@@ -0,0 +1,152 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <string>
+#include "indexed_heap.hpp"
+
+using namespace std;
+
+// keys and heap positions live outside the heap, like the search nodes in a NodeArena
+struct Keys {
+    vector<int> key;
+    vector<uint32_t> position;
+};
+
+struct KeyLess {
+    const Keys* keys;
+    bool operator()(NodeId a, NodeId b) const {
+        return keys->key[a] < keys->key[b];
+    }
+};
+
+struct KeyPosition {
+    Keys* keys;
+    uint32_t& operator()(NodeId id) const {
+        return keys->position[id];
+    }
+};
+
+template <size_t Arity>
+using Heap = IndexedHeap<KeyLess, KeyPosition, Arity>;
+
+template <size_t Arity>
+bool testPopsInOrder() {
+    Keys keys;
+    Heap<Arity> heap(KeyLess{&keys}, KeyPosition{&keys});
+    mt19937 rng(42);
+    for (NodeId i = 0; i < 1000; i++) {
+        keys.key.push_back(rng() % 100);
+        keys.position.push_back(NOT_IN_HEAP);
+        heap.push(i);
+    }
+    int last = -1;
+    while (!heap.empty()) {
+        NodeId top = heap.top();
+        if (keys.key[top] < last) {
+            cout << "Error: Popped " << keys.key[top] << " after " << last << ".\n";
+            return false;
+        }
+        last = keys.key[top];
+        heap.pop();
+        if (heap.contains(top)) {
+            cout << "Error: Popped id still reported as contained.\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+template <size_t Arity>
+bool testUpdateAndErase() {
+    Keys keys;
+    Heap<Arity> heap(KeyLess{&keys}, KeyPosition{&keys});
+    mt19937 rng(7);
+    const NodeId n = 500;
+    for (NodeId i = 0; i < n; i++) {
+        keys.key.push_back(rng() % 1000);
+        keys.position.push_back(NOT_IN_HEAP);
+        heap.push(i);
+    }
+    vector<bool> erased(n, false);
+    for (size_t round = 0; round < 2000; round++) {
+        NodeId id = rng() % n;
+        if (erased[id]) continue;
+        if (round % 5 == 0) {
+            heap.erase(id);
+            erased[id] = true;
+        } else {
+            keys.key[id] = rng() % 1000; // both increases and decreases
+            heap.update(id);
+        }
+    }
+
+    vector<int> expected;
+    for (NodeId i = 0; i < n; i++) {
+        if (!erased[i]) expected.push_back(keys.key[i]);
+    }
+    sort(expected.begin(), expected.end());
+
+    vector<int> popped;
+    while (!heap.empty()) {
+        popped.push_back(keys.key[heap.top()]);
+        heap.pop();
+    }
+    if (popped != expected) {
+        cout << "Error: Heap contents differ from the reference after updates and erases.\n";
+        return false;
+    }
+    return true;
+}
+
+// visitInOrder sees the same prefix pop() would return and leaves the heap unchanged
+template <size_t Arity>
+bool testVisitInOrder() {
+    Keys keys;
+    Heap<Arity> heap(KeyLess{&keys}, KeyPosition{&keys});
+    mt19937 rng(3);
+    for (NodeId i = 0; i < 300; i++) {
+        keys.key.push_back(rng() % 50);
+        keys.position.push_back(NOT_IN_HEAP);
+        heap.push(i);
+    }
+    vector<int> visited;
+    heap.visitInOrder(40, [&](NodeId id) { visited.push_back(keys.key[id]); return true; });
+    size_t stoppedAfter = 0;
+    heap.visitInOrder(40, [&](NodeId) { return ++stoppedAfter < 5; });
+
+    vector<int> popped;
+    while (!heap.empty() && popped.size() < 40) {
+        popped.push_back(keys.key[heap.top()]);
+        heap.pop();
+    }
+    if (visited != popped || stoppedAfter != 5) {
+        cout << "Error: visitInOrder differs from popping, or did not stop when asked.\n";
+        return false;
+    }
+    return true;
+}
+
+template <typename Func>
+bool runTest(const string& heapName, const string& testName, Func testFunc) {
+    bool result = testFunc();
+    cout << (result ? "[PASS] (" : "[FAIL] (") << heapName << ") " << testName << endl;
+    return result;
+}
+
+int main() {
+    size_t passed = 0, failed = 0;
+    auto count = [&](bool result) { result ? passed++ : failed++; };
+
+    count(runTest("IndexedHeap<2>", "testPopsInOrder", testPopsInOrder<2>));
+    count(runTest("IndexedHeap<2>", "testUpdateAndErase", testUpdateAndErase<2>));
+    count(runTest("IndexedHeap<4>", "testPopsInOrder", testPopsInOrder<4>));
+    count(runTest("IndexedHeap<4>", "testUpdateAndErase", testUpdateAndErase<4>));
+    count(runTest("IndexedHeap<2>", "testVisitInOrder", testVisitInOrder<2>));
+    count(runTest("IndexedHeap<4>", "testVisitInOrder", testVisitInOrder<4>));
+
+    cout << "\n=== TESTING COMPLETE ===" << endl;
+    cout << "Passed: " << passed << endl;
+    cout << "Failed: " << failed << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <string>
+#include "latency_histogram.hpp"
+
+using namespace std;
+
+bool testBuckets() {
+    LatencyHistogram histogram;
+    histogram.record(0.5e-6);
+    histogram.record(1.5e-6);
+    histogram.record(3e-6);
+    histogram.record(3.5e-6);
+    string expected = "<1us:1 1-2us:1 2-4us:2";
+    if (histogram.toString() != expected) {
+        cout << "Error: Expected \"" << expected << "\", got \"" << histogram.toString() << "\".\n";
+        return false;
+    }
+    return true;
+}
+
+bool testCountMeanMax() {
+    LatencyHistogram histogram;
+    if (histogram.count() != 0 || histogram.mean() != 0 || histogram.max() != 0 || histogram.percentile(0.5) != 0) {
+        cout << "Error: An empty histogram should report zeros.\n";
+        return false;
+    }
+    histogram.record(1e-3);
+    histogram.record(3e-3);
+    if (histogram.count() != 2 || histogram.max() != 3e-3 || histogram.mean() < 1.99e-3 || histogram.mean() > 2.01e-3) {
+        cout << "Error: Wrong count " << histogram.count() << ", max " << histogram.max() << " or mean " << histogram.mean() << ".\n";
+        return false;
+    }
+    return true;
+}
+
+bool testPercentiles() {
+    LatencyHistogram histogram;
+    for (int i = 0; i < 99; i++) {
+        histogram.record(10e-6); // 8-16us
+    }
+    histogram.record(5e-3); // 4096-8192us
+    double p50 = histogram.percentile(0.5);
+    double p99 = histogram.percentile(0.99);
+    double p100 = histogram.percentile(1);
+    // percentiles are the upper edge of their bucket, but never above the longest sample
+    if (p50 != 16e-6 || p99 != 16e-6 || p100 != 5e-3) {
+        cout << "Error: Got p50 " << p50 << ", p99 " << p99 << " and p100 " << p100 << ".\n";
+        return false;
+    }
+    return true;
+}
+
+bool testHugeDurations() {
+    LatencyHistogram histogram;
+    histogram.record(1e9);
+    histogram.record(-1); // a clock going backwards counts as instant
+    string text = histogram.toString();
+    if (text.rfind("<1us:1 >", 0) != 0 || histogram.count() != 2) {
+        cout << "Error: Out of range durations should land in the first and last buckets, got \"" << text << "\".\n";
+        return false;
+    }
+    return true;
+}
+
+template <typename Func>
+bool runTest(const string& testName, Func testFunc) {
+    bool result = testFunc();
+    cout << (result ? "[PASS] " : "[FAIL] ") << testName << endl;
+    return result;
+}
+
+int main() {
+    size_t passed = 0, failed = 0;
+    auto count = [&](bool result) { result ? passed++ : failed++; };
+
+    count(runTest("testBuckets", testBuckets));
+    count(runTest("testCountMeanMax", testCountMeanMax));
+    count(runTest("testPercentiles", testPercentiles));
+    count(runTest("testHugeDurations", testHugeDurations));
+
+    cout << "\n=== TESTING COMPLETE ===" << endl;
+    cout << "Passed: " << passed << endl;
+    cout << "Failed: " << failed << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include "thread_affinity.hpp"
+
+using namespace std;
+using ThreadAffinity::Cpu;
+
+// 2 NUMA nodes with 2 cores of 2 hyperthreads each, numbered like linux does: siblings are id and id + 4
+vector<Cpu> fakeTopology() {
+    vector<Cpu> cpus;
+    for (int id = 0; id < 8; id++) {
+        int physical = id % 4;
+        cpus.push_back(Cpu{id, physical / 2, physical % 2, physical / 2});
+    }
+    return cpus;
+}
+
+bool expectOrder(const string& policy, const vector<int>& expected) {
+    vector<int> order = ThreadAffinity::cpuOrder(policy, fakeTopology());
+    if (order != expected) {
+        cout << "Error: " << policy << " gave " << ThreadAffinity::toString(order) << ", expected " << ThreadAffinity::toString(expected) << ".\n";
+        return false;
+    }
+    return true;
+}
+
+bool testCompactFillsANodeFirst() {
+    // node 0 holds cores 0 and 1 of package 0: cpus 0, 4 (core 0) and 1, 5 (core 1)
+    return expectOrder("compact", {0, 4, 1, 5, 2, 6, 3, 7});
+}
+
+bool testScatterAlternatesNodesAndSkipsSiblings() {
+    return expectOrder("scatter", {0, 2, 1, 3, 4, 6, 5, 7});
+}
+
+bool testCpuList() {
+    return expectOrder("3,0-2,7", {3, 0, 1, 2, 7}) && expectOrder("none", {}) && expectOrder("", {});
+}
+
+bool testBadListThrows() {
+    try {
+        ThreadAffinity::parseCpuList("4-2");
+    } catch (const invalid_argument&) {
+        return true;
+    }
+    cout << "Error: A descending range should be rejected.\n";
+    return false;
+}
+
+bool testDescribe() {
+    string description = ThreadAffinity::describe(fakeTopology());
+    if (description != "2 nodes, 2 packages, 4 cores, 8 cpus") {
+        cout << "Error: Described as " << description << ".\n";
+        return false;
+    }
+    return true;
+}
+
+template <typename Func>
+bool runTest(const string& testName, Func testFunc) {
+    bool result = testFunc();
+    cout << (result ? "[PASS] " : "[FAIL] ") << testName << endl;
+    return result;
+}
+
+int main() {
+    size_t passed = 0, failed = 0;
+    auto count = [&](bool result) { result ? passed++ : failed++; };
+
+    count(runTest("testCompactFillsANodeFirst", testCompactFillsANodeFirst));
+    count(runTest("testScatterAlternatesNodesAndSkipsSiblings", testScatterAlternatesNodesAndSkipsSiblings));
+    count(runTest("testCpuList", testCpuList));
+    count(runTest("testBadListThrows", testBadListThrows));
+    count(runTest("testDescribe", testDescribe));
+
+    cout << "\n=== TESTING COMPLETE ===" << endl;
+    cout << "Passed: " << passed << endl;
+    cout << "Failed: " << failed << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include "work_stealing_pool.hpp"
+#include "ctpl.hpp"
+
+using namespace std;
+
+// Same busy loop as Search::wasteTime, the work of one expansion at -e n
+static void wasteTime(size_t n) {
+    size_t sum = 0;
+    volatile size_t* s = &sum;
+    for (size_t j = 0; j < n; j++) {
+        *s = *s + j;
+    }
+}
+
+bool testRunsEveryTask() {
+    WorkStealingPool pool(3);
+    vector<atomic<int>> ran(10000);
+    TaskGroup group;
+    for (size_t i = 0; i < ran.size(); i++) {
+        pool.submit(group, [&ran, i](size_t) { ran[i]++; });
+    }
+    pool.wait(group);
+    for (size_t i = 0; i < ran.size(); i++) {
+        if (ran[i] != 1) {
+            cout << "Error: Task " << i << " ran " << ran[i] << " times.\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+// Tasks submitted from inside tasks go on the worker's own deque and are stolen by the others
+bool testNestedSubmit() {
+    WorkStealingPool pool(4);
+    atomic<size_t> leaves{0};
+    TaskGroup group;
+    for (size_t i = 0; i < 64; i++) {
+        pool.submit(group, [&pool, &group, &leaves](size_t) {
+            for (size_t j = 0; j < 64; j++) {
+                pool.submit(group, [&leaves](size_t) { leaves++; });
+            }
+        });
+    }
+    pool.wait(group);
+    if (leaves != 64 * 64) {
+        cout << "Error: Expected " << 64 * 64 << " nested tasks, ran " << leaves << ".\n";
+        return false;
+    }
+    return true;
+}
+
+// With no workers the waiting thread runs everything, and a full slot table runs tasks inline
+bool testNoWorkersAndFullSlots() {
+    WorkStealingPool pool(0, 8);
+    size_t ran = 0;
+    TaskGroup group;
+    for (size_t i = 0; i < 100; i++) {
+        pool.submit(group, [&ran](size_t workerId) { ran += workerId == 0; });
+    }
+    pool.wait(group);
+    if (ran != 100) {
+        cout << "Error: Expected 100 tasks on the waiting thread, ran " << ran << ".\n";
+        return false;
+    }
+    return true;
+}
+
+// Workers park when idle and wake up for new batches
+bool testBatchesAfterParking() {
+    WorkStealingPool pool(2);
+    atomic<size_t> ran{0};
+    for (size_t batch = 0; batch < 5; batch++) {
+        TaskGroup group;
+        for (size_t i = 0; i < 8; i++) {
+            pool.submit(group, [&ran](size_t) { ran++; });
+        }
+        pool.wait(group);
+        this_thread::sleep_for(chrono::milliseconds(5)); // long enough for the workers to park
+    }
+    if (ran != 40) {
+        cout << "Error: Expected 40 tasks, ran " << ran << ".\n";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Batches of one task per thread like KBFS, each task costing extra_expansion_time = work
+ * @return seconds per batch for ctpl (one future per task) and for WorkStealingPool (one TaskGroup per batch)
+ */
+pair<double, double> benchmark(size_t threads, size_t work, size_t batches) {
+    using Clock = chrono::high_resolution_clock;
+
+    ctpl::thread_pool ctplPool(threads);
+    auto start = Clock::now();
+    for (size_t b = 0; b < batches; b++) {
+        vector<future<void>> results(threads);
+        for (size_t i = 0; i < threads; i++) {
+            results[i] = ctplPool.push([work](int) { wasteTime(work); });
+        }
+        for (auto& result : results) result.get();
+    }
+    chrono::duration<double> ctplTime = Clock::now() - start;
+
+    WorkStealingPool pool(threads - 1); // the waiting thread is the last worker
+    start = Clock::now();
+    for (size_t b = 0; b < batches; b++) {
+        TaskGroup group;
+        for (size_t i = 0; i < threads; i++) {
+            pool.submit(group, [work](size_t) { wasteTime(work); });
+        }
+        pool.wait(group);
+    }
+    chrono::duration<double> poolTime = Clock::now() - start;
+    return {ctplTime.count() / batches, poolTime.count() / batches};
+}
+
+void runBenchmarks(size_t threads) {
+    printf("%10s %16s %16s %8s\n", "-e", "ctpl us/batch", "pool us/batch", "speedup");
+    for (size_t work : {0, 10, 100, 1000, 10000, 100000}) {
+        size_t batches = max<size_t>(200, 2000000 / (work + 1000));
+        auto [ctplTime, poolTime] = benchmark(threads, work, batches);
+        printf("%10zu %16.2f %16.2f %8.2f\n", work, ctplTime * 1e6, poolTime * 1e6, ctplTime / poolTime);
+    }
+}
+
+template <typename Func>
+bool runTest(const string& testName, Func testFunc) {
+    bool result = testFunc();
+    cout << (result ? "[PASS] " : "[FAIL] ") << testName << endl;
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    // ./thread_pool_tests --bench [threads] compares the pool to ctpl instead of testing
+    if (argc > 1 && strcmp(argv[1], "--bench") == 0) {
+        size_t threads = argc > 2 ? stoul(argv[2]) : max(2u, thread::hardware_concurrency());
+        runBenchmarks(threads);
+        return 0;
+    }
+
+    size_t passed = 0, failed = 0;
+    auto count = [&](bool result) { result ? passed++ : failed++; };
+
+    count(runTest("testRunsEveryTask", testRunsEveryTask));
+    count(runTest("testNestedSubmit", testNestedSubmit));
+    count(runTest("testNoWorkersAndFullSlots", testNoWorkersAndFullSlots));
+    count(runTest("testBatchesAfterParking", testBatchesAfterParking));
+
+    cout << "\n=== TESTING COMPLETE ===" << endl;
+    cout << "Passed: " << passed << endl;
+    cout << "Failed: " << failed << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <string>
+#include "work_stealing_deque.hpp"
+
+using namespace std;
+
+bool testOwnerIsLifo() {
+    WorkStealingDeque<uint32_t> deque(4); // small so it has to grow
+    for (uint32_t i = 0; i < 100; i++) {
+        deque.push(i);
+    }
+    for (uint32_t i = 100; i-- > 0;) {
+        auto item = deque.pop();
+        if (!item || *item != i) {
+            cout << "Error: Expected " << i << " from pop.\n";
+            return false;
+        }
+    }
+    if (deque.pop() || !deque.empty()) {
+        cout << "Error: Deque should be empty.\n";
+        return false;
+    }
+    return true;
+}
+
+bool testThievesAreFifo() {
+    WorkStealingDeque<uint32_t> deque;
+    for (uint32_t i = 0; i < 10; i++) {
+        deque.push(i);
+    }
+    for (uint32_t i = 0; i < 10; i++) {
+        auto item = deque.steal();
+        if (!item || *item != i) {
+            cout << "Error: Expected " << i << " from steal.\n";
+            return false;
+        }
+    }
+    return !deque.steal().has_value();
+}
+
+// The owner pushes and pops while thieves steal, every item must be taken exactly once
+bool testConcurrentTakesEachItemOnce() {
+    const uint32_t itemCount = 200000;
+    const size_t thiefCount = 3;
+    WorkStealingDeque<uint32_t> deque(16);
+    vector<atomic<uint8_t>> taken(itemCount);
+    atomic<bool> ownerDone{false};
+
+    auto take = [&](uint32_t item) { taken[item].fetch_add(1, memory_order_relaxed); };
+
+    vector<thread> thieves;
+    for (size_t i = 0; i < thiefCount; i++) {
+        thieves.emplace_back([&] {
+            while (!ownerDone.load(memory_order_acquire) || !deque.empty()) {
+                if (auto item = deque.steal()) take(*item);
+            }
+        });
+    }
+    for (uint32_t i = 0; i < itemCount; i++) {
+        deque.push(i);
+        if (i % 3 == 0) {
+            if (auto item = deque.pop()) take(*item);
+        }
+    }
+    while (auto item = deque.pop()) take(*item);
+    ownerDone.store(true, memory_order_release);
+    for (auto& thief : thieves) thief.join();
+
+    for (uint32_t i = 0; i < itemCount; i++) {
+        if (taken[i].load() != 1) {
+            cout << "Error: Item " << i << " was taken " << int(taken[i].load()) << " times.\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Func>
+bool runTest(const string& testName, Func testFunc) {
+    bool result = testFunc();
+    cout << (result ? "[PASS] " : "[FAIL] ") << testName << endl;
+    return result;
+}
+
+int main() {
+    size_t passed = 0, failed = 0;
+    auto count = [&](bool result) { result ? passed++ : failed++; };
+
+    count(runTest("testOwnerIsLifo", testOwnerIsLifo));
+    count(runTest("testThievesAreFifo", testThievesAreFifo));
+    count(runTest("testConcurrentTakesEachItemOnce", testConcurrentTakesEachItemOnce));
+
+    cout << "\n=== TESTING COMPLETE ===" << endl;
+    cout << "Passed: " << passed << endl;
+    cout << "Failed: " << failed << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Writes whole buffers to files on a background thread, so a search can keep expanding while its output
+ * goes to disk. Writes to one file happen in the order they were queued. At most maxQueuedBytes wait in
+ * the queue, queueing more blocks until the writer catches up.
+ */
+class AsyncFileWriter {
+public:
+    explicit AsyncFileWriter(size_t maxQueuedBytes = size_t(64) << 20)
+        : maxQueuedBytes(maxQueuedBytes), worker([this](std::stop_token stop) { run(stop); }) {}
+
+    ~AsyncFileWriter() {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return jobs.empty() && !busy; });
+        }
+        worker.request_stop();
+    }
+
+    AsyncFileWriter(const AsyncFileWriter&) = delete;
+    AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+    // Queues data to be appended to the file at path, creating it if needed
+    void append(const std::string& path, std::vector<unsigned char> data) {
+        queue(Job{path, std::move(data), false});
+    }
+
+    // Queues data to replace the contents of the file at path
+    void replace(const std::string& path, std::vector<unsigned char> data) {
+        queue(Job{path, std::move(data), true});
+    }
+
+    // Blocks until every queued write has been written
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex);
+        waitFor(lock, [this] { return jobs.empty() && !busy; });
+        rethrow();
+    }
+
+    size_t bytesWritten() const { return written; }
+    double waitTime() const { return waited; } // seconds spent blocked in append, replace and drain
+
+    // The contents of the file at path, empty when it does not exist
+    static std::vector<unsigned char> readFile(const std::string& path) {
+        std::vector<unsigned char> data;
+        FILE* file = std::fopen(path.c_str(), "rb");
+        if (file == nullptr) return data;
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        data.resize(size > 0 ? static_cast<size_t>(size) : 0);
+        size_t read = data.empty() ? 0 : std::fread(data.data(), 1, data.size(), file);
+        std::fclose(file);
+        data.resize(read);
+        return data;
+    }
+
+private:
+    struct Job {
+        std::string path;
+        std::vector<unsigned char> data;
+        bool truncate;
+    };
+
+    size_t maxQueuedBytes;
+    std::mutex mutex;
+    std::condition_variable_any changed;
+    std::deque<Job> jobs;
+    size_t queuedBytes = 0;
+    bool busy = false;
+    std::string error; // the first failed write, rethrown by the next call
+    std::atomic<size_t> written{0};
+    double waited = 0;
+    std::jthread worker; // last, so it starts after everything it uses
+
+    template<typename Predicate>
+    void waitFor(std::unique_lock<std::mutex>& lock, Predicate predicate) {
+        if (predicate()) return;
+        auto start = std::chrono::steady_clock::now();
+        changed.wait(lock, predicate);
+        waited += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void rethrow() {
+        if (!error.empty()) throw std::runtime_error(error);
+    }
+
+    void queue(Job job) {
+        std::unique_lock<std::mutex> lock(mutex);
+        rethrow();
+        waitFor(lock, [this] { return queuedBytes < maxQueuedBytes; });
+        queuedBytes += job.data.size();
+        jobs.push_back(std::move(job));
+        changed.notify_all();
+    }
+
+    void run(std::stop_token stop) {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            changed.wait(lock, stop, [this] { return !jobs.empty(); });
+            if (jobs.empty()) return; // stopped
+            Job job = std::move(jobs.front());
+            jobs.pop_front();
+            busy = true;
+            lock.unlock();
+
+            FILE* file = std::fopen(job.path.c_str(), job.truncate ? "wb" : "ab");
+            bool ok = file != nullptr && std::fwrite(job.data.data(), 1, job.data.size(), file) == job.data.size();
+            if (file != nullptr) ok = std::fclose(file) == 0 && ok;
+
+            lock.lock();
+            if (!ok && error.empty()) error = "Could not write " + job.path;
+            written += job.data.size();
+            queuedBytes -= job.data.size();
+            busy = false;
+            changed.notify_all();
+        }
+    }
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * BlockPool hands out fixed size blocks of T addressed by 32 bit ids and recycles released blocks through
+ * a free list, so once the pool has grown to its working size acquiring a block allocates nothing.
+ * Released blocks keep their elements alive: assigning into them reuses whatever memory they own
+ * (e.g. the vector inside a State).
+ *
+ * acquire() and release() are thread safe. block() is safe from any thread that was handed the id
+ * through some synchronisation.
+ */
+template<typename T>
+class BlockPool {
+public:
+    using BlockId = uint32_t;
+    static constexpr BlockId NO_BLOCK = std::numeric_limits<BlockId>::max();
+
+    explicit BlockPool(size_t blockSize) : blockSize(blockSize), chunks(new std::atomic<T*>[MAX_CHUNKS]()) {}
+
+    BlockPool(const BlockPool&) = delete;
+    BlockPool& operator=(const BlockPool&) = delete;
+
+    ~BlockPool() {
+        for (size_t c = 0; c < chunkCount; c++) {
+            delete[] chunks[c].load(std::memory_order_relaxed);
+        }
+    }
+
+    // @return a block of blockSize elements, recycled when possible
+    BlockId acquire() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!freeBlocks.empty()) {
+            BlockId id = freeBlocks.back();
+            freeBlocks.pop_back();
+            return id;
+        }
+        if (nextBlock == chunkCount * BLOCKS_PER_CHUNK) {
+            if (chunkCount == MAX_CHUNKS) throw std::length_error("BlockPool is out of blocks");
+            chunks[chunkCount].store(new T[BLOCKS_PER_CHUNK * blockSize], std::memory_order_release);
+            chunkCount++;
+        }
+        return nextBlock++;
+    }
+
+    // Gives the block back to the pool, its elements are not destroyed
+    void release(BlockId id) {
+        std::lock_guard<std::mutex> lock(mtx);
+        freeBlocks.push_back(id);
+    }
+
+    // @return a pointer to the blockSize elements of the block
+    inline T* block(BlockId id) {
+        return chunks[id / BLOCKS_PER_CHUNK].load(std::memory_order_relaxed) + (id % BLOCKS_PER_CHUNK) * blockSize;
+    }
+
+    // Number of blocks ever created, the peak number of blocks in use
+    size_t blockCount() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return nextBlock;
+    }
+
+    size_t memoryBytes() {
+        std::lock_guard<std::mutex> lock(mtx);
+        return chunkCount * BLOCKS_PER_CHUNK * blockSize * sizeof(T) + freeBlocks.capacity() * sizeof(BlockId);
+    }
+
+private:
+    static constexpr size_t BLOCKS_PER_CHUNK = 4096;
+    static constexpr size_t MAX_CHUNKS = size_t(1) << 16; // 2^28 blocks, far more than are ever in flight
+
+    size_t blockSize;
+    std::unique_ptr<std::atomic<T*>[]> chunks;
+    size_t chunkCount = 0;
+    BlockId nextBlock = 0;
+    std::vector<BlockId> freeBlocks;
+    std::mutex mtx;
+};
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include <boost/unordered/unordered_flat_set.hpp>
+
+#include "node_arena.hpp"
+#include "huge_pages.hpp"
+
+/**
+ * ClosedSet maps States to the id of the arena node that holds them, without keeping a second copy of
+ * the State as a map key. Each entry is the node id plus 32 bits of its hash; lookups compare the stored
+ * hash first and only then the State inside the node, so a probe usually touches just the 8 byte entry.
+ *
+ * Lookups are heterogeneous: a State (with or without a precomputed hash) is looked up directly, no node
+ * has to exist for it. The arena's cold nodes must have a `state` member. Buckets are allocated through
+ * HugePages, like the arena's chunks.
+ */
+template<typename State, typename Arena>
+class ClosedSet {
+public:
+    using HashFn = std::function<size_t(const State&)>;
+
+    struct Entry {
+        NodeId id;
+        uint32_t hash;
+    };
+    using value_type = Entry;
+
+    ClosedSet(const Arena* nodes, HashFn hashFn) : hashFn(std::move(hashFn)), entries(0, EntryHash{}, EntryEqual{nodes}) {}
+
+    inline size_t hash(const State& state) const {
+        return hashFn(state);
+    }
+
+    // @return the id of the node holding state, NO_NODE when it is not in the set
+    inline NodeId find(const State& state, size_t stateHash) const {
+        auto it = entries.find(Probe{state, fold(stateHash)});
+        return it == entries.end() ? NO_NODE : it->id;
+    }
+    inline NodeId find(const State& state) const {
+        return find(state, hash(state));
+    }
+
+    /**
+     * Adds the node, its state must already be stored in the arena
+     * @return false when a node with an equal state is already in the set
+     */
+    inline bool insert(NodeId id, size_t stateHash) {
+        return entries.insert(Entry{id, fold(stateHash)}).second;
+    }
+    inline bool insert(NodeId id, const State& state) {
+        return insert(id, hash(state));
+    }
+
+    // Removes the node holding state, if any
+    inline void erase(const State& state, size_t stateHash) {
+        auto it = entries.find(Probe{state, fold(stateHash)});
+        if (it != entries.end()) entries.erase(it);
+    }
+
+    void reserve(size_t n) { entries.reserve(n); }
+    void clear() { entries.clear(); }
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    size_t bucket_count() const { return entries.bucket_count(); }
+    float load_factor() const { return entries.load_factor(); }
+
+private:
+    // A state being looked up, with its folded hash
+    struct Probe {
+        const State& state;
+        uint32_t hash;
+    };
+
+    struct EntryHash {
+        using is_transparent = void;
+        size_t operator()(const Entry& e) const { return e.hash; }
+        size_t operator()(const Probe& p) const { return p.hash; }
+    };
+
+    struct EntryEqual {
+        using is_transparent = void;
+        const Arena* nodes;
+        bool operator()(const Entry& a, const Entry& b) const {
+            return a.hash == b.hash && (a.id == b.id || nodes->cold(a.id).state == nodes->cold(b.id).state);
+        }
+        bool operator()(const Probe& p, const Entry& e) const {
+            return p.hash == e.hash && p.state == nodes->cold(e.id).state;
+        }
+        bool operator()(const Entry& e, const Probe& p) const {
+            return (*this)(p, e);
+        }
+    };
+
+    // Keep both halves of the hash in the 32 bits that are stored
+    static inline uint32_t fold(size_t h) {
+        return static_cast<uint32_t>(h ^ (h >> 32));
+    }
+
+    HashFn hashFn;
+    boost::unordered_flat_set<Entry, EntryHash, EntryEqual, HugePages::Allocator<Entry>> entries;
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
+#include <vector>
+
+#include "node_arena.hpp"
+
+/**
+ * IndexedHeap is a d-ary min heap of node ids.
+ * Every node remembers its own position in the heap (the Position functor returns a reference to it),
+ * so update, erase and contains need no handle objects: the heap itself is a single vector of 32 bit ids.
+ *
+ * Less(a, b) should return true when node a should be popped before node b.
+ */
+template <typename Less, typename Position, size_t Arity = 2>
+class IndexedHeap {
+public:
+    IndexedHeap(Less less, Position position) : less(less), position(position) {
+        static_assert(Arity >= 2, "Arity must be at least 2");
+    }
+
+    void push(NodeId id) {
+        items.push_back(id);
+        position(id) = static_cast<uint32_t>(items.size() - 1);
+        siftUp(items.size() - 1);
+    }
+
+    NodeId top() const {
+        assert(!items.empty());
+        return items.front();
+    }
+
+    void pop() {
+        assert(!items.empty());
+        position(items.front()) = NOT_IN_HEAP;
+        NodeId last = items.back();
+        items.pop_back();
+        if (!items.empty()) {
+            items[0] = last;
+            position(last) = 0;
+            siftDown(0);
+        }
+    }
+
+    // Restores the heap order after the key of id changed in either direction
+    void update(NodeId id) {
+        size_t i = position(id);
+        assert(i < items.size() && items[i] == id);
+        siftUp(i);
+        siftDown(position(id));
+    }
+
+    // Removes id from anywhere in the heap
+    void erase(NodeId id) {
+        size_t i = position(id);
+        assert(i < items.size() && items[i] == id);
+        position(id) = NOT_IN_HEAP;
+        NodeId last = items.back();
+        items.pop_back();
+        if (i < items.size()) {
+            items[i] = last;
+            position(last) = static_cast<uint32_t>(i);
+            siftUp(i);
+            siftDown(position(last));
+        }
+    }
+
+    bool contains(NodeId id) const {
+        return position(id) != NOT_IN_HEAP;
+    }
+
+    // Element at index i of the underlying array (index 0 is the top)
+    NodeId at(size_t i) const {
+        return items[i];
+    }
+
+    /**
+     * Calls visit(id) on up to limit nodes in the order pop() would return them, without changing the heap,
+     * until visit returns false. Walks the heap tree from the top with a small heap of the children seen so far.
+     */
+    template <typename Visit>
+    void visitInOrder(size_t limit, Visit visit) const {
+        if (items.empty()) return;
+        auto later = [this](size_t a, size_t b) { return less(items[b], items[a]); };
+        visitFrontier.clear();
+        visitFrontier.push_back(0);
+        for (size_t visited = 0; visited < limit && !visitFrontier.empty(); visited++) {
+            std::pop_heap(visitFrontier.begin(), visitFrontier.end(), later);
+            size_t i = visitFrontier.back();
+            visitFrontier.pop_back();
+            if (!visit(items[i])) return;
+            for (size_t c = i * Arity + 1; c <= i * Arity + Arity && c < items.size(); c++) {
+                visitFrontier.push_back(c);
+                std::push_heap(visitFrontier.begin(), visitFrontier.end(), later);
+            }
+        }
+    }
+
+    size_t size() const {
+        return items.size();
+    }
+
+    bool empty() const {
+        return items.empty();
+    }
+
+    void clear() {
+        for (NodeId id : items) {
+            position(id) = NOT_IN_HEAP;
+        }
+        items.clear();
+    }
+
+    size_t memoryBytes() const {
+        return items.capacity() * sizeof(NodeId);
+    }
+
+private:
+    std::vector<NodeId> items;
+    mutable std::vector<size_t> visitFrontier; // scratch space of visitInOrder
+    Less less;
+    Position position;
+
+    void siftUp(size_t i) {
+        NodeId id = items[i];
+        while (i > 0) {
+            size_t parent = (i - 1) / Arity;
+            if (!less(id, items[parent])) break;
+            items[i] = items[parent];
+            position(items[i]) = static_cast<uint32_t>(i);
+            i = parent;
+        }
+        items[i] = id;
+        position(id) = static_cast<uint32_t>(i);
+    }
+
+    void siftDown(size_t i) {
+        NodeId id = items[i];
+        size_t n = items.size();
+        while (true) {
+            size_t first = i * Arity + 1;
+            if (first >= n) break;
+            size_t last = first + Arity < n ? first + Arity : n;
+            size_t best = first;
+            for (size_t c = first + 1; c < last; c++) {
+                if (less(items[c], items[best])) best = c;
+            }
+            if (!less(items[best], id)) break;
+            items[i] = items[best];
+            position(items[i]) = static_cast<uint32_t>(i);
+            i = best;
+        }
+        items[i] = id;
+        position(id) = static_cast<uint32_t>(i);
+    }
+};
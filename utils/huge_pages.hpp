@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+
+/**
+ * Backing for the large, long lived allocations of a search (node arena chunks, closed table buckets).
+ * Allocations of at least HUGE_PAGE_SIZE bytes are mmapped and, depending on the mode, backed by
+ *   off          whatever the kernel does by default
+ *   thp          transparent huge pages, the range is 2MB aligned and madvised MADV_HUGEPAGE
+ *   explicit     MAP_HUGETLB pages from the reserved pool (vm.nr_hugepages), falling back to thp when the
+ *                pool is empty
+ * Smaller allocations go to operator new. Which backing each allocation got is counted in counters().
+ *
+ * Set the mode once, before the first allocation: deallocate() only depends on the size, not the mode.
+ */
+namespace HugePages {
+
+    static constexpr size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+    static constexpr size_t SMALL_PAGE_SIZE = 4096;
+    static constexpr size_t SMALL_ALIGNMENT = 64;
+
+    enum class Mode { Off, Transparent, Explicit };
+
+    inline Mode parseMode(const std::string& text) {
+        if (text.empty() || text == "off" || text == "none") return Mode::Off;
+        if (text == "thp" || text == "transparent") return Mode::Transparent;
+        if (text == "explicit" || text == "hugetlb") return Mode::Explicit;
+        throw std::invalid_argument("Unknown huge page mode: " + text);
+    }
+
+    inline std::string toString(Mode mode) {
+        switch (mode) {
+            case Mode::Off: return "off";
+            case Mode::Transparent: return "thp";
+            case Mode::Explicit: return "explicit";
+        }
+        return "unknown";
+    }
+
+    inline std::atomic<Mode> currentMode{Mode::Off};
+
+    inline void setMode(Mode mode) { currentMode.store(mode, std::memory_order_relaxed); }
+    inline Mode mode() { return currentMode.load(std::memory_order_relaxed); }
+
+    /**
+     * Bytes reserved per backing since the program started, plus how often explicit pages were asked for but
+     * not available. They only grow: freed allocations stay counted and a reservation counts whether or not its
+     * pages were ever touched, what is resident shows in the RSS. smallBytes also holds the mappings left to the
+     * kernel's default, which uses small pages unless transparent huge pages are set to always.
+     */
+    struct Counters {
+        std::atomic<size_t> explicitBytes{0};
+        std::atomic<size_t> transparentBytes{0}; // madvised, the kernel may still use small pages
+        std::atomic<size_t> smallBytes{0};
+        std::atomic<size_t> fallbacks{0};
+    };
+
+    inline Counters& counters() {
+        static Counters instance;
+        return instance;
+    }
+
+    inline size_t mappedSize(size_t bytes) {
+        return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    }
+
+    // A HUGE_PAGE_SIZE aligned anonymous mapping of length bytes, nullptr when out of address space
+    inline void* mapAligned(size_t length) {
+        size_t padded = length + HUGE_PAGE_SIZE;
+        void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (raw == MAP_FAILED) return nullptr;
+        uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+        uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        if (aligned > start) munmap(raw, aligned - start);
+        size_t tail = start + padded - (aligned + length);
+        if (tail > 0) munmap(reinterpret_cast<void*>(aligned + length), tail);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    /**
+     * Allocates bytes with the backing of the current mode, the memory is not touched
+     * @throws std::bad_alloc when no backing can provide it
+     */
+    inline void* allocate(size_t bytes) {
+        if (bytes < HUGE_PAGE_SIZE) {
+            counters().smallBytes.fetch_add(bytes, std::memory_order_relaxed);
+            return ::operator new(bytes, std::align_val_t(SMALL_ALIGNMENT));
+        }
+        size_t length = mappedSize(bytes);
+        Mode requested = mode();
+        if (requested == Mode::Explicit) {
+            void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (memory != MAP_FAILED) {
+                counters().explicitBytes.fetch_add(length, std::memory_order_relaxed);
+                return memory;
+            }
+            counters().fallbacks.fetch_add(1, std::memory_order_relaxed);
+            requested = Mode::Transparent;
+        }
+        void* memory = mapAligned(length);
+        if (memory == nullptr) throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+        if (requested == Mode::Transparent && madvise(memory, length, MADV_HUGEPAGE) == 0) {
+            counters().transparentBytes.fetch_add(length, std::memory_order_relaxed);
+            return memory;
+        }
+#endif
+        counters().smallBytes.fetch_add(length, std::memory_order_relaxed);
+        return memory;
+    }
+
+    inline void deallocate(void* memory, size_t bytes) {
+        if (memory == nullptr) return;
+        if (bytes < HUGE_PAGE_SIZE) {
+            ::operator delete(memory, std::align_val_t(SMALL_ALIGNMENT));
+            return;
+        }
+        munmap(memory, mappedSize(bytes));
+    }
+
+    /**
+     * Writes one byte per page of [memory, memory + bytes) so the page faults happen now instead of during
+     * the search. The range is split between threads threads, onStart(i) runs first on the i-th of them (to
+     * pin it, so first touch places its share on its NUMA node). The memory must not hold objects yet.
+     */
+    inline void prefault(void* memory, size_t bytes, size_t threads, const std::function<void(size_t)>& onStart = {}) {
+        threads = std::max<size_t>(threads, 1);
+        size_t pages = (bytes + SMALL_PAGE_SIZE - 1) / SMALL_PAGE_SIZE;
+        size_t perThread = (pages + threads - 1) / threads;
+        auto touch = [=, &onStart](size_t i) {
+            if (onStart) onStart(i);
+            volatile char* base = static_cast<char*>(memory);
+            for (size_t page = i * perThread; page < std::min(pages, (i + 1) * perThread); page++) {
+                base[page * SMALL_PAGE_SIZE] = 0;
+            }
+        };
+        std::vector<std::jthread> workers;
+        for (size_t i = 1; i < threads; i++) {
+            workers.emplace_back(touch, i);
+        }
+        touch(0);
+    }
+
+    /**
+     * A std allocator over allocate()/deallocate(), for the buckets of the closed tables
+     */
+    template<typename T>
+    struct Allocator {
+        using value_type = T;
+
+        Allocator() = default;
+        template<typename U>
+        Allocator(const Allocator<U>&) {}
+
+        T* allocate(size_t n) { return static_cast<T*>(HugePages::allocate(n * sizeof(T))); }
+        void deallocate(T* p, size_t n) { HugePages::deallocate(p, n * sizeof(T)); }
+
+        template<typename U>
+        bool operator==(const Allocator<U>&) const { return true; }
+    };
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <string>
+
+/**
+ * Counts durations in power of two buckets of microseconds: bucket 0 holds everything under 1us and
+ * bucket i holds [2^(i-1), 2^i) us. Keeps the exact count, sum and maximum, so only percentiles are
+ * approximate (to the upper edge of their bucket). Not thread safe.
+ */
+class LatencyHistogram {
+public:
+    static constexpr size_t BUCKETS = 40; // the last one holds everything above 2^38 us, about 3 days
+
+    void record(double seconds) {
+        seconds = std::max(seconds, 0.0); // a clock that went backwards
+        double micros = seconds * 1e6;
+        size_t bucket = micros < 1 ? 0 : std::min(BUCKETS - 1, static_cast<size_t>(std::log2(micros)) + 1);
+        counts[bucket]++;
+        samples++;
+        total += seconds;
+        longest = std::max(longest, seconds);
+    }
+
+    size_t count() const { return samples; }
+    double max() const { return longest; }
+    double mean() const { return samples == 0 ? 0 : total / samples; }
+
+    // Upper edge, in seconds, of the bucket holding the p-th fraction of the samples (p in [0, 1])
+    double percentile(double p) const {
+        if (samples == 0) return 0;
+        size_t rank = static_cast<size_t>(std::ceil(std::clamp(p, 0.0, 1.0) * samples));
+        size_t seen = 0;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            seen += counts[i];
+            if (seen >= std::max<size_t>(rank, 1)) return std::min(upperEdge(i), longest);
+        }
+        return longest;
+    }
+
+    // The non empty buckets as "<1us:3 1-2us:10 2-4us:7 ...", the stat a search reports
+    std::string toString() const {
+        std::string text;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            if (counts[i] == 0) continue;
+            if (!text.empty()) text += " ";
+            text += label(i) + ":" + std::to_string(counts[i]);
+        }
+        return text;
+    }
+
+private:
+    std::array<size_t, BUCKETS> counts{};
+    size_t samples = 0;
+    double total = 0;
+    double longest = 0;
+
+    static double upperEdge(size_t bucket) {
+        return std::ldexp(1.0, static_cast<int>(bucket)) * 1e-6;
+    }
+
+    static std::string label(size_t bucket) {
+        if (bucket == 0) return "<1us";
+        size_t low = size_t(1) << (bucket - 1);
+        if (bucket == BUCKETS - 1) return ">" + std::to_string(low) + "us";
+        return std::to_string(low) + "-" + std::to_string(low * 2) + "us";
+    }
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <stdexcept>
+
+#include <unistd.h>
+#include <sys/resource.h>
+
+/**
+ * Helpers for measuring how much memory the process and its containers use.
+ * RSS is read from the kernel so it also covers memory owned by the States
+ * themselves (vectors, sets), which sizeof(Node) does not see.
+ */
+namespace MemoryUsage {
+
+    // Current resident set size in bytes, read from /proc/self/statm
+    inline size_t currentRSS() {
+        FILE* file = fopen("/proc/self/statm", "r");
+        if (file == nullptr) return 0;
+        size_t pages = 0, residentPages = 0;
+        if (fscanf(file, "%zu %zu", &pages, &residentPages) != 2) residentPages = 0;
+        fclose(file);
+        return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+
+    // Peak resident set size in bytes since the process started
+    inline size_t peakRSS() {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+        return static_cast<size_t>(usage.ru_maxrss) * 1024; // ru_maxrss is in KiB on linux
+    }
+
+    // Resident bytes backed by transparent huge pages, from /proc/self/smaps_rollup (0 when unavailable)
+    inline size_t anonHugePageBytes() {
+        FILE* file = fopen("/proc/self/smaps_rollup", "r");
+        if (file == nullptr) return 0;
+        char line[256];
+        size_t kib = 0;
+        while (fgets(line, sizeof(line), file) != nullptr) {
+            if (sscanf(line, "AnonHugePages: %zu kB", &kib) == 1) break;
+        }
+        fclose(file);
+        return kib * 1024;
+    }
+
+    /**
+     * Approximate bytes used by an open addressing hash table (boost unordered_flat_map/set):
+     * one slot per bucket plus one byte of metadata per bucket
+     */
+    template<typename Table>
+    inline size_t hashTableBytes(const Table& table) {
+        return table.bucket_count() * (sizeof(typename Table::value_type) + 1);
+    }
+
+    /**
+     * Parse a byte count such as "4096", "512M" or "2G" (K, M, G and T are powers of 1024)
+     */
+    inline size_t parseBytes(const std::string& text) {
+        size_t consumed = 0;
+        double value = std::stod(text, &consumed);
+        size_t multiplier = 1;
+        if (consumed < text.size()) {
+            switch (text[consumed]) {
+                case 'k': case 'K': multiplier = 1ull << 10; break;
+                case 'm': case 'M': multiplier = 1ull << 20; break;
+                case 'g': case 'G': multiplier = 1ull << 30; break;
+                case 't': case 'T': multiplier = 1ull << 40; break;
+                default: throw std::invalid_argument("Unknown memory unit in: " + text);
+            }
+        }
+        return static_cast<size_t>(value * multiplier);
+    }
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "huge_pages.hpp"
+
+using NodeId = uint32_t;
+static constexpr NodeId NO_NODE = std::numeric_limits<NodeId>::max();
+static constexpr uint32_t NOT_IN_HEAP = std::numeric_limits<uint32_t>::max();
+
+/**
+ * The fields of a search node that heap operations touch.
+ * Kept apart from the State so that sifting through the heap only pulls in a few bytes per node.
+ */
+template<typename Cost>
+struct HotNode {
+    Cost f{}, g{};
+    uint32_t heapIndex = NOT_IN_HEAP; // position in the open list, NOT_IN_HEAP when not in it
+};
+
+/**
+ * NodeArena stores search nodes as two parallel arrays: Hot for what the heap compares and Cold for
+ * the rest (State, parent, ...). Nodes are addressed by 32 bit ids instead of pointers.
+ *
+ * Storage grows in chunks of CHUNK_SIZE nodes, so nodes never move and references stay valid for the
+ * lifetime of the arena. Chunk memory is reserved untouched, each page is first touched (and so placed on
+ * the NUMA node of) the thread that constructs the first node in it. Threads that emplace through their
+ * own LocalRange get runs of LOCAL_RANGE_SIZE consecutive ids, so their nodes share pages with each other
+ * instead of with other threads' nodes.
+ *
+ * Chunks come from HugePages, so they are backed by huge pages when a huge page mode is set, and
+ * prefault() can take the page faults for the first chunks up front, spread over several threads.
+ *
+ * allocate() and emplace() are thread safe. Accessing a node is safe from any thread that was handed
+ * its id through some synchronisation (a lock, an atomic, a join).
+ */
+template<typename Hot, typename Cold>
+class NodeArena {
+public:
+    static constexpr size_t CHUNK_BITS = 20;
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static constexpr size_t CHUNK_MASK = CHUNK_SIZE - 1;
+    static constexpr size_t MAX_CHUNKS = (size_t(NO_NODE) + 1) / CHUNK_SIZE;
+    static constexpr size_t LOCAL_RANGE_SIZE = 1024;
+    static constexpr size_t NODE_BYTES = sizeof(Hot) + sizeof(Cold);
+
+    // A run of ids reserved by one thread, give it back with release() when the thread is done
+    struct LocalRange {
+        size_t next = 0;
+        size_t end = 0;
+    };
+
+    NodeArena() : hotChunks(new std::atomic<Hot*>[MAX_CHUNKS]()), coldChunks(new std::atomic<Cold*>[MAX_CHUNKS]()) {}
+
+    NodeArena(const NodeArena&) = delete;
+    NodeArena& operator=(const NodeArena&) = delete;
+
+    ~NodeArena() {
+        destroyNodes();
+        for (size_t c = 0; c < MAX_CHUNKS; c++) {
+            Hot* hotChunk = hotChunks[c].load(std::memory_order_relaxed);
+            if (hotChunk == nullptr) break; // chunks are allocated in order
+            HugePages::deallocate(hotChunk, CHUNK_SIZE * sizeof(Hot));
+            HugePages::deallocate(coldChunks[c].load(std::memory_order_relaxed), CHUNK_SIZE * sizeof(Cold));
+        }
+    }
+
+    /**
+     * Reserve count consecutive nodes and default construct them
+     * @return the id of the first node
+     */
+    NodeId allocate(size_t count = 1) {
+        NodeId first = reserve(count);
+        for (size_t id = first; id < first + count; id++) {
+            new (&hot(id)) Hot();
+            new (&cold(id)) Cold();
+        }
+        return first;
+    }
+
+    /**
+     * Reserve a single node and construct it in place
+     * @return the id of the node
+     */
+    template<typename... ColdArgs>
+    NodeId emplace(const Hot& hotNode, ColdArgs&&... coldArgs) {
+        NodeId id = reserve(1);
+        new (&hot(id)) Hot(hotNode);
+        new (&cold(id)) Cold(std::forward<ColdArgs>(coldArgs)...);
+        return id;
+    }
+
+    /**
+     * Like emplace, but takes the id from the calling thread's range, reserving a new range when it runs out
+     * @return the id of the node
+     */
+    template<typename... ColdArgs>
+    NodeId emplaceLocal(LocalRange& range, const Hot& hotNode, ColdArgs&&... coldArgs) {
+        if (range.next == range.end) {
+            range.next = reserve(LOCAL_RANGE_SIZE);
+            range.end = range.next + LOCAL_RANGE_SIZE;
+        }
+        NodeId id = static_cast<NodeId>(range.next++);
+        new (&hot(id)) Hot(hotNode);
+        new (&cold(id)) Cold(std::forward<ColdArgs>(coldArgs)...);
+        return id;
+    }
+
+    /**
+     * Destroys the node at id and constructs a new one in its place, for searches that recycle the ids
+     * of the nodes they forget (SMA*)
+     */
+    template<typename... ColdArgs>
+    void reconstruct(NodeId id, const Hot& hotNode, ColdArgs&&... coldArgs) {
+        hot(id).~Hot();
+        cold(id).~Cold();
+        new (&hot(id)) Hot(hotNode);
+        new (&cold(id)) Cold(std::forward<ColdArgs>(coldArgs)...);
+    }
+
+    /**
+     * Destroys every node and hands ids out from 0 again, keeping the chunks (and their pages) for reuse.
+     * Only call it while no other thread uses the arena.
+     */
+    void clear() {
+        destroyNodes();
+        next.store(0, std::memory_order_relaxed);
+        holes.clear();
+        holeSize.store(0, std::memory_order_relaxed);
+    }
+
+    // Gives back the unused ids of a range, they are skipped when the arena is destroyed
+    void release(LocalRange& range) {
+        if (range.next == range.end) return;
+        std::lock_guard<std::mutex> lock(growMutex);
+        holes.emplace_back(range.next, range.end);
+        holeSize.fetch_add(range.end - range.next, std::memory_order_relaxed);
+        range.next = range.end;
+    }
+
+    inline Hot& hot(NodeId id) { return hotChunks[id >> CHUNK_BITS].load(std::memory_order_relaxed)[id & CHUNK_MASK]; }
+    inline const Hot& hot(NodeId id) const { return hotChunks[id >> CHUNK_BITS].load(std::memory_order_relaxed)[id & CHUNK_MASK]; }
+    inline Cold& cold(NodeId id) { return coldChunks[id >> CHUNK_BITS].load(std::memory_order_relaxed)[id & CHUNK_MASK]; }
+    inline const Cold& cold(NodeId id) const { return coldChunks[id >> CHUNK_BITS].load(std::memory_order_relaxed)[id & CHUNK_MASK]; }
+
+    /**
+     * Allocates the chunks for the first nodeCount nodes and touches their pages with threads threads,
+     * call it before any node is constructed
+     * @return the bytes prefaulted
+     */
+    size_t prefault(size_t nodeCount, size_t threads, const std::function<void(size_t)>& onStart = {}) {
+        if (nodeCount == 0) return 0;
+        size_t lastChunk = (std::min(nodeCount, size_t(NO_NODE)) - 1) >> CHUNK_BITS;
+        growTo(lastChunk);
+        for (size_t c = 0; c <= lastChunk; c++) {
+            HugePages::prefault(hotChunks[c].load(std::memory_order_relaxed), CHUNK_SIZE * sizeof(Hot), threads, onStart);
+            HugePages::prefault(coldChunks[c].load(std::memory_order_relaxed), CHUNK_SIZE * sizeof(Cold), threads, onStart);
+        }
+        return (lastChunk + 1) * CHUNK_SIZE * NODE_BYTES;
+    }
+
+    // Number of nodes handed out so far (ids still held in LocalRanges count too)
+    size_t size() const {
+        return next.load(std::memory_order_relaxed) - holeSize.load(std::memory_order_relaxed);
+    }
+
+    // Bytes reserved for node storage (chunks are committed by the OS as they are touched)
+    size_t memoryBytes() const {
+        return allocatedChunks.load(std::memory_order_relaxed) * CHUNK_SIZE * NODE_BYTES;
+    }
+
+private:
+    std::unique_ptr<std::atomic<Hot*>[]> hotChunks;
+    std::unique_ptr<std::atomic<Cold*>[]> coldChunks;
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> allocatedChunks{0};
+    std::mutex growMutex; // also guards holes
+    std::vector<std::pair<size_t, size_t>> holes; // released id ranges [first, end) that hold no node
+    std::atomic<size_t> holeSize{0};
+
+    // Runs the destructor of every constructed node
+    void destroyNodes() {
+        size_t count = next.load(std::memory_order_relaxed);
+        std::sort(holes.begin(), holes.end());
+        auto hole = holes.begin();
+        for (size_t id = 0; id < count; id++) {
+            if (hole != holes.end() && id == hole->first) { // never constructed
+                id = hole->second - 1;
+                ++hole;
+                continue;
+            }
+            hot(id).~Hot();
+            cold(id).~Cold();
+        }
+    }
+
+    NodeId reserve(size_t count) {
+        size_t first = next.fetch_add(count, std::memory_order_relaxed);
+        if (first + count > NO_NODE) {
+            throw std::length_error("NodeArena is out of 32 bit node ids");
+        }
+        for (size_t c = first >> CHUNK_BITS; c <= (first + count - 1) >> CHUNK_BITS; c++) {
+            if (hotChunks[c].load(std::memory_order_acquire) == nullptr) {
+                growTo(c);
+            }
+        }
+        return static_cast<NodeId>(first);
+    }
+
+    // Allocates every chunk up to and including chunk c
+    void growTo(size_t c) {
+        std::lock_guard<std::mutex> lock(growMutex);
+        for (size_t i = allocatedChunks.load(std::memory_order_relaxed); i <= c; i++) {
+            coldChunks[i].store(static_cast<Cold*>(HugePages::allocate(CHUNK_SIZE * sizeof(Cold))), std::memory_order_release);
+            hotChunks[i].store(static_cast<Hot*>(HugePages::allocate(CHUNK_SIZE * sizeof(Hot))), std::memory_order_release);
+            allocatedChunks.store(i + 1, std::memory_order_relaxed);
+        }
+    }
+};
+
+/**
+ * Gives an IndexedHeap access to the heapIndex field of the arena's hot nodes
+ */
+template<typename Arena>
+struct ArenaHeapIndex {
+    Arena* arena;
+    inline uint32_t& operator()(NodeId id) const {
+        return arena->hot(id).heapIndex;
+    }
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Tells the cpu this is a spin loop (pause on x86), which frees resources for a sibling hyperthread
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+/**
+ * Time threads spent waiting at the wait sites sharing this object. Spinning keeps a core busy,
+ * blocked time is handed back to the OS. The spin budget adapts: a wait that ends while spinning
+ * doubles it, a wait that has to block halves it, so sites that usually wait long stop burning cpu.
+ */
+struct WaitStats {
+    static constexpr uint32_t MIN_SPINS = 16;
+    static constexpr uint32_t MAX_SPINS = 1 << 14;
+
+    std::atomic<uint64_t> waits{0}; // waits whose condition did not already hold
+    std::atomic<uint64_t> blocks{0}; // waits that went to sleep
+    std::atomic<uint64_t> spinNanos{0};
+    std::atomic<uint64_t> blockedNanos{0};
+    std::atomic<uint32_t> spinBudget{1024};
+
+    double spinSeconds() const { return spinNanos.load(std::memory_order_relaxed) * 1e-9; }
+    double blockedSeconds() const { return blockedNanos.load(std::memory_order_relaxed) * 1e-9; }
+};
+
+/**
+ * Waits until ready(word.load()) holds: spins with cpuRelax() up to the adaptive budget, then blocks
+ * in std::atomic::wait (a futex on linux). ready may only depend on the value of word, so whoever makes
+ * it true must change word and call word.notify_all() (or notify_one) afterwards.
+ */
+template<typename T, typename Ready>
+inline void spinThenWait(const std::atomic<T>& word, Ready ready, WaitStats& stats) {
+    T value = word.load(std::memory_order_acquire);
+    if (ready(value)) return;
+
+    using Clock = std::chrono::steady_clock;
+    auto elapsedNanos = [](Clock::time_point since) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - since).count());
+    };
+    auto spinStart = Clock::now();
+    stats.waits.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t budget = stats.spinBudget.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < budget; i++) {
+        cpuRelax();
+        value = word.load(std::memory_order_acquire);
+        if (ready(value)) {
+            stats.spinNanos.fetch_add(elapsedNanos(spinStart), std::memory_order_relaxed);
+            stats.spinBudget.store(std::min(budget * 2, WaitStats::MAX_SPINS), std::memory_order_relaxed);
+            return;
+        }
+    }
+    stats.spinNanos.fetch_add(elapsedNanos(spinStart), std::memory_order_relaxed);
+    stats.spinBudget.store(std::max(budget / 2, WaitStats::MIN_SPINS), std::memory_order_relaxed);
+    stats.blocks.fetch_add(1, std::memory_order_relaxed);
+
+    auto blockStart = Clock::now();
+    while (!ready(value)) {
+        word.wait(value, std::memory_order_acquire);
+        value = word.load(std::memory_order_acquire);
+    }
+    stats.blockedNanos.fetch_add(elapsedNanos(blockStart), std::memory_order_relaxed);
+}
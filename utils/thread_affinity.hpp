@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+/**
+ * Pinning threads to cpus. The topology (package, core and NUMA node of every cpu this process may run
+ * on) is read from /sys, the order threads are placed in is chosen by a policy:
+ *   compact  fills one NUMA node (and its cores' hyperthreads) before moving to the next
+ *   scatter  round robins over the NUMA nodes, using one hyperthread per core before the siblings
+ *   a list   such as "0,2,8-15" pins thread i to the i-th listed cpu
+ * Thread i goes to cpu order[i % order.size()].
+ */
+namespace ThreadAffinity {
+
+    struct Cpu {
+        int id;
+        int package = 0;
+        int core = 0;
+        int node = 0;
+    };
+
+    inline int readInt(const std::string& path, int fallback) {
+        std::ifstream file(path);
+        int value;
+        return file >> value ? value : fallback;
+    }
+
+    // The cpus this process is allowed to run on, with their place in the machine
+    inline std::vector<Cpu> readTopology() {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return {};
+
+        std::vector<Cpu> cpus;
+        for (int id = 0; id < CPU_SETSIZE; id++) {
+            if (!CPU_ISSET(id, &allowed)) continue;
+            std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(id);
+            Cpu cpu{id};
+            cpu.package = readInt(base + "/topology/physical_package_id", 0);
+            cpu.core = readInt(base + "/topology/core_id", id);
+            std::error_code error;
+            for (const auto& entry : std::filesystem::directory_iterator(base, error)) {
+                std::string name = entry.path().filename().string();
+                if (name.rfind("node", 0) == 0 && name.size() > 4 && isdigit(name[4])) {
+                    cpu.node = std::stoi(name.substr(4));
+                }
+            }
+            cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+    // Parses a cpu list such as "0,2,8-15"
+    inline std::vector<int> parseCpuList(const std::string& text) {
+        std::vector<int> list;
+        std::stringstream ss(text);
+        std::string part;
+        while (std::getline(ss, part, ',')) {
+            size_t dash = part.find('-');
+            size_t consumed = 0;
+            int first = std::stoi(part, &consumed);
+            int last = first;
+            if (dash != std::string::npos) {
+                size_t lastConsumed = 0;
+                last = std::stoi(part.substr(dash + 1), &lastConsumed);
+                if (consumed != dash || dash + 1 + lastConsumed != part.size()) throw std::invalid_argument("Bad cpu range: " + part);
+            } else if (consumed != part.size()) throw std::invalid_argument("Bad cpu list: " + text);
+            if (last < first) throw std::invalid_argument("Bad cpu range: " + part);
+            for (int cpu = first; cpu <= last; cpu++) list.push_back(cpu);
+        }
+        return list;
+    }
+
+    /**
+     * The cpus threads are pinned to, in thread order
+     * @param policy compact, scatter, a cpu list, or none/empty for no pinning
+     */
+    inline std::vector<int> cpuOrder(const std::string& policy, const std::vector<Cpu>& cpus) {
+        if (policy.empty() || policy == "none") return {};
+        if (policy != "compact" && policy != "scatter") return parseCpuList(policy);
+
+        // how many hyperthreads of the same core come before each cpu
+        std::map<std::tuple<int, int>, int> seenPerCore;
+        std::vector<std::tuple<int, int, int, int, int>> keyed; // sort key, then the cpu id
+        std::vector<Cpu> sorted = cpus;
+        std::sort(sorted.begin(), sorted.end(), [](const Cpu& a, const Cpu& b) { return a.id < b.id; });
+        for (const Cpu& cpu : sorted) {
+            int sibling = seenPerCore[{cpu.package, cpu.core}]++;
+            if (policy == "compact") keyed.emplace_back(cpu.node, cpu.package, cpu.core, sibling, cpu.id);
+            else keyed.emplace_back(sibling, cpu.package, cpu.core, 0, cpu.id);
+        }
+        std::sort(keyed.begin(), keyed.end());
+
+        std::vector<int> order;
+        if (policy == "compact") {
+            for (const auto& key : keyed) order.push_back(std::get<4>(key));
+            return order;
+        }
+        // scatter: deal the cpus out node by node so consecutive threads land on different nodes
+        std::map<int, int> nodeOf;
+        for (const Cpu& cpu : cpus) nodeOf[cpu.id] = cpu.node;
+        std::map<int, std::vector<int>> perNode;
+        for (const auto& key : keyed) perNode[nodeOf[std::get<4>(key)]].push_back(std::get<4>(key));
+        for (size_t i = 0; order.size() < cpus.size(); i++) {
+            for (const auto& [node, list] : perNode) {
+                if (i < list.size()) order.push_back(list[i]);
+            }
+        }
+        return order;
+    }
+
+    // @return false when the cpu does not exist or is not allowed
+    inline bool pinCurrentThread(int cpu) {
+        if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    // e.g. "2 nodes, 2 packages, 16 cores, 32 cpus"
+    inline std::string describe(const std::vector<Cpu>& cpus) {
+        std::set<int> nodes, packages;
+        std::set<std::pair<int, int>> cores;
+        for (const Cpu& cpu : cpus) {
+            nodes.insert(cpu.node);
+            packages.insert(cpu.package);
+            cores.insert({cpu.package, cpu.core});
+        }
+        return std::to_string(nodes.size()) + " nodes, " + std::to_string(packages.size()) + " packages, " +
+               std::to_string(cores.size()) + " cores, " + std::to_string(cpus.size()) + " cpus";
+    }
+
+    inline std::string toString(const std::vector<int>& list) {
+        std::string text;
+        for (size_t i = 0; i < list.size(); i++) {
+            text += (i == 0 ? "" : ",") + std::to_string(list[i]);
+        }
+        return text;
+    }
+}
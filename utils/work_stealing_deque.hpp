@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+/**
+ * WorkStealingDeque is a Chase-Lev deque: the owning thread pushes and pops at the bottom (LIFO) without
+ * locks, other threads steal from the top (FIFO) with a single CAS. The ring grows when it fills up, old
+ * rings are kept until destruction because a thief may still be reading one.
+ *
+ * push() and pop() must only be called by the owner, or by another thread while the owner is known to be
+ * idle (e.g. on the other side of a barrier). steal() may be called from any thread.
+ * T must be trivially copyable, items are stored in atomics.
+ */
+template<typename T>
+class WorkStealingDeque {
+    static_assert(std::is_trivially_copyable_v<T>, "WorkStealingDeque items must be trivially copyable");
+
+public:
+    explicit WorkStealingDeque(size_t capacity = 1024) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        rings.push_back(std::make_unique<Ring>(size));
+        ring.store(rings.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    void push(T item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Ring* r = ring.load(std::memory_order_relaxed);
+        if (b - t > static_cast<int64_t>(r->mask)) {
+            r = grow(r, t, b);
+        }
+        r->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // @return the most recently pushed item, nothing when the deque is empty
+    std::optional<T> pop() {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Ring* r = ring.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        if (t > b) { // empty
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        T item = r->get(b);
+        if (t == b) { // last item, race the thieves for it
+            bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            if (!won) return std::nullopt;
+        }
+        return item;
+    }
+
+    /**
+     * Takes the oldest item
+     * @return nothing when the deque is empty or another thread took the item first, check empty() to tell apart
+     */
+    std::optional<T> steal() {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return std::nullopt;
+
+        Ring* r = ring.load(std::memory_order_acquire);
+        T item = r->get(t);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        return item;
+    }
+
+    // Approximate when other threads are using the deque
+    size_t size() const {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+private:
+    struct Ring {
+        size_t mask;
+        std::unique_ptr<std::atomic<T>[]> items;
+
+        explicit Ring(size_t size) : mask(size - 1), items(new std::atomic<T>[size]) {}
+
+        T get(int64_t i) const { return items[i & mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T item) { items[i & mask].store(item, std::memory_order_relaxed); }
+    };
+
+    Ring* grow(Ring* old, int64_t t, int64_t b) {
+        rings.push_back(std::make_unique<Ring>((old->mask + 1) * 2));
+        Ring* bigger = rings.back().get();
+        for (int64_t i = t; i < b; i++) {
+            bigger->put(i, old->get(i));
+        }
+        ring.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::atomic<Ring*> ring;
+    std::vector<std::unique_ptr<Ring>> rings; // owned by the owner thread, includes retired rings
+};
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <random>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "work_stealing_deque.hpp"
+#include "spin_wait.hpp"
+
+/**
+ * Counts the unfinished tasks submitted with it, WorkStealingPool::wait(group) returns once it reaches 0
+ */
+class TaskGroup {
+public:
+    bool done() const {
+        return pending.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class WorkStealingPool;
+    std::atomic<size_t> pending{0};
+};
+
+/**
+ * WorkStealingPool runs tasks of the form void(size_t workerId) on a fixed set of threads.
+ *
+ * Tasks are stored inline in preallocated slots (at most TASK_BYTES of captures, no std::function, no
+ * future), so submitting allocates nothing. A worker submitting a task pushes it on its own Chase-Lev
+ * deque, other threads push on a shared injection queue. Idle workers take from their own deque, then the
+ * injection queue, then steal from a random worker and finally wait (spinThenWait) until new work is
+ * submitted.
+ *
+ * wait(group) does not block idly: the waiting thread runs queued tasks itself (with workerId == size())
+ * until the group is done, so a pool of k - 1 workers plus a waiting thread keeps k cores busy and a pool
+ * of 0 workers runs everything on the waiting thread. When every slot is in use submit runs the task on
+ * the calling thread.
+ */
+class WorkStealingPool {
+public:
+    static constexpr size_t TASK_BYTES = 48;
+    static constexpr size_t DEFAULT_TASK_CAPACITY = 4096;
+
+    /**
+     * @param taskCapacity the number of task slots, tasks submitted beyond it run on the submitting thread
+     * @param onStart called first on every worker thread with its id, e.g. to pin it to a cpu
+     */
+    explicit WorkStealingPool(size_t threadCount, size_t taskCapacity = DEFAULT_TASK_CAPACITY,
+                              std::function<void(size_t)> onStart = {})
+        : slots(new Slot[taskCapacity]), slotCount(taskCapacity), injected(taskCapacity), onStart(std::move(onStart)) {
+        for (uint32_t i = 0; i < slotCount; i++) {
+            slots[i].nextFree.store(i + 1 < slotCount ? i + 1 : NO_SLOT, std::memory_order_relaxed);
+        }
+        freeSlots.store(pack(0, 0), std::memory_order_relaxed);
+
+        for (size_t i = 0; i < threadCount; i++) {
+            workers.push_back(std::make_unique<Worker>(i));
+        }
+        for (size_t i = 0; i < threadCount; i++) {
+            workers[i]->thread = std::thread(&WorkStealingPool::workerLoop, this, i);
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Runs the tasks that are still queued, then joins the workers
+    ~WorkStealingPool() {
+        stopping.store(true, std::memory_order_seq_cst);
+        wakeAll();
+        for (auto& worker : workers) {
+            worker->thread.join();
+        }
+    }
+
+    // Number of worker threads, also the workerId a waiting thread runs tasks with
+    size_t size() const {
+        return workers.size();
+    }
+
+    template<typename F>
+    void submit(F&& task) {
+        submitTo(nullptr, std::forward<F>(task));
+    }
+
+    template<typename F>
+    void submit(TaskGroup& group, F&& task) {
+        submitTo(&group, std::forward<F>(task));
+    }
+
+    // Runs queued tasks on the calling thread until every task of the group has finished
+    void wait(TaskGroup& group) {
+        size_t self = currentPool == this ? currentWorker : size();
+        std::minstd_rand rng(static_cast<uint32_t>(self) + 1);
+        while (!group.done()) {
+            uint32_t slot;
+            if (takeTask(self, rng, slot)) {
+                run(slot, self);
+                continue;
+            }
+            // the group's last tasks are running on other threads, read the epoch before checking again
+            uint32_t epoch = groupsFinished.load(std::memory_order_acquire);
+            if (group.done()) break;
+            spinThenWait(groupsFinished, [epoch](uint32_t current) { return current != epoch; }, waitStats);
+        }
+    }
+
+    // Tasks taken from another worker's deque
+    size_t steals() const {
+        size_t total = 0;
+        for (auto& worker : workers) total += worker->steals.load(std::memory_order_relaxed);
+        return total;
+    }
+
+    // Times a worker went to sleep because there was no work
+    size_t parks() const {
+        return idleStats.blocks.load(std::memory_order_relaxed);
+    }
+
+    // How long workers waited for work
+    const WaitStats& workerIdleStats() const {
+        return idleStats;
+    }
+
+    // How long threads in wait(group) waited for tasks running elsewhere
+    const WaitStats& groupWaitStats() const {
+        return waitStats;
+    }
+
+private:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    struct Slot {
+        alignas(std::max_align_t) unsigned char storage[TASK_BYTES];
+        void (*invoke)(void* storage, size_t workerId) = nullptr;
+        void (*destroy)(void* storage) = nullptr;
+        TaskGroup* group = nullptr;
+        std::atomic<uint32_t> nextFree{NO_SLOT};
+    };
+
+    struct alignas(64) Worker {
+        WorkStealingDeque<uint32_t> tasks;
+        std::thread thread;
+        std::minstd_rand rng;
+        std::atomic<size_t> steals{0};
+
+        explicit Worker(size_t id) : rng(static_cast<uint32_t>(id) + 1) {}
+    };
+
+    // A fixed capacity FIFO for tasks submitted from outside the pool
+    struct InjectionQueue {
+        std::mutex mtx;
+        std::vector<uint32_t> ring;
+        size_t head = 0, count = 0;
+        std::atomic<size_t> size{0}; // lets idle workers skip the lock when it is empty
+
+        explicit InjectionQueue(size_t capacity) : ring(capacity) {}
+
+        void push(uint32_t slot) {
+            std::lock_guard<std::mutex> lock(mtx);
+            ring[(head + count++) % ring.size()] = slot; // never full, there are as many entries as slots
+            size.store(count, std::memory_order_release);
+        }
+
+        bool pop(uint32_t& slot) {
+            if (size.load(std::memory_order_acquire) == 0) return false;
+            std::lock_guard<std::mutex> lock(mtx);
+            if (count == 0) return false;
+            slot = ring[head];
+            head = (head + 1) % ring.size();
+            size.store(--count, std::memory_order_release);
+            return true;
+        }
+    };
+
+    inline static thread_local WorkStealingPool* currentPool = nullptr;
+    inline static thread_local size_t currentWorker = 0;
+
+    std::unique_ptr<Slot[]> slots;
+    uint32_t slotCount;
+    std::atomic<uint64_t> freeSlots; // treiber stack of slots, tagged against ABA
+    std::vector<std::unique_ptr<Worker>> workers;
+    InjectionQueue injected;
+    std::function<void(size_t)> onStart;
+
+    alignas(64) std::atomic<size_t> queuedTasks{0}; // submitted and not yet taken
+    alignas(64) std::atomic<uint32_t> wakeEpoch{0};
+    std::atomic<uint32_t> groupsFinished{0}; // bumped whenever a TaskGroup reaches 0
+    std::atomic<size_t> sleepers{0};
+    std::atomic<bool> stopping{false};
+    WaitStats idleStats;
+    WaitStats waitStats;
+
+    template<typename F>
+    void submitTo(TaskGroup* group, F&& task) {
+        using Fn = std::decay_t<F>;
+        static_assert(sizeof(Fn) <= TASK_BYTES, "task captures too much, capture a pointer instead");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t), "task is over aligned");
+        static_assert(std::is_invocable_v<Fn&, size_t>, "tasks are called as task(workerId)");
+
+        uint32_t slot = acquireSlot();
+        if (slot == NO_SLOT) { // every slot is queued or running, run it here instead of allocating
+            task(currentPool == this ? currentWorker : size());
+            return;
+        }
+        Slot& s = slots[slot];
+        new (s.storage) Fn(std::forward<F>(task));
+        s.invoke = [](void* storage, size_t workerId) { (*std::launder(reinterpret_cast<Fn*>(storage)))(workerId); };
+        s.destroy = [](void* storage) { std::launder(reinterpret_cast<Fn*>(storage))->~Fn(); };
+        s.group = group;
+        if (group != nullptr) group->pending.fetch_add(1, std::memory_order_relaxed);
+
+        queuedTasks.fetch_add(1, std::memory_order_seq_cst);
+        if (currentPool == this) {
+            workers[currentWorker]->tasks.push(slot);
+        } else {
+            injected.push(slot);
+        }
+        if (sleepers.load(std::memory_order_seq_cst) > 0) {
+            wakeEpoch.fetch_add(1, std::memory_order_release);
+            wakeEpoch.notify_one();
+        }
+    }
+
+    void workerLoop(size_t id) {
+        currentPool = this;
+        currentWorker = id;
+        if (onStart) onStart(id);
+        Worker& self = *workers[id];
+        while (true) {
+            uint32_t slot;
+            if (takeTask(id, self.rng, slot)) {
+                run(slot, id);
+                continue;
+            }
+            if (stopping.load(std::memory_order_acquire) && queuedTasks.load(std::memory_order_acquire) == 0) return;
+            idle();
+        }
+    }
+
+    /**
+     * Waits until work is submitted. Registering as a sleeper before checking queuedTasks (and submitters
+     * counting the task before checking sleepers) makes sure no wake up is missed.
+     */
+    void idle() {
+        uint32_t epoch = wakeEpoch.load(std::memory_order_acquire);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        if (queuedTasks.load(std::memory_order_seq_cst) == 0 && !stopping.load(std::memory_order_seq_cst)) {
+            spinThenWait(wakeEpoch, [epoch](uint32_t current) { return current != epoch; }, idleStats);
+        }
+        sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void wakeAll() {
+        wakeEpoch.fetch_add(1, std::memory_order_release);
+        wakeEpoch.notify_all();
+    }
+
+    // Own deque first, then the injection queue, then one sweep over the other workers
+    template<typename Rng>
+    bool takeTask(size_t self, Rng& rng, uint32_t& slot) {
+        if (self < workers.size()) {
+            if (auto task = workers[self]->tasks.pop()) {
+                slot = *task;
+                queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        if (injected.pop(slot)) {
+            queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        if (workers.empty()) return false;
+        size_t first = rng() % workers.size();
+        for (size_t i = 0; i < workers.size(); i++) {
+            size_t victim = (first + i) % workers.size();
+            if (victim == self) continue;
+            if (auto task = workers[victim]->tasks.steal()) {
+                slot = *task;
+                queuedTasks.fetch_sub(1, std::memory_order_relaxed);
+                if (self < workers.size()) workers[self]->steals.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(uint32_t slot, size_t workerId) {
+        Slot& s = slots[slot];
+        s.invoke(s.storage, workerId);
+        s.destroy(s.storage);
+        TaskGroup* group = s.group;
+        releaseSlot(slot);
+        // the group may be destroyed as soon as it is done, so waiters are woken through the pool
+        if (group != nullptr && group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            groupsFinished.fetch_add(1, std::memory_order_release);
+            groupsFinished.notify_all();
+        }
+    }
+
+    static uint64_t pack(uint32_t slot, uint32_t tag) {
+        return (static_cast<uint64_t>(tag) << 32) | slot;
+    }
+
+    uint32_t acquireSlot() {
+        uint64_t head = freeSlots.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t slot = static_cast<uint32_t>(head);
+            if (slot == NO_SLOT) return NO_SLOT;
+            uint32_t next = slots[slot].nextFree.load(std::memory_order_relaxed);
+            if (freeSlots.compare_exchange_weak(head, pack(next, static_cast<uint32_t>(head >> 32) + 1),
+                                                std::memory_order_acquire, std::memory_order_acquire)) {
+                return slot;
+            }
+        }
+    }
+
+    void releaseSlot(uint32_t slot) {
+        uint64_t head = freeSlots.load(std::memory_order_relaxed);
+        do {
+            slots[slot].nextFree.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+        } while (!freeSlots.compare_exchange_weak(head, pack(slot, static_cast<uint32_t>(head >> 32) + 1),
+                                                  std::memory_order_release, std::memory_order_relaxed));
+    }
+};